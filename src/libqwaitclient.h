@@ -22,13 +22,24 @@
 #include "libqwaitclient/config.h"
 #include "libqwaitclient/http-message.h"
 #include "libqwaitclient/http-socket.h"
+#include "libqwaitclient/intern.h"
+#include "libqwaitclient/matcher.h"
 #include "libqwaitclient/qwait-position.h"
+#include "libqwaitclient/qwait-position-columns.h"
 #include "libqwaitclient/qwait-protocol.h"
 #include "libqwaitclient/qwait-queue.h"
+#include "libqwaitclient/qwait-queue-packed.h"
+#include "libqwaitclient/qwait-changes.h"
 #include "libqwaitclient/authentication.h"
 #include "libqwaitclient/qwait-user.h"
+#include "libqwaitclient/qwait-user-id.h"
+#include "libqwaitclient/qwait-user-index.h"
 #include "libqwaitclient/computers.h"
 #include "libqwaitclient/login-information.h"
+#include "libqwaitclient/timer-wheel.h"
+#include "libqwaitclient/webmessage.h"
+#include "libqwaitclient/websocket.h"
+#include "libqwaitclient/bus.h"
 
 
 #endif
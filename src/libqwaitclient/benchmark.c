@@ -0,0 +1,229 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "macros.h"
+#include "json.h"
+#include "webmessage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+
+#define t(expression)   if (expression)  goto fail
+
+
+
+/**
+ * Get the number of seconds that have elapsed since a point in time
+ * 
+ * @param   start  The point in time, from `clock_gettime(CLOCK_MONOTONIC, start)`
+ * @return         The number of seconds since `start`
+ */
+static double elapsed(const struct timespec* restrict start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)(now.tv_sec - start->tv_sec) + (double)(now.tv_nsec - start->tv_nsec) / 1000000000;
+}
+
+
+/**
+ * Create a queue listing, as sent by the server, to parse
+ * 
+ * @param   count   The number of entries in the queue
+ * @param   length  Output parameter for the length of the listing
+ * @return          The listing, `NULL` on error
+ */
+static char* make_queue_listing(size_t count, size_t* restrict length)
+{
+  char* rc = NULL;
+  size_t i, ptr = 0, size = 256 + count * 256;
+  
+  if (xmalloc(rc, size, char))
+    return NULL;
+  
+  ptr += (size_t)sprintf(rc + ptr, "{\"name\":\"inda\",\"title\":\"INDA\",\"hidden\":false,\"locked\":false,"
+			 "\"owners\":[\"u1abcdef\"],\"moderators\":[\"u1ghijkl\",\"u1mnopqr\"],\"positions\":[");
+  for (i = 0; i < count; i++)
+    ptr += (size_t)sprintf(rc + ptr, "%s{\"location\":\"Red %zu\",\"comment\":\"Help with exercise %zu\","
+			   "\"userName\":\"u1%06zx\",\"readableName\":\"Student Number %zu\","
+			   "\"startTime\":%llu}", i ? "," : "", i % 20, i % 7, i, i,
+			   1400000000000ULL + (unsigned long long)i * 1000);
+  ptr += (size_t)sprintf(rc + ptr, "]}");
+  
+  *length = ptr;
+  return rc;
+}
+
+
+/**
+ * Create a document of nested arrays to parse
+ * 
+ * @param   depth   The depth of the nesting
+ * @param   length  Output parameter for the length of the document
+ * @return          The document, `NULL` on error
+ */
+static char* make_nested(size_t depth, size_t* restrict length)
+{
+  char* rc = NULL;
+  size_t i;
+  
+  if (xmalloc(rc, 2 * depth + 1, char))
+    return NULL;
+  
+  for (i = 0; i < depth; i++)
+    rc[i] = '[', rc[2 * depth - 1 - i] = ']';
+  rc[2 * depth] = '\0';
+  
+  *length = 2 * depth;
+  return rc;
+}
+
+
+/**
+ * Measure how fast a JSON document is parsed and destroyed
+ * 
+ * @param   name    The name of the document, for the report
+ * @param   code    The document
+ * @param   length  The length of `code`
+ * @param   rounds  The number of times to parse the document
+ * @return          Zero on success, -1 on error
+ */
+static int benchmark_json_parse(const char* name, const char* restrict code, size_t length, size_t rounds)
+{
+  libqwaitclient_json_t json;
+  struct timespec start;
+  double seconds;
+  size_t i;
+  
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < rounds; i++)
+    {
+      if (libqwaitclient_json_parse(&json, code, length) < 0)
+	return -1;
+      libqwaitclient_json_destroy(&json);
+    }
+  seconds = elapsed(&start);
+  
+  printf("json-parse %-16s %8zu bytes  %10.3f ms per parse  %8.1f MB/s\n", name, length,
+	 seconds * 1000 / (double)rounds, (double)(length * rounds) / seconds / 1000000);
+  return 0;
+}
+
+
+/**
+ * Measure how fast a message is marshalled and masked
+ * 
+ * @param   name    The name of the message, for the report
+ * @param   length  The length of the content of the message
+ * @param   rounds  The number of times to marshal the message
+ * @return          Zero on success, -1 on error
+ */
+static int benchmark_webmessage_compose(const char* name, size_t length, size_t rounds)
+{
+  static const unsigned char mask[4] = { 0x12, 0x34, 0x56, 0x78 };
+  libqwaitclient_webmessage_t message;
+  struct timespec start;
+  double seconds;
+  char* data = NULL;
+  size_t i;
+  int saved_errno;
+  
+  libqwaitclient_webmessage_zero_initialise(&message);
+  message.opcode = 1;
+  message.final = 1;
+  message.content_size = length;
+  if (xmalloc(message.content, length ? length : 1, char))
+    goto fail;
+  for (i = 0; i < length; i++)
+    message.content[i] = (char)('a' + i % 26);
+  if (xmalloc(data, libqwaitclient_webmessage_compose_size(&message), char))
+    goto fail;
+  
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (i = 0; i < rounds; i++)
+    libqwaitclient_webmessage_compose(&message, mask, data);
+  seconds = elapsed(&start);
+  
+  printf("webmessage-compose %-8s %8zu bytes  %10.3f us per message %7.1f MB/s\n", name, length,
+	 seconds * 1000000 / (double)rounds, (double)(length * rounds) / seconds / 1000000);
+  free(data);
+  libqwaitclient_webmessage_destroy(&message);
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  free(data);
+  libqwaitclient_webmessage_destroy(&message);
+  return errno = saved_errno, -1;
+}
+
+
+
+/**
+ * Run the benchmarks
+ * 
+ * The JSON benchmarks only use functions that have been stable
+ * since the first release, so they can be built against older
+ * revisions of the library to compare them with the current one,
+ * the message benchmarks need the masking key to be passed
+ * to `libqwaitclient_webmessage_compose`
+ * 
+ * @param   argc  The number of elements in `argv`
+ * @param   argv  Command line arguments, the first may be the number of rounds
+ * @return        Zero on success, 1 on error
+ */
+int main(int argc, char** argv)
+{
+  char* code = NULL;
+  size_t length, rounds = 200;
+  int rc = 0;
+  
+  if (argc > 1)
+    rounds = (size_t)atol(argv[1]);
+  if (rounds == 0)
+    rounds = 1;
+  
+  t ((code = make_queue_listing(20, &length)) == NULL);
+  t (benchmark_json_parse("queue-20", code, length, rounds * 100));
+  free(code);
+  
+  t ((code = make_queue_listing(2000, &length)) == NULL);
+  t (benchmark_json_parse("queue-2000", code, length, rounds));
+  free(code);
+  
+  t ((code = make_nested(60, &length)) == NULL);
+  t (benchmark_json_parse("nested-60", code, length, rounds * 1000));
+  free(code), code = NULL;
+  
+  t (benchmark_webmessage_compose("small", 100, rounds * 10000));
+  t (benchmark_webmessage_compose("medium", 4096, rounds * 1000));
+  t (benchmark_webmessage_compose("large", 200000, rounds * 10));
+  
+ done:
+  free(code);
+  return rc;
+  
+ fail:
+  perror(*argv);
+  rc = 1;
+  goto done;
+}
+
@@ -0,0 +1,472 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "bus.h"
+
+#include "macros.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_bus_t* restrict this
+
+
+
+/**
+ * Calculate the hash of an interned topic, which
+ * is the hash of its address rather than its content
+ * 
+ * @param   topic  The interned topic
+ * @return         The hash of the topic
+ */
+static size_t __attribute__((const)) hash_topic(const char* topic)
+{
+  return (size_t)(((uint64_t)(uintptr_t)topic * UINT64_C(0x9E3779B97F4A7C15)) >> 32);
+}
+
+
+/**
+ * Find the slot of a topic in the subscription table, the table must not be empty
+ * 
+ * @param   this   The bus
+ * @param   topic  The interned topic
+ * @return         The index of the topic's slot, or of the
+ *                 unused slot it would be stored in
+ */
+static size_t __attribute__((pure)) find_slot(const _this_, const char* topic)
+{
+  size_t mask = this->capacity - 1, i = hash_topic(topic) & mask;
+  
+  while ((this->subscriptions[i].topic != NULL) && (this->subscriptions[i].topic != topic))
+    i = (i + 1) & mask;
+  return i;
+}
+
+
+/**
+ * Double the size of the subscription table
+ * 
+ * @param   this  The bus
+ * @return        Zero on success, -1 on error
+ */
+static int grow(_this_)
+{
+  libqwaitclient_bus_subscription_t* old = this->subscriptions;
+  libqwaitclient_bus_subscription_t* new = NULL;
+  size_t i, old_capacity = this->capacity, capacity = old_capacity ? (old_capacity << 1) : 16;
+  
+  if (xcalloc(new, capacity, libqwaitclient_bus_subscription_t))
+    return -1;
+  
+  this->subscriptions = new;
+  this->capacity = capacity;
+  for (i = 0; i < old_capacity; i++)
+    if (old[i].topic != NULL)
+      new[find_slot(this, old[i].topic)] = old[i];
+  
+  free(old);
+  return 0;
+}
+
+
+/**
+ * Send a registration or deregistration of a topic to the bus
+ * 
+ * @param   this   The bus
+ * @param   type   "register" or "unregister"
+ * @param   topic  The topic
+ * @return         Zero on success, -1 on error
+ */
+static int send_envelope(_this_, const char* restrict type, const char* restrict topic)
+{
+  static char name_type[] = "type";
+  static char name_address[] = "address";
+  libqwaitclient_websocket_t* restrict websocket = this->websocket;
+  libqwaitclient_json_association_t members[2];
+  libqwaitclient_json_t envelope, encoded, frame;
+  libqwaitclient_webmessage_t message;
+  char* envelope_data = NULL;
+  char* frame_data = NULL;
+  char* type_copy = NULL;
+  char* address = NULL;
+  size_t envelope_length = 0, frame_length = 0;
+  int saved_errno;
+  
+  /* The strings in JSON values are not constant, so they are copied. */
+  if ((type_copy = strdup(type)) == NULL)
+    goto fail;
+  if ((address = strdup(topic)) == NULL)
+    goto fail;
+  
+  /* Make the message for the event bus, {"type":type,"address":topic}. */
+  members[0].name = name_type;
+  members[0].name_length = strlen(name_type);
+  members[0].value.type = LIBQWAITCLIENT_JSON_TYPE_STRING;
+  members[0].value.length = strlen(type_copy);
+  members[0].value.data.string = type_copy;
+  members[1].name = name_address;
+  members[1].name_length = strlen(name_address);
+  members[1].value.type = LIBQWAITCLIENT_JSON_TYPE_STRING;
+  members[1].value.length = strlen(address);
+  members[1].value.data.string = address;
+  envelope.type = LIBQWAITCLIENT_JSON_TYPE_OBJECT;
+  envelope.length = 2;
+  envelope.data.object = members;
+  if (libqwaitclient_json_compose(&envelope, &envelope_data, &envelope_length))
+    goto fail;
+  
+  /* SockJS sends messages as an array of JSON-encoded strings. */
+  encoded.type = LIBQWAITCLIENT_JSON_TYPE_STRING;
+  encoded.length = envelope_length;
+  encoded.data.string = envelope_data;
+  frame.type = LIBQWAITCLIENT_JSON_TYPE_ARRAY;
+  frame.length = 1;
+  frame.data.array = &encoded;
+  if (libqwaitclient_json_compose(&frame, &frame_data, &frame_length))
+    goto fail;
+  
+  /* Finish sending whatever is being sent, and send the frame. */
+  if (websocket->send_buffer_size != websocket->send_buffer_ptr)
+    if (libqwaitclient_websocket_send(websocket, NULL))
+      goto fail;
+  libqwaitclient_webmessage_zero_initialise(&message);
+  message.final = 1;
+  message.opcode = 1;
+  message.content = frame_data;
+  message.content_size = frame_length;
+  if (libqwaitclient_websocket_send(websocket, &message))
+    goto fail;
+  
+  free(type_copy);
+  free(address);
+  free(envelope_data);
+  free(frame_data);
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  free(type_copy);
+  free(address);
+  free(envelope_data);
+  free(frame_data);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Dispatch a message from the event bus to the subscriber of its topic
+ * 
+ * @param   this    The bus
+ * @param   code    The message, as JSON
+ * @param   length  The length of `code`
+ * @return          The return value follows the rules of `libqwaitclient_bus_dispatch`
+ */
+static int dispatch_message(_this_, const char* restrict code, size_t length)
+{
+  libqwaitclient_json_t json;
+  libqwaitclient_json_t* address = NULL;
+  libqwaitclient_json_t* body = NULL;
+  libqwaitclient_json_t null_body;
+  libqwaitclient_bus_subscription_t* subscription;
+  const char* topic;
+  size_t i;
+  int r = 0, saved_errno;
+  
+  if (libqwaitclient_json_parse(&json, code, length))
+    return errno == EINVAL ? -2 : -1;
+  if (json.type != LIBQWAITCLIENT_JSON_TYPE_OBJECT)
+    return libqwaitclient_json_destroy(&json), -2;
+  
+  for (i = 0; i < json.length; i++)
+    {
+      libqwaitclient_json_association_t* member = json.data.object + i;
+      if ((member->name_length == 7) && !memcmp(member->name, "address", 7))
+	address = &(member->value);
+      else if ((member->name_length == 4) && !memcmp(member->name, "body", 4))
+	body = &(member->value);
+    }
+  
+  /* Messages without an address, such as errors, and messages on topics
+     that are not subscribed to are ignored without any copying. */
+  if ((address == NULL) || (address->type != LIBQWAITCLIENT_JSON_TYPE_STRING))
+    goto done;
+  if (strlen(address->data.string) != address->length)
+    goto done;
+  if ((topic = libqwaitclient_intern_find(&(this->topics), address->data.string)) == NULL)
+    goto done;
+  if (this->capacity == 0)
+    goto done;
+  subscription = this->subscriptions + find_slot(this, topic);
+  if (subscription->topic == NULL)
+    goto done;
+  
+  if (body == NULL)
+    {
+      memset(&null_body, 0, sizeof(null_body));
+      null_body.type = LIBQWAITCLIENT_JSON_TYPE_NULL;
+      body = &null_body;
+    }
+  r = subscription->callback(subscription->data, topic, body);
+  
+ done:
+  saved_errno = errno;
+  libqwaitclient_json_destroy(&json);
+  return errno = saved_errno, r;
+}
+
+
+
+/**
+ * Initialise a bus
+ * 
+ * @param  this       The bus
+ * @param  websocket  The websocket, which must have been upgraded from the
+ *                    HTTP socket after a handshake on "/bus/client"
+ */
+void libqwaitclient_bus_initialise(_this_, libqwaitclient_websocket_t* restrict websocket)
+{
+  this->websocket = websocket;
+  libqwaitclient_intern_initialise(&(this->topics));
+  this->subscriptions = NULL;
+  this->count = 0;
+  this->capacity = 0;
+}
+
+
+/**
+ * Release all resources in a bus, but not its
+ * websocket, nothing is unsubscribed
+ * 
+ * @param  this  The bus
+ */
+void libqwaitclient_bus_destroy(_this_)
+{
+  libqwaitclient_intern_destroy(&(this->topics));
+  free(this->subscriptions);
+  this->subscriptions = NULL;
+  this->count = 0;
+  this->capacity = 0;
+}
+
+
+/**
+ * Subscribe to a topic, if already subscribed,
+ * only the callback function is replaced
+ * 
+ * @param   this      The bus
+ * @param   topic     The topic
+ * @param   callback  The function to call when a message is received on the topic
+ * @param   data      Data to pass to `callback`
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_bus_subscribe(_this_, const char* restrict topic,
+				 libqwaitclient_bus_callback_t callback, void* data)
+{
+  libqwaitclient_bus_subscription_t* subscription;
+  const char* interned;
+  int saved_errno;
+  
+  /* Already subscribed? Then only the callback function is replaced. */
+  if (((interned = libqwaitclient_intern_find(&(this->topics), topic)) != NULL) && (this->capacity != 0))
+    {
+      subscription = this->subscriptions + find_slot(this, interned);
+      if (subscription->topic != NULL)
+	goto done;
+    }
+  
+  /* A new topic, make room for it before registering it. */
+  if ((interned = libqwaitclient_intern_get(&(this->topics), topic)) == NULL)
+    return -1;
+  if (((this->count + 1) << 1) > this->capacity)
+    if (grow(this))
+      goto fail;
+  subscription = this->subscriptions + find_slot(this, interned);
+  if (send_envelope(this, "register", interned))
+    goto fail;
+  subscription->topic = interned;
+  this->count++;
+  
+ done:
+  subscription->callback = callback;
+  subscription->data = data;
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  libqwaitclient_intern_remove(&(this->topics), interned);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Unsubscribe from a topic, nothing is done if not subscribed
+ * 
+ * @param   this   The bus
+ * @param   topic  The topic
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_bus_unsubscribe(_this_, const char* restrict topic)
+{
+  size_t i, j, k, mask = this->capacity - 1;
+  const char* interned;
+  
+  if ((interned = libqwaitclient_intern_find(&(this->topics), topic)) == NULL)
+    return 0;
+  if (this->capacity == 0)
+    return 0;
+  i = find_slot(this, interned);
+  if (this->subscriptions[i].topic == NULL)
+    return 0;
+  
+  if (send_envelope(this, "unregister", interned))
+    return -1;
+  
+  /* Remove the subscription, and move back subscriptions that
+     were displaced by it, so that no lookup passes an unused slot. */
+  for (j = i;;)
+    {
+      this->subscriptions[i].topic = NULL;
+      for (;;)
+	{
+	  j = (j + 1) & mask;
+	  if (this->subscriptions[j].topic == NULL)
+	    goto removed;
+	  k = hash_topic(this->subscriptions[j].topic) & mask;
+	  if (((j - k) & mask) >= ((j - i) & mask))
+	    break;
+	}
+      this->subscriptions[i] = this->subscriptions[j];
+      i = j;
+    }
+  
+ removed:
+  this->count--;
+  libqwaitclient_intern_remove(&(this->topics), interned);
+  return 0;
+}
+
+
+/**
+ * Subscribe to updates of a queue
+ * 
+ * @param   this      The bus
+ * @param   queue     The name of the queue
+ * @param   callback  The function to call when the queue is updated
+ * @param   data      Data to pass to `callback`
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_bus_subscribe_queue(_this_, const char* restrict queue,
+				       libqwaitclient_bus_callback_t callback, void* data)
+{
+  char* topic;
+  int r, saved_errno;
+  
+  if (asprintf(&topic, "%s%s", LIBQWAITCLIENT_BUS_QUEUE_TOPIC_PREFIX, queue) < 0)
+    return -1;
+  r = libqwaitclient_bus_subscribe(this, topic, callback, data);
+  saved_errno = errno;
+  free(topic);
+  return errno = saved_errno, r;
+}
+
+
+/**
+ * Unsubscribe from updates of a queue
+ * 
+ * @param   this   The bus
+ * @param   queue  The name of the queue
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_bus_unsubscribe_queue(_this_, const char* restrict queue)
+{
+  char* topic;
+  int r, saved_errno;
+  
+  if (asprintf(&topic, "%s%s", LIBQWAITCLIENT_BUS_QUEUE_TOPIC_PREFIX, queue) < 0)
+    return -1;
+  r = libqwaitclient_bus_unsubscribe(this, topic);
+  saved_errno = errno;
+  free(topic);
+  return errno = saved_errno, r;
+}
+
+
+/**
+ * Dispatch the message last received by the websocket, with
+ * `libqwaitclient_websocket_receive`, to the subscribers of
+ * its topics; messages on other topics are ignored
+ * 
+ * @param   this  The bus
+ * @return        Zero on success, -1 on error with `errno` set accordingly,
+ *                `ECONNRESET` if the server closed the session, -2 if the
+ *                message is malformated
+ */
+int libqwaitclient_bus_dispatch(_this_)
+{
+  const libqwaitclient_webmessage_t* restrict message = &(this->websocket->message);
+  libqwaitclient_json_t json;
+  size_t i;
+  int r = 0, saved_errno;
+  
+  if ((message->opcode != 1) || (message->content_size == 0))
+    return 0;
+  
+  /* SockJS frames: open, heartbeat, array of messages, single message, and close. */
+  switch (message->content[0])
+    {
+    case 'o':
+    case 'h':
+      return 0;
+    
+    case 'c':
+      return errno = ECONNRESET, -1;
+    
+    case 'a':
+    case 'm':
+      break;
+    
+    default:
+      return -2;
+    }
+  
+  if (libqwaitclient_json_parse(&json, message->content + 1, message->content_size - 1))
+    return errno == EINVAL ? -2 : -1;
+  
+  if (json.type == LIBQWAITCLIENT_JSON_TYPE_STRING)
+    r = dispatch_message(this, json.data.string, json.length);
+  else if (json.type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+    for (i = 0; (r == 0) && (i < json.length); i++)
+      if (json.data.array[i].type != LIBQWAITCLIENT_JSON_TYPE_STRING)
+	r = -2;
+      else
+	r = dispatch_message(this, json.data.array[i].data.string, json.data.array[i].length);
+  else
+    r = -2;
+  
+  saved_errno = errno;
+  libqwaitclient_json_destroy(&json);
+  return errno = saved_errno, r;
+}
+
+
+
+#undef _this_
+
@@ -0,0 +1,197 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_BUS_H
+#define LIBQWAITCLIENT_BUS_H
+
+
+#include "websocket.h"
+#include "intern.h"
+#include "json.h"
+
+#define _GNU_SOURCE
+#include <stddef.h>
+
+
+/* The bus is a SockJS endpoint, carrying an event bus where each
+   message is a JSON object with the topic as its "address" and the
+   payload as its "body". Clients "register" to an address to receive
+   messages sent to it, and "unregister" to stop receiving them. */
+
+
+/**
+ * The prefix of the topic for updates of a queue,
+ * the name of the queue is appended to it
+ */
+#define LIBQWAITCLIENT_BUS_QUEUE_TOPIC_PREFIX  "queue/"
+
+
+
+/**
+ * Function that is called when a message is received on a topic
+ * 
+ * @param   data   The data that was given when subscribing
+ * @param   topic  The topic, interned, it is freed
+ *                 when it is unsubscribed from
+ * @param   body   The payload, strings may be taken out of it
+ * @return         Zero on success, -1 on error with `errno` set
+ *                 accordingly, which stops the dispatch
+ */
+typedef int (*libqwaitclient_bus_callback_t)(void* data, const char* topic, libqwaitclient_json_t* restrict body);
+
+
+/**
+ * A subscription to a topic
+ */
+typedef struct libqwaitclient_bus_subscription
+{
+  /**
+   * The topic, interned in the bus, `NULL` for unused slots
+   */
+  const char* topic;
+  
+  /**
+   * The function to call when a message is received on the topic
+   */
+  libqwaitclient_bus_callback_t callback;
+  
+  /**
+   * Data to pass to `callback`
+   */
+  void* data;
+  
+} libqwaitclient_bus_subscription_t;
+
+
+/**
+ * Topic subscriptions multiplexed over a websocket
+ */
+typedef struct libqwaitclient_bus
+{
+  /**
+   * The websocket, it is not owned by the bus
+   */
+  libqwaitclient_websocket_t* websocket;
+  
+  /**
+   * The topics that are subscribed to,
+   * so that received topics are looked up
+   * without being copied
+   */
+  libqwaitclient_intern_t topics;
+  
+  /**
+   * Hash table of the subscriptions, keyed by
+   * the address of the interned topic
+   */
+  libqwaitclient_bus_subscription_t* subscriptions;
+  
+  /**
+   * The number of subscriptions
+   */
+  size_t count;
+  
+  /**
+   * The number of slots in `subscriptions`, zero or a power of two
+   */
+  size_t capacity;
+  
+} libqwaitclient_bus_t;
+
+
+
+#define _this_  libqwaitclient_bus_t* restrict this
+
+
+/**
+ * Initialise a bus
+ * 
+ * @param  this       The bus
+ * @param  websocket  The websocket, which must have been upgraded from the
+ *                    HTTP socket after a handshake on "/bus/client"
+ */
+void libqwaitclient_bus_initialise(_this_, libqwaitclient_websocket_t* restrict websocket);
+
+/**
+ * Release all resources in a bus, but not its
+ * websocket, nothing is unsubscribed
+ * 
+ * @param  this  The bus
+ */
+void libqwaitclient_bus_destroy(_this_);
+
+/**
+ * Subscribe to a topic, if already subscribed,
+ * only the callback function is replaced
+ * 
+ * @param   this      The bus
+ * @param   topic     The topic
+ * @param   callback  The function to call when a message is received on the topic
+ * @param   data      Data to pass to `callback`
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_bus_subscribe(_this_, const char* restrict topic,
+				 libqwaitclient_bus_callback_t callback, void* data);
+
+/**
+ * Unsubscribe from a topic, nothing is done if not subscribed
+ * 
+ * @param   this   The bus
+ * @param   topic  The topic
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_bus_unsubscribe(_this_, const char* restrict topic);
+
+/**
+ * Subscribe to updates of a queue
+ * 
+ * @param   this      The bus
+ * @param   queue     The name of the queue
+ * @param   callback  The function to call when the queue is updated
+ * @param   data      Data to pass to `callback`
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_bus_subscribe_queue(_this_, const char* restrict queue,
+				       libqwaitclient_bus_callback_t callback, void* data);
+
+/**
+ * Unsubscribe from updates of a queue
+ * 
+ * @param   this   The bus
+ * @param   queue  The name of the queue
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_bus_unsubscribe_queue(_this_, const char* restrict queue);
+
+/**
+ * Dispatch the message last received by the websocket, with
+ * `libqwaitclient_websocket_receive`, to the subscribers of
+ * its topics; messages on other topics are ignored
+ * 
+ * @param   this  The bus
+ * @return        Zero on success, -1 on error with `errno` set accordingly,
+ *                `ECONNRESET` if the server closed the session, -2 if the
+ *                message is malformated
+ */
+int libqwaitclient_bus_dispatch(_this_);
+
+
+#undef _this_
+
+
+#endif
+
@@ -17,6 +17,8 @@
  */
 #include "computers.h"
 
+#include "matcher.h"
+
 #include <stdlib.h>
 #include <string.h>
 
@@ -89,6 +91,75 @@ static const char* computer_colours_term[][3] =
 
 
 
+/**
+ * Keywords for the computer rooms, the computer rooms are
+ * numbered in order of precedence, if a location contains
+ * keywords for multiple computer rooms, the lowest number wins;
+ * the colours must be whole words, so that for example "Fredrik"
+ * is not taken for "red", but the other rooms are often suffixed,
+ * as in "Spelhallen"
+ */
+static const libqwaitclient_matcher_pattern_t computer_keywords[] =
+  {
+    { "cerise",    LIBQWAITCLIENT_COMPUTERS_CERISE,    LIBQWAITCLIENT_MATCHER_WORD       },
+    { "blå",       LIBQWAITCLIENT_COMPUTERS_BLUE,      LIBQWAITCLIENT_MATCHER_WORD       },
+    { "blue",      LIBQWAITCLIENT_COMPUTERS_BLUE,      LIBQWAITCLIENT_MATCHER_WORD       },
+    { "röd",       LIBQWAITCLIENT_COMPUTERS_RED,       LIBQWAITCLIENT_MATCHER_WORD       },
+    { "red",       LIBQWAITCLIENT_COMPUTERS_RED,       LIBQWAITCLIENT_MATCHER_WORD       },
+    { "orange",    LIBQWAITCLIENT_COMPUTERS_ORANGE,    LIBQWAITCLIENT_MATCHER_WORD       },
+    { "gul",       LIBQWAITCLIENT_COMPUTERS_YELLOW,    LIBQWAITCLIENT_MATCHER_WORD       },
+    { "yellow",    LIBQWAITCLIENT_COMPUTERS_YELLOW,    LIBQWAITCLIENT_MATCHER_WORD       },
+    { "grön",      LIBQWAITCLIENT_COMPUTERS_GREEN,     LIBQWAITCLIENT_MATCHER_WORD       },
+    { "green",     LIBQWAITCLIENT_COMPUTERS_GREEN,     LIBQWAITCLIENT_MATCHER_WORD       },
+    { "brun",      LIBQWAITCLIENT_COMPUTERS_BROWN,     LIBQWAITCLIENT_MATCHER_WORD       },
+    { "brown",     LIBQWAITCLIENT_COMPUTERS_BROWN,     LIBQWAITCLIENT_MATCHER_WORD       },
+    { "grå",       LIBQWAITCLIENT_COMPUTERS_GREY,      LIBQWAITCLIENT_MATCHER_WORD       },
+    { "grey",      LIBQWAITCLIENT_COMPUTERS_GREY,      LIBQWAITCLIENT_MATCHER_WORD       },
+    { "gray",      LIBQWAITCLIENT_COMPUTERS_GREY,      LIBQWAITCLIENT_MATCHER_WORD       },
+    { "karmosin",  LIBQWAITCLIENT_COMPUTERS_CRIMSON,   LIBQWAITCLIENT_MATCHER_WORD       },
+    { "crimson",   LIBQWAITCLIENT_COMPUTERS_CRIMSON,   LIBQWAITCLIENT_MATCHER_WORD       },
+    { "vit",       LIBQWAITCLIENT_COMPUTERS_WHITE,     LIBQWAITCLIENT_MATCHER_WORD       },
+    { "white",     LIBQWAITCLIENT_COMPUTERS_WHITE,     LIBQWAITCLIENT_MATCHER_WORD       },
+    { "magenta",   LIBQWAITCLIENT_COMPUTERS_MAGENTA,   LIBQWAITCLIENT_MATCHER_WORD       },
+    { "violet",    LIBQWAITCLIENT_COMPUTERS_VIOLET,    LIBQWAITCLIENT_MATCHER_WORD       },
+    { "turkos",    LIBQWAITCLIENT_COMPUTERS_TURQUOISE, LIBQWAITCLIENT_MATCHER_WORD       },
+    { "turquoise", LIBQWAITCLIENT_COMPUTERS_TURQUOISE, LIBQWAITCLIENT_MATCHER_WORD       },
+    { "spel",      LIBQWAITCLIENT_COMPUTERS_SPEL,      LIBQWAITCLIENT_MATCHER_WORD_START },
+    { "sport",     LIBQWAITCLIENT_COMPUTERS_SPORT,     LIBQWAITCLIENT_MATCHER_WORD_START },
+    { "musik",     LIBQWAITCLIENT_COMPUTERS_MUSIK,     LIBQWAITCLIENT_MATCHER_WORD_START },
+    { "konst",     LIBQWAITCLIENT_COMPUTERS_KONST,     LIBQWAITCLIENT_MATCHER_WORD_START },
+    { "mat",       LIBQWAITCLIENT_COMPUTERS_MAT,       LIBQWAITCLIENT_MATCHER_WORD_START }
+  };
+
+
+/**
+ * `computer_keywords` compiled into a matcher,
+ * it is compiled when the library is loaded
+ */
+static libqwaitclient_matcher_t computer_matcher;
+
+
+
+/**
+ * Compile `computer_keywords` when the library is loaded,
+ * if it fails, all computer rooms will be unknown
+ */
+static void __attribute__((constructor)) libqwaitclient_computers_load(void)
+{
+  libqwaitclient_matcher_compile(&computer_matcher, computer_keywords,
+				 sizeof(computer_keywords) / sizeof(*computer_keywords));
+}
+
+
+/**
+ * Release `computer_matcher` when the library is unloaded
+ */
+static void __attribute__((destructor)) libqwaitclient_computers_unload(void)
+{
+  libqwaitclient_matcher_destroy(&computer_matcher);
+}
+
+
 /**
  * Figure out which computer room a student is sitting in by her location string
  * 
@@ -97,39 +168,22 @@ static const char* computer_colours_term[][3] =
  */
 int libqwaitclient_computers_get_room(const char* restrict location)
 {
-#define test1(A)           (strcasestr(location, A) != NULL)
-#define test2(A, B)        (test1(A) && test1(B))
-#define test3(A, B, C)     (test1(A) && test1(B) && test1(C))
-#define test4(A, B, C, D)  (test1(A) && test1(B) && test1(C) && test1(D))
-    
-  if (location == NULL)
-    return LIBQWAITCLIENT_COMPUTERS_UKNOWN;
-  
-  if (test1("cerise"))                      return LIBQWAITCLIENT_COMPUTERS_CERISE;
-  if (test3("blå", "blÅ", "blue"))          return LIBQWAITCLIENT_COMPUTERS_BLUE;
-  if (test3("röd", "rÖd", "red"))           return LIBQWAITCLIENT_COMPUTERS_RED;
-  if (test1("orange"))                      return LIBQWAITCLIENT_COMPUTERS_ORANGE;
-  if (test2("gul", "yellow"))               return LIBQWAITCLIENT_COMPUTERS_YELLOW;
-  if (test3("grön", "grÖn", "green"))       return LIBQWAITCLIENT_COMPUTERS_GREEN;
-  if (test2("brun", "brown"))               return LIBQWAITCLIENT_COMPUTERS_BROWN;
-  if (test4("grå", "grÅ", "grey", "gray"))  return LIBQWAITCLIENT_COMPUTERS_GREY;
-  if (test2("karmosin", "crimson"))         return LIBQWAITCLIENT_COMPUTERS_CRIMSON;
-  if (test2("vit", "white"))                return LIBQWAITCLIENT_COMPUTERS_WHITE;
-  if (test1("magenta"))                     return LIBQWAITCLIENT_COMPUTERS_MAGENTA;
-  if (test1("violet"))                      return LIBQWAITCLIENT_COMPUTERS_VIOLET;
-  if (test2("turkos", "turquoise"))         return LIBQWAITCLIENT_COMPUTERS_TURQUOISE;
-  if (test1("spel"))                        return LIBQWAITCLIENT_COMPUTERS_SPEL;
-  if (test1("sport"))                       return LIBQWAITCLIENT_COMPUTERS_SPORT;
-  if (test1("musik"))                       return LIBQWAITCLIENT_COMPUTERS_MUSIK;
-  if (test1("konst"))                       return LIBQWAITCLIENT_COMPUTERS_KONST;
-  if (test1("mat"))                         return LIBQWAITCLIENT_COMPUTERS_MAT;
-  
-  return LIBQWAITCLIENT_COMPUTERS_UKNOWN;
-  
-#undef test4
-#undef test3
-#undef test2
-#undef test1
+  return (int)libqwaitclient_matcher_least(&computer_matcher, location);
+}
+
+
+/**
+ * Figure out which computer room each student in a
+ * queue is sitting in, and store it in the entries
+ * 
+ * @param  positions  The queue entries
+ * @param  count      The number of elements in `positions`
+ */
+void libqwaitclient_computers_get_rooms(libqwaitclient_qwait_position_t* restrict positions, size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; i++)
+    positions[i].room = libqwaitclient_computers_get_room(positions[i].location);
 }
 
 
@@ -19,7 +19,10 @@
 #define LIBQWAITCLIENT_COMPUTERS_H
 
 
+#include "qwait-position.h"
+
 #define _GNU_SOURCE
+#include <stddef.h>
 #include <stdint.h>
 
 
@@ -148,6 +151,15 @@
  */
 int libqwaitclient_computers_get_room(const char* restrict location) __attribute__((pure));
 
+/**
+ * Figure out which computer room each student in a
+ * queue is sitting in, and store it in the entries
+ * 
+ * @param  positions  The queue entries
+ * @param  count      The number of elements in `positions`
+ */
+void libqwaitclient_computers_get_rooms(libqwaitclient_qwait_position_t* restrict positions, size_t count);
+
 /**
  * Get the official colour of a computer room, or a colour as close a possible
  * as libqwaitclient can determine that the used terminal can parse and display,
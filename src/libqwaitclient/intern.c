@@ -0,0 +1,260 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "intern.h"
+
+#include "macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_intern_t* restrict this
+
+
+
+/**
+ * Calculate the hash of a string, as used by the table
+ * 
+ * @param   string  The string
+ * @return          The hash of the string
+ */
+size_t libqwaitclient_intern_hash(const char* restrict string)
+{
+  /* FNV-1a, the strings are short, so anything fancier would not pay off. */
+  size_t hash = (size_t)2166136261UL;
+  while (*string)
+    hash = (hash ^ (size_t)(unsigned char)*string++) * (size_t)16777619UL;
+  return hash;
+}
+
+
+/**
+ * Find the slot for a string
+ * 
+ * @param   this    The table, it must have at least one slot
+ * @param   string  The string
+ * @param   hash    The hash of `string`
+ * @return          The slot with the string, or the free slot where it belongs
+ */
+static size_t __attribute__((pure)) libqwaitclient_intern_slot(const _this_, const char* restrict string, size_t hash)
+{
+  size_t mask = this->capacity - 1, i = hash & mask;
+  
+  while ((this->strings[i] != NULL) && ((this->hashes[i] != hash) || strcmp(this->strings[i], string)))
+    i = (i + 1) & mask;
+  
+  return i;
+}
+
+
+/**
+ * Initialise a table of interned strings
+ * 
+ * @param  this  The table
+ */
+void libqwaitclient_intern_initialise(_this_)
+{
+  memset(this, 0, sizeof(libqwaitclient_intern_t));
+}
+
+
+/**
+ * Release all resources in a table of interned strings,
+ * including all the strings
+ * 
+ * @param  this  The table
+ */
+void libqwaitclient_intern_destroy(_this_)
+{
+  size_t i, n = this->capacity;
+  for (i = 0; i < n; i++)
+    free(this->strings[i]);
+  free(this->strings);
+  free(this->hashes);
+  memset(this, 0, sizeof(libqwaitclient_intern_t));
+}
+
+
+/**
+ * Make sure that a number of new strings can be
+ * added without any allocation, so that
+ * `libqwaitclient_intern_adopt` cannot fail
+ * 
+ * @param   this   The table
+ * @param   count  The number of new strings
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_intern_reserve(_this_, size_t count)
+{
+  char** strings = NULL;
+  size_t* hashes = NULL;
+  size_t i, j, n = this->capacity, capacity = max(n, 16);
+  int saved_errno;
+  
+  /* Keep the table at most half full, so the probe sequences stay short. */
+  while (capacity / 2 < this->count + count)
+    capacity <<= 1;
+  if (capacity == n)
+    return 0;
+  
+  if (xcalloc(strings, capacity, char*))     goto fail;
+  if (xmalloc(hashes,  capacity, size_t))    goto fail;
+  
+  /* Move the strings to the new table. */
+  for (i = 0; i < n; i++)
+    if (this->strings[i] != NULL)
+      {
+	for (j = this->hashes[i] & (capacity - 1); strings[j] != NULL; j = (j + 1) & (capacity - 1));
+	strings[j] = this->strings[i];
+	hashes[j] = this->hashes[i];
+      }
+  
+  free(this->strings);
+  free(this->hashes);
+  this->strings = strings;
+  this->hashes = hashes;
+  this->capacity = capacity;
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  free(strings);
+  free(hashes);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Look up an interned string
+ * 
+ * @param   this    The table
+ * @param   string  The string
+ * @return          The interned string, `NULL` if not interned
+ */
+char* libqwaitclient_intern_find(const _this_, const char* restrict string)
+{
+  if (this->count == 0)
+    return NULL;
+  return this->strings[libqwaitclient_intern_slot(this, string, libqwaitclient_intern_hash(string))];
+}
+
+
+/**
+ * Intern a copy of a string
+ * 
+ * @param   this    The table
+ * @param   string  The string
+ * @return          The interned string, `NULL` on error
+ */
+char* libqwaitclient_intern_get(_this_, const char* restrict string)
+{
+  size_t hash = libqwaitclient_intern_hash(string), i;
+  
+  if (libqwaitclient_intern_reserve(this, 1) < 0)
+    return NULL;
+  
+  i = libqwaitclient_intern_slot(this, string, hash);
+  if (this->strings[i] == NULL)
+    {
+      if ((this->strings[i] = strdup(string)) == NULL)
+	return NULL;
+      this->hashes[i] = hash;
+      this->count++;
+    }
+  
+  return this->strings[i];
+}
+
+
+/**
+ * Intern a string, the table takes it over, and frees it if an
+ * equal string is already interned; adopting a string that is
+ * already interned in the table returns it and frees nothing
+ * 
+ * @param   this    The table
+ * @param   string  The string, it is not freed on error
+ * @return          The interned string, `NULL` on error, which can
+ *                  only happen if the room was not reserved with
+ *                  `libqwaitclient_intern_reserve`
+ */
+char* libqwaitclient_intern_adopt(_this_, char* string)
+{
+  size_t hash = libqwaitclient_intern_hash(string), i;
+  
+  if (libqwaitclient_intern_reserve(this, 1) < 0)
+    return NULL;
+  
+  i = libqwaitclient_intern_slot(this, string, hash);
+  if (this->strings[i] == string)
+    return string;
+  if (this->strings[i] == NULL)
+    {
+      this->strings[i] = string;
+      this->hashes[i] = hash;
+      this->count++;
+    }
+  else
+    free(string);
+  
+  return this->strings[i];
+}
+
+
+/**
+ * Remove an interned string from the table and free it,
+ * nothing is done if the string is not interned
+ * 
+ * @param  this    The table
+ * @param  string  The string, may be the interned string itself
+ */
+void libqwaitclient_intern_remove(_this_, const char* string)
+{
+  size_t i, j, k, mask = this->capacity - 1;
+  
+  if (this->count == 0)
+    return;
+  i = libqwaitclient_intern_slot(this, string, libqwaitclient_intern_hash(string));
+  if (this->strings[i] == NULL)
+    return;
+  free(this->strings[i]);
+  this->count--;
+  
+  /* Move back strings that were displaced by the
+     removed string, so that no lookup passes an unused slot. */
+  for (j = i;;)
+    {
+      this->strings[i] = NULL;
+      for (;;)
+	{
+	  j = (j + 1) & mask;
+	  if (this->strings[j] == NULL)
+	    return;
+	  k = this->hashes[j] & mask;
+	  if (((j - k) & mask) >= ((j - i) & mask))
+	    break;
+	}
+      this->strings[i] = this->strings[j];
+      this->hashes[i] = this->hashes[j];
+      i = j;
+    }
+}
+
+
+#undef _this_
+
@@ -0,0 +1,144 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_INTERN_H
+#define LIBQWAITCLIENT_INTERN_H
+
+
+#define _GNU_SOURCE
+#include <stddef.h>
+
+
+
+/**
+ * A table of interned strings, equal strings that are
+ * interned in the same table are the same pointer,
+ * so they can be compared with `==`
+ * 
+ * The table owns the strings, they must not be
+ * modified or freed, and they live until they
+ * are removed or the table is destroyed
+ */
+typedef struct libqwaitclient_intern
+{
+  /**
+   * Hash table of the strings, unused slots are `NULL`
+   */
+  char** strings;
+  
+  /**
+   * The hash of each string in `strings`
+   */
+  size_t* hashes;
+  
+  /**
+   * The number of strings in the table
+   */
+  size_t count;
+  
+  /**
+   * The number of slots in `strings`, zero or a power of two
+   */
+  size_t capacity;
+  
+} libqwaitclient_intern_t;
+
+
+
+#define _this_  libqwaitclient_intern_t* restrict this
+
+
+/**
+ * Initialise a table of interned strings
+ * 
+ * @param  this  The table
+ */
+void libqwaitclient_intern_initialise(_this_);
+
+/**
+ * Release all resources in a table of interned strings,
+ * including all the strings
+ * 
+ * @param  this  The table
+ */
+void libqwaitclient_intern_destroy(_this_);
+
+/**
+ * Make sure that a number of new strings can be
+ * added without any allocation, so that
+ * `libqwaitclient_intern_adopt` cannot fail
+ * 
+ * @param   this   The table
+ * @param   count  The number of new strings
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_intern_reserve(_this_, size_t count);
+
+/**
+ * Calculate the hash of a string, as used by the table
+ * 
+ * @param   string  The string
+ * @return          The hash of the string
+ */
+size_t libqwaitclient_intern_hash(const char* restrict string) __attribute__((pure));
+
+/**
+ * Look up an interned string
+ * 
+ * @param   this    The table
+ * @param   string  The string
+ * @return          The interned string, `NULL` if not interned
+ */
+char* libqwaitclient_intern_find(const _this_, const char* restrict string) __attribute__((pure));
+
+/**
+ * Intern a copy of a string
+ * 
+ * @param   this    The table
+ * @param   string  The string
+ * @return          The interned string, `NULL` on error
+ */
+char* libqwaitclient_intern_get(_this_, const char* restrict string);
+
+/**
+ * Intern a string, the table takes it over, and frees it if an
+ * equal string is already interned; adopting a string that is
+ * already interned in the table returns it and frees nothing
+ * 
+ * @param   this    The table
+ * @param   string  The string, it is not freed on error
+ * @return          The interned string, `NULL` on error, which can
+ *                  only happen if the room was not reserved with
+ *                  `libqwaitclient_intern_reserve`
+ */
+char* libqwaitclient_intern_adopt(_this_, char* string);
+
+/**
+ * Remove an interned string from the table and free it,
+ * nothing is done if the string is not interned
+ * 
+ * @param  this    The table
+ * @param  string  The string, may be the interned string itself
+ */
+void libqwaitclient_intern_remove(_this_, const char* string);
+
+
+#undef _this_
+
+
+#endif
+
@@ -0,0 +1,307 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "json-schema.h"
+
+#include "macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+
+
+/**
+ * Find a field in a field table
+ * 
+ * @param   fields       The field table
+ * @param   field_count  The number of elements in `fields`
+ * @param   name         The name of the member, not NUL-terminated
+ * @param   name_length  The length of `name`
+ * @return               The index of the field, -1 if not found
+ */
+long libqwaitclient_json_schema_lookup(const libqwaitclient_json_field_t* restrict fields, size_t field_count,
+				       const char* restrict name, size_t name_length)
+{
+  size_t i;
+  
+  if (name_length == 0)
+    return -1;
+  
+  /* The keys we know are short and few, and in practice the length
+     alone tells them apart, the first byte is checked before the rest
+     of the key is compared so that a mismatch is almost always found
+     without calling `memcmp`. */
+  for (i = 0; i < field_count; i++)
+    if ((fields[i].name_length == name_length) && (*(fields[i].name) == *name))
+      if (!memcmp(fields[i].name + 1, name + 1, (name_length - 1) * sizeof(char)))
+	return (long)i;
+  
+  return -1;
+}
+
+
+/**
+ * Decode a member of JSON object straight into a structure
+ * 
+ * Strings are taken out of `value` rather than copied
+ * 
+ * @param   object    The structure to fill in
+ * @param   field     The description of the member
+ * @param   value     The value of the member, strings in it are taken
+ * @param   deferred  Array where deferred members are stored, may be `NULL` if there are none
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_json_schema_decode_field(void* restrict object, const libqwaitclient_json_field_t* restrict field,
+					    libqwaitclient_json_t* restrict value,
+					    libqwaitclient_json_t** restrict deferred)
+{
+  char* base = object;
+  libqwaitclient_qwait_user_id_t* ids;
+  size_t i, n;
+
+#define member(type, offset)  (*(type*)(void*)(base + (offset)))
+
+  switch (field->type)
+    {
+    case LIBQWAITCLIENT_JSON_FIELD_NULLABLE_STRING:
+      if (value->type == LIBQWAITCLIENT_JSON_TYPE_NULL)
+	return member(char*, field->offset) = NULL, 0;
+      /* Fall through. */
+    
+    case LIBQWAITCLIENT_JSON_FIELD_STRING:
+      member(char*, field->offset) = libqwaitclient_json_steal_zstr(value);
+      return member(char*, field->offset) == NULL ? -1 : 0;
+    
+    case LIBQWAITCLIENT_JSON_FIELD_BOOLEAN:
+      return member(int, field->offset) = libqwaitclient_json_to_bool(value), member(int, field->offset) < 0 ? -1 : 0;
+    
+    case LIBQWAITCLIENT_JSON_FIELD_STRINGS:
+      if ((member(char**, field->offset) = libqwaitclient_json_steal_zstrs(value)) == NULL)
+	if (errno)
+	  return -1;
+      member(size_t, field->aux_offset) = value->length;
+      return 0;
+    
+    case LIBQWAITCLIENT_JSON_FIELD_MILLISECONDS:
+      if (value->type != LIBQWAITCLIENT_JSON_TYPE_INTEGER)
+	return errno = EINVAL, -1;
+      member(time_t, field->offset) = (time_t)(value->data.integer / 1000);
+      member(int, field->aux_offset)   = (int)(value->data.integer % 1000);
+      return 0;
+    
+    case LIBQWAITCLIENT_JSON_FIELD_DEFERRED:
+      deferred[field->offset] = value;
+      return 0;
+    
+    case LIBQWAITCLIENT_JSON_FIELD_USER_ID:
+      if (value->type == LIBQWAITCLIENT_JSON_TYPE_NULL)
+	return member(libqwaitclient_qwait_user_id_t, field->offset) = LIBQWAITCLIENT_QWAIT_USER_ID_NONE, 0;
+      if (value->type != LIBQWAITCLIENT_JSON_TYPE_STRING)
+	return errno = EINVAL, -1;
+      return libqwaitclient_qwait_user_id_parse(&member(libqwaitclient_qwait_user_id_t, field->offset),
+						value->data.string, value->length);
+    
+    case LIBQWAITCLIENT_JSON_FIELD_USER_IDS:
+      if (value->type != LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+	return errno = EINVAL, -1;
+      ids = NULL;
+      if ((n = value->length) && xmalloc(ids, n, libqwaitclient_qwait_user_id_t))
+	return -1;
+      for (i = 0; i < n; i++)
+	if ((value->data.array[i].type != LIBQWAITCLIENT_JSON_TYPE_STRING) ||
+	    libqwaitclient_qwait_user_id_parse(ids + i, value->data.array[i].data.string,
+					       value->data.array[i].length))
+	  return free(ids), errno = EINVAL, -1;
+      member(libqwaitclient_qwait_user_id_t*, field->offset) = ids;
+      member(size_t, field->aux_offset) = n;
+      return 0;
+    
+    default:
+      return errno = EINVAL, -1;
+    }
+
+#undef member
+}
+
+
+/**
+ * Decode a JSON object straight into a structure
+ * 
+ * Unknown members and missing required members are
+ * errors, if a member is repeated, the last occurrence
+ * is used and the others are ignored. On error, the members
+ * of the structure that have already been decoded are
+ * left as is, so the caller can release them.
+ * 
+ * Strings are taken out of `data` rather than copied,
+ * it should be destroyed afterwards.
+ * 
+ * @param   object       The structure to fill in
+ * @param   fields       The field table, at most `LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS` elements
+ * @param   field_count  The number of elements in `fields`
+ * @param   data         The JSON object to decode
+ * @param   deferred     Array where deferred members are stored, may be `NULL` if there are none;
+ *                       deferred members that are not present are set to `NULL`
+ * @return               Zero on success, -1 on error
+ */
+int libqwaitclient_json_schema_decode(void* restrict object, const libqwaitclient_json_field_t* restrict fields,
+				      size_t field_count, libqwaitclient_json_t* restrict data,
+				      libqwaitclient_json_t** restrict deferred)
+{
+  libqwaitclient_json_association_t* last[LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS];
+  uint32_t seen = 0, required = 0;
+  size_t i, n = data->length;
+  long field;
+  
+  if (data->type != LIBQWAITCLIENT_JSON_TYPE_OBJECT)
+    return errno = EINVAL, -1;
+  
+  if (field_count > LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS)
+    return errno = EINVAL, -1;
+  
+  /* Get the set of required fields and clear deferred members. */
+  for (i = 0; i < field_count; i++)
+    {
+      if (fields[i].required)
+	required |= (uint32_t)1 << i;
+      if (fields[i].type == LIBQWAITCLIENT_JSON_FIELD_DEFERRED)
+	deferred[fields[i].offset] = NULL;
+    }
+  
+  /* Find the members, the last occurrence of a repeated member wins. */
+  for (i = 0; i < n; i++)
+    {
+      libqwaitclient_json_association_t* restrict member = data->data.object + i;
+      
+      field = libqwaitclient_json_schema_lookup(fields, field_count, member->name, member->name_length);
+      if (field < 0)
+	return errno = EINVAL, -1;
+      
+      seen |= (uint32_t)1 << field;
+      last[field] = member;
+    }
+  
+  /* Check that everything was found. */
+  if ((seen & required) != required)
+    return errno = EINVAL, -1;
+  
+  /* Decode members. */
+  for (i = 0; i < field_count; i++)
+    if (seen & ((uint32_t)1 << i))
+      if (libqwaitclient_json_schema_decode_field(object, fields + i, &(last[i]->value), deferred) < 0)
+	return -1;
+  
+  return 0;
+}
+
+
+/**
+ * Decode a JSON object straight into a structure, from a
+ * structural index, only the members that are not deferred
+ * are decoded
+ * 
+ * Unknown members and missing required members are
+ * errors, if a member is repeated, the last occurrence
+ * is used and the others are ignored. On error, the members
+ * of the structure that have already been decoded are
+ * left as is, so the caller can release them.
+ * 
+ * @param   object       The structure to fill in
+ * @param   fields       The field table, at most `LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS` elements
+ * @param   field_count  The number of elements in `fields`
+ * @param   tape         The structural index
+ * @param   index        The index of the JSON object to decode
+ * @param   deferred     Array where the indices of deferred members are stored, may be `NULL`
+ *                       if there are none; deferred members that are not present are set to zero
+ * @return               Zero on success, -1 on error
+ */
+int libqwaitclient_json_schema_decode_tape(void* restrict object, const libqwaitclient_json_field_t* restrict fields,
+					   size_t field_count, const libqwaitclient_json_tape_t* restrict tape,
+					   size_t index, size_t* restrict deferred)
+{
+  libqwaitclient_json_t value;
+  size_t last[LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS];
+  uint32_t seen = 0, required = 0;
+  size_t i, n, key, name_length;
+  const char* name;
+  char* allocated;
+  long field;
+  int r, saved_errno;
+  
+  if (tape->entries[index].type != LIBQWAITCLIENT_JSON_TYPE_OBJECT)
+    return errno = EINVAL, -1;
+  
+  if (field_count > LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS)
+    return errno = EINVAL, -1;
+  
+  /* Get the set of required fields and clear deferred members. */
+  for (i = 0; i < field_count; i++)
+    {
+      if (fields[i].required)
+	required |= (uint32_t)1 << i;
+      if (fields[i].type == LIBQWAITCLIENT_JSON_FIELD_DEFERRED)
+	deferred[fields[i].offset] = 0;
+    }
+  
+  /* Find the members, the last occurrence of a repeated member
+     wins. The value of a member directly follows its key. */
+  n = tape->entries[index].count;
+  for (i = 0, key = index + 1; i < n; i++, key = tape->entries[key + 1].next)
+    {
+      if (libqwaitclient_json_tape_key(tape, key, &name, &name_length, &allocated) < 0)
+	return -1;
+      field = libqwaitclient_json_schema_lookup(fields, field_count, name, name_length);
+      free(allocated);
+      if (field < 0)
+	return errno = EINVAL, -1;
+      
+      seen |= (uint32_t)1 << field;
+      last[field] = key + 1;
+    }
+  
+  /* Check that everything was found. */
+  if ((seen & required) != required)
+    return errno = EINVAL, -1;
+  
+  /* Decode members. */
+  for (i = 0; i < field_count; i++)
+    {
+      if (!(seen & ((uint32_t)1 << i)))
+	continue;
+      
+      /* Deferred members are never decoded here, that is up to the caller. */
+      if (fields[i].type == LIBQWAITCLIENT_JSON_FIELD_DEFERRED)
+	{
+	  deferred[fields[i].offset] = last[i];
+	  continue;
+	}
+      
+      if (libqwaitclient_json_tape_materialise(tape, last[i], &value) < 0)
+	return -1;
+      r = libqwaitclient_json_schema_decode_field(object, fields + i, &value, NULL);
+      saved_errno = errno;
+      libqwaitclient_json_destroy(&value);
+      if (r < 0)
+	return errno = saved_errno, -1;
+    }
+  
+  return 0;
+}
+
@@ -0,0 +1,228 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_JSON_SCHEMA_H
+#define LIBQWAITCLIENT_JSON_SCHEMA_H
+
+
+#include "json.h"
+#include "json-tape.h"
+#include "qwait-user-id.h"
+
+#define _GNU_SOURCE
+#include <stddef.h>
+
+
+/**
+ * The maximum number of fields a schema may have
+ */
+#define LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS  32
+
+
+/**
+ * The member is a string that is stored as a
+ * NUL-terminated `char*` at the field's offset
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_STRING  0
+
+/**
+ * Like `LIBQWAITCLIENT_JSON_FIELD_STRING`, but
+ * `null` is also accepted, and stored as `NULL`
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_NULLABLE_STRING  1
+
+/**
+ * The member is a boolean that is stored as
+ * an `int` at the field's offset
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_BOOLEAN  2
+
+/**
+ * The member is an array of strings that is stored as
+ * a `char**` at the field's offset, the number of
+ * strings is stored as a `size_t` at the field's
+ * auxiliary offset
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_STRINGS  3
+
+/**
+ * The member is an integer number of milliseconds since
+ * the epoch, the whole seconds are stored as a `time_t`
+ * at the field's offset, and the milliseconds are stored
+ * as an `int` at the field's auxiliary offset
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_MILLISECONDS  4
+
+/**
+ * The member is not decoded, instead it is stored in
+ * the deferred array, at the index specified by the
+ * field's offset, so the caller can decode it itself
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_DEFERRED  5
+
+/**
+ * The member is a string or `null`, that is stored as a
+ * `libqwaitclient_qwait_user_id_t` at the field's offset,
+ * `null` is stored as `LIBQWAITCLIENT_QWAIT_USER_ID_NONE`
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_USER_ID  6
+
+/**
+ * The member is an array of strings that is stored as a
+ * `libqwaitclient_qwait_user_id_t*` at the field's offset,
+ * the number of user ID:s is stored as a `size_t` at the
+ * field's auxiliary offset
+ */
+#define LIBQWAITCLIENT_JSON_FIELD_USER_IDS  7
+
+
+
+/**
+ * Description of how to decode a member of a JSON object
+ */
+typedef struct libqwaitclient_json_field
+{
+  /**
+   * The name of the member
+   */
+  const char* name;
+  
+  /**
+   * The length of `name`
+   */
+  size_t name_length;
+  
+  /**
+   * How the member is decoded, `LIBQWAITCLIENT_JSON_FIELD_*`
+   */
+  int type;
+  
+  /**
+   * Whether the member must be present
+   */
+  int required;
+  
+  /**
+   * The offset of the member in the structure
+   * into which the object is decoded, or the
+   * index in the deferred array for deferred
+   * members
+   */
+  size_t offset;
+  
+  /**
+   * The auxiliary offset, used by field types
+   * that decode into two members of the structure
+   */
+  size_t aux_offset;
+  
+} libqwaitclient_json_field_t;
+
+
+/**
+ * Create an entry for a field table
+ * 
+ * @param   name:const char*   The name of the member, must be a string literal
+ * @param   type:int           How the member is decoded, `LIBQWAITCLIENT_JSON_FIELD_*`
+ * @param   required:int       Whether the member must be present
+ * @param   offset:size_t      The offset of the member in the structure
+ * @param   aux_offset:size_t  The auxiliary offset, zero if unused
+ * @return  :libqwaitclient_json_field_t  The field
+ */
+#define LIBQWAITCLIENT_JSON_FIELD(name, type, required, offset, aux_offset)  \
+  { name, sizeof(name) / sizeof(char) - 1, type, required, offset, aux_offset }
+
+
+
+/**
+ * Find a field in a field table
+ * 
+ * @param   fields       The field table
+ * @param   field_count  The number of elements in `fields`
+ * @param   name         The name of the member, not NUL-terminated
+ * @param   name_length  The length of `name`
+ * @return               The index of the field, -1 if not found
+ */
+long libqwaitclient_json_schema_lookup(const libqwaitclient_json_field_t* restrict fields, size_t field_count,
+				       const char* restrict name, size_t name_length) __attribute__((pure));
+
+/**
+ * Decode a member of JSON object straight into a structure
+ * 
+ * Strings are taken out of `value` rather than copied
+ * 
+ * @param   object    The structure to fill in
+ * @param   field     The description of the member
+ * @param   value     The value of the member, strings in it are taken
+ * @param   deferred  Array where deferred members are stored, may be `NULL` if there are none
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_json_schema_decode_field(void* restrict object, const libqwaitclient_json_field_t* restrict field,
+					    libqwaitclient_json_t* restrict value,
+					    libqwaitclient_json_t** restrict deferred);
+
+/**
+ * Decode a JSON object straight into a structure
+ * 
+ * Unknown members and missing required members are
+ * errors, if a member is repeated, the last occurrence
+ * is used and the others are ignored. On error, the members
+ * of the structure that have already been decoded are
+ * left as is, so the caller can release them.
+ * 
+ * Strings are taken out of `data` rather than copied,
+ * it should be destroyed afterwards.
+ * 
+ * @param   object       The structure to fill in
+ * @param   fields       The field table, at most `LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS` elements
+ * @param   field_count  The number of elements in `fields`
+ * @param   data         The JSON object to decode
+ * @param   deferred     Array where deferred members are stored, may be `NULL` if there are none;
+ *                       deferred members that are not present are set to `NULL`
+ * @return               Zero on success, -1 on error
+ */
+int libqwaitclient_json_schema_decode(void* restrict object, const libqwaitclient_json_field_t* restrict fields,
+				      size_t field_count, libqwaitclient_json_t* restrict data,
+				      libqwaitclient_json_t** restrict deferred);
+
+/**
+ * Decode a JSON object straight into a structure, from a
+ * structural index, only the members that are not deferred
+ * are decoded
+ * 
+ * Unknown members and missing required members are
+ * errors, if a member is repeated, the last occurrence
+ * is used and the others are ignored. On error, the members
+ * of the structure that have already been decoded are
+ * left as is, so the caller can release them.
+ * 
+ * @param   object       The structure to fill in
+ * @param   fields       The field table, at most `LIBQWAITCLIENT_JSON_SCHEMA_MAX_FIELDS` elements
+ * @param   field_count  The number of elements in `fields`
+ * @param   tape         The structural index
+ * @param   index        The index of the JSON object to decode
+ * @param   deferred     Array where the indices of deferred members are stored, may be `NULL`
+ *                       if there are none; deferred members that are not present are set to zero
+ * @return               Zero on success, -1 on error
+ */
+int libqwaitclient_json_schema_decode_tape(void* restrict object, const libqwaitclient_json_field_t* restrict fields,
+					   size_t field_count, const libqwaitclient_json_tape_t* restrict tape,
+					   size_t index, size_t* restrict deferred);
+
+
+#endif
+
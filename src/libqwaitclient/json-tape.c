@@ -0,0 +1,392 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "json-tape.h"
+
+#include "macros.h"
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_json_tape_t* restrict this
+
+
+#define t(expression)  if (expression)  goto fail
+
+
+/**
+ * Check whether a character is whitespace allowed by JSON
+ * 
+ * @param   c:char  The character
+ * @return  :int    Whether the character is whitespace
+ */
+#define IS_JSON_WHITESPACE(c)  \
+  (((c) == ' ') || ((c) == '\t') || ((c) == '\n') || ((c) == '\r'))
+
+/**
+ * Skip whitespaces in a JSON code
+ * 
+ * @scope  p:size_t                The number of read characters, will be updated
+ * @scope  length:const size_t     The length of the code
+ * @scope  code:const char* const  The code
+ */
+#define SKIP_JSON_WHITESPACE  \
+  while ((p < length) && IS_JSON_WHITESPACE(code[p]))  \
+    p++
+
+
+
+/**
+ * Initialise a JSON tape
+ * 
+ * @param  this  The tape
+ */
+void libqwaitclient_json_tape_initialise(_this_)
+{
+  memset(this, 0, sizeof(libqwaitclient_json_tape_t));
+}
+
+
+/**
+ * Release all resources in a JSON tape
+ * 
+ * @param  this  The tape
+ */
+void libqwaitclient_json_tape_destroy(_this_)
+{
+  free(this->entries);
+  memset(this, 0, sizeof(libqwaitclient_json_tape_t));
+}
+
+
+/**
+ * Add a value to a JSON tape
+ * 
+ * @param   this    The tape
+ * @param   type    The data type of the value
+ * @param   offset  Where in the code the value's encoding begins
+ * @param   length  The length of the value's encoding, zero if not yet known
+ * @return          Zero on success, -1 on error
+ */
+static int libqwaitclient_json_tape_push(_this_, int type, size_t offset, size_t length)
+{
+  libqwaitclient_json_tape_entry_t* new;
+  libqwaitclient_json_tape_entry_t* restrict entry;
+  
+  if (this->count == this->allocated)
+    {
+      new = this->entries;
+      if (xrealloc(new, this->allocated <<= 1, libqwaitclient_json_tape_entry_t))
+	return this->allocated >>= 1, -1;
+      this->entries = new;
+    }
+  
+  entry = this->entries + this->count++;
+  entry->type    = type;
+  entry->offset  = offset;
+  entry->length  = length;
+  entry->count   = 0;
+  entry->next    = this->count;
+  entry->skipped = 0;
+  return 0;
+}
+
+
+/**
+ * Build a structural index of a JSON structure, without
+ * decoding any of its values
+ * 
+ * Only the structure is validated, strings, numbers are
+ * validated when they are decoded
+ * 
+ * @param   this    The tape to fill in
+ * @param   code    The serialised JSON structure, it must not be
+ *                  modified or freed before the tape is destroyed
+ * @param   length  The length of `code`
+ * @return          Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_build(_this_, const char* restrict code, size_t length)
+{
+  return libqwaitclient_json_tape_build_shallow(this, code, length, SIZE_MAX);
+}
+
+
+/**
+ * Build a structural index of the outermost levels of a JSON
+ * structure, without decoding any of its values
+ * 
+ * Arrays and objects nested deeper than `max_depth` are skipped
+ * rather than indexed: they get an entry with `skipped` set and
+ * `count` filled in, but their contents get no entries. They
+ * can still be decoded with `libqwaitclient_json_tape_materialise`.
+ * 
+ * @param   this       The tape to fill in
+ * @param   code       The serialised JSON structure, it must not be
+ *                     modified or freed before the tape is destroyed
+ * @param   length     The length of `code`
+ * @param   max_depth  The number of levels of arrays and objects to index,
+ *                     the outermost value is on level zero
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_build_shallow(_this_, const char* restrict code, size_t length, size_t max_depth)
+{
+  size_t* stack = NULL;
+  size_t* new_stack;
+  size_t stack_size = 16, depth = 0;
+  size_t p = 0, i, top;
+  int saved_errno, is_float;
+  char c;
+  
+  this->code = code;
+  this->count = 0;
+  
+  /* A value is seldom shorter than eight bytes with its delimiters. */
+  if (this->allocated == 0)
+    {
+      this->allocated = max(length / 8, 16);
+      t (xmalloc(this->entries, this->allocated, libqwaitclient_json_tape_entry_t));
+    }
+  t (xmalloc(stack, stack_size, size_t));
+  
+  for (;;)
+    {
+      SKIP_JSON_WHITESPACE;
+      
+      /* Index the key if we are in an object. */
+      if (depth && (this->entries[stack[depth - 1]].type == LIBQWAITCLIENT_JSON_TYPE_OBJECT))
+	{
+	  if ((p == length) || (code[p] != '"'))
+	    goto einval;
+	  t ((i = libqwaitclient_json_skip(code + p, length - p, NULL)) == 0);
+	  t (libqwaitclient_json_tape_push(this, LIBQWAITCLIENT_JSON_TYPE_STRING, p, i));
+	  p += i;
+	  SKIP_JSON_WHITESPACE;
+	  if ((p == length) || (code[p++] != ':'))
+	    goto einval;
+	  SKIP_JSON_WHITESPACE;
+	}
+      
+      /* Index the value. */
+      if (p == length)
+	goto einval;
+      c = code[p];
+      if (((c == '[') || (c == '{')) && (depth >= max_depth))
+	{
+	  /* Too deep, only count what is in it. */
+	  t (libqwaitclient_json_tape_push(this, c == '[' ? LIBQWAITCLIENT_JSON_TYPE_ARRAY
+						       : LIBQWAITCLIENT_JSON_TYPE_OBJECT, p, 0));
+	  top = this->count - 1;
+	  t ((i = libqwaitclient_json_skip(code + p, length - p, &(this->entries[top].count))) == 0);
+	  this->entries[top].length = i;
+	  this->entries[top].skipped = 1;
+	  p += i;
+	}
+      else if ((c == '[') || (c == '{'))
+	{
+	  t (libqwaitclient_json_tape_push(this, c == '[' ? LIBQWAITCLIENT_JSON_TYPE_ARRAY
+						       : LIBQWAITCLIENT_JSON_TYPE_OBJECT, p, 0));
+	  if (depth == stack_size)
+	    {
+	      new_stack = stack;
+	      t (xrealloc(new_stack, stack_size <<= 1, size_t));
+	      stack = new_stack;
+	    }
+	  stack[depth++] = this->count - 1;
+	  p++;
+	  SKIP_JSON_WHITESPACE;
+	  
+	  /* Check for empty array or object. (Edge case) */
+	  if ((p < length) && (code[p] == (c == '[' ? ']' : '}')))
+	    {
+	      top = stack[--depth];
+	      this->entries[top].length = ++p - this->entries[top].offset;
+	      goto value_done;
+	    }
+	  continue;
+	}
+      else if (c == '"')
+	{
+	  t ((i = libqwaitclient_json_skip(code + p, length - p, NULL)) == 0);
+	  t (libqwaitclient_json_tape_push(this, LIBQWAITCLIENT_JSON_TYPE_STRING, p, i));
+	  p += i;
+	}
+      else if ((length - p >= 4) && !memcmp(code + p, "null", 4 * sizeof(char)))
+	{
+	  t (libqwaitclient_json_tape_push(this, LIBQWAITCLIENT_JSON_TYPE_NULL, p, 4));
+	  p += 4;
+	}
+      else if ((length - p >= 4) && !memcmp(code + p, "true", 4 * sizeof(char)))
+	{
+	  t (libqwaitclient_json_tape_push(this, LIBQWAITCLIENT_JSON_TYPE_BOOLEAN, p, 4));
+	  p += 4;
+	}
+      else if ((length - p >= 5) && !memcmp(code + p, "false", 5 * sizeof(char)))
+	{
+	  t (libqwaitclient_json_tape_push(this, LIBQWAITCLIENT_JSON_TYPE_BOOLEAN, p, 5));
+	  p += 5;
+	}
+      else
+	{
+	  for (i = p, is_float = 0; i < length; i++)
+	    if ((('0' <= code[i]) && (code[i] <= '9')) || (code[i] == '-') || (code[i] == '+'))
+	      continue;
+	    else if ((code[i] == '.') || (code[i] == 'e') || (code[i] == 'E'))
+	      is_float = 1;
+	    else
+	      break;
+	  if (i == p)
+	    goto einval;
+	  t (libqwaitclient_json_tape_push(this, is_float ? LIBQWAITCLIENT_JSON_TYPE_FLOATING
+							  : LIBQWAITCLIENT_JSON_TYPE_INTEGER, p, i - p));
+	  p = i;
+	}
+    
+    value_done:
+      /* Close the arrays and objects whose last value we have read. */
+      for (;;)
+	{
+	  if (depth == 0)
+	    goto done;
+	  top = stack[depth - 1];
+	  this->entries[top].count++;
+	  SKIP_JSON_WHITESPACE;
+	  if (p == length)
+	    goto einval;
+	  c = code[p++];
+	  if (c == ',')
+	    break;
+	  if (c != (this->entries[top].type == LIBQWAITCLIENT_JSON_TYPE_ARRAY ? ']' : '}'))
+	    goto einval;
+	  this->entries[top].length = p - this->entries[top].offset;
+	  this->entries[top].next = this->count;
+	  depth--;
+	}
+    }
+  
+ done:
+  /* Require that everything was part of the JSON code. */
+  SKIP_JSON_WHITESPACE;
+  if (p < length)
+    goto einval;
+  free(stack);
+  return 0;
+  
+ einval:
+  errno = EINVAL;
+ fail:
+  saved_errno = errno;
+  free(stack);
+  this->count = 0;
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Find a member of an object
+ * 
+ * Keys are compared in their encoded form, unless
+ * they contain escapes, in which case they are decoded
+ * 
+ * @param   this         The tape
+ * @param   object       The index of the object
+ * @param   name         The name of the member
+ * @param   name_length  The length of `name`
+ * @return               The index of the value of the member, zero if not found
+ */
+size_t libqwaitclient_json_tape_member(const _this_, size_t object, const char* restrict name, size_t name_length)
+{
+  const char* key_name;
+  size_t i, n, key, key_length;
+  char* allocated;
+  int found;
+  
+  if ((this->entries[object].type != LIBQWAITCLIENT_JSON_TYPE_OBJECT) || this->entries[object].skipped)
+    return 0;
+  
+  for (i = 0, n = this->entries[object].count, key = object + 1; i < n; i++, key = this->entries[key + 1].next)
+    {
+      if (libqwaitclient_json_tape_key(this, key, &key_name, &key_length, &allocated) < 0)
+	return 0;
+      found = (key_length == name_length) && !memcmp(key_name, name, name_length * sizeof(char));
+      free(allocated);
+      if (found)
+	return key + 1;
+    }
+  
+  return 0;
+}
+
+
+/**
+ * Decode the key of an object member
+ * 
+ * @param   this         The tape
+ * @param   key          The index of the key
+ * @param   name         Output parameter for the key, it will point into
+ *                       the code, unless `*allocated` is set to non-`NULL`
+ * @param   name_length  Output parameter for the length of `*name`
+ * @param   allocated    Output parameter for the allocation of `*name`
+ *                       if the key had to be decoded, the caller must
+ *                       free it; otherwise it is set to `NULL`
+ * @return               Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_key(const _this_, size_t key, const char** restrict name,
+				 size_t* restrict name_length, char** restrict allocated)
+{
+  const libqwaitclient_json_tape_entry_t* restrict entry = this->entries + key;
+  libqwaitclient_json_t decoded;
+  
+  *allocated = NULL;
+  if (entry->type != LIBQWAITCLIENT_JSON_TYPE_STRING)
+    return errno = EINVAL, -1;
+  
+  /* Without escapes, the key is its own encoding, without the quotes. */
+  *name = this->code + entry->offset + 1;
+  *name_length = entry->length - 2;
+  if (memchr(*name, '\\', *name_length * sizeof(char)) == NULL)
+    return 0;
+  
+  if (libqwaitclient_json_tape_materialise(this, key, &decoded) < 0)
+    return -1;
+  *name = *allocated = decoded.data.string;
+  *name_length = decoded.length;
+  return 0;
+}
+
+
+/**
+ * Decode a value, and everything in it
+ * 
+ * @param   this   The tape
+ * @param   index  The index of the value
+ * @param   value  Output parameter for the value
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_materialise(const _this_, size_t index, libqwaitclient_json_t* restrict value)
+{
+  const libqwaitclient_json_tape_entry_t* restrict entry = this->entries + index;
+  return libqwaitclient_json_parse(value, this->code + entry->offset, entry->length);
+}
+
+
+#undef SKIP_JSON_WHITESPACE
+#undef IS_JSON_WHITESPACE
+#undef _this_
+
@@ -0,0 +1,209 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_JSON_TAPE_H
+#define LIBQWAITCLIENT_JSON_TAPE_H
+
+
+#include "json.h"
+
+#define _GNU_SOURCE
+#include <stddef.h>
+
+
+
+/**
+ * A value in a structural index of a JSON structure
+ */
+typedef struct libqwaitclient_json_tape_entry
+{
+  /**
+   * The data type, `LIBQWAITCLIENT_JSON_TYPE_*`
+   * 
+   * Numbers are indexed as `LIBQWAITCLIENT_JSON_TYPE_INTEGER`
+   * or `LIBQWAITCLIENT_JSON_TYPE_FLOATING`, whether an integer
+   * is a `LIBQWAITCLIENT_JSON_TYPE_LARGE_INTEGER` is not known
+   * until it is decoded
+   */
+  int type;
+  
+  /**
+   * Where in the code the value's encoding begins
+   */
+  size_t offset;
+  
+  /**
+   * The length of the value's encoding, including
+   * quotes and brackets
+   */
+  size_t length;
+  
+  /**
+   * The number of elements in an array or members
+   * in an object, zero for other types
+   */
+  size_t count;
+  
+  /**
+   * The index of the first entry after this value
+   * and all values contained in it
+   */
+  size_t next;
+  
+  /**
+   * Non-zero if the value is an array or object whose
+   * contents were skipped rather than indexed, `count`
+   * is set, but the contents have no entries
+   */
+  int skipped;
+  
+} libqwaitclient_json_tape_entry_t;
+
+
+/**
+ * A structural index of a JSON structure
+ * 
+ * The values are stored in the order they appear in the
+ * code. The first element of an array is stored directly
+ * after the array, and the following elements are found
+ * by following `next`. Members of an object are stored
+ * as their key, which is a string, directly followed by
+ * their value.
+ */
+typedef struct libqwaitclient_json_tape
+{
+  /**
+   * The indexed code, it is not owned by the tape
+   */
+  const char* code;
+  
+  /**
+   * The values in the code
+   */
+  libqwaitclient_json_tape_entry_t* entries;
+  
+  /**
+   * The number of elements in `entries`
+   */
+  size_t count;
+  
+  /**
+   * The allocation size of `entries`
+   */
+  size_t allocated;
+  
+} libqwaitclient_json_tape_t;
+
+
+
+#define _this_  libqwaitclient_json_tape_t* restrict this
+
+
+/**
+ * Initialise a JSON tape
+ * 
+ * @param  this  The tape
+ */
+void libqwaitclient_json_tape_initialise(_this_);
+
+/**
+ * Release all resources in a JSON tape
+ * 
+ * @param  this  The tape
+ */
+void libqwaitclient_json_tape_destroy(_this_);
+
+/**
+ * Build a structural index of a JSON structure, without
+ * decoding any of its values
+ * 
+ * Only the structure is validated, strings, numbers are
+ * validated when they are decoded
+ * 
+ * @param   this    The tape to fill in
+ * @param   code    The serialised JSON structure, it must not be
+ *                  modified or freed before the tape is destroyed
+ * @param   length  The length of `code`
+ * @return          Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_build(_this_, const char* restrict code, size_t length);
+
+/**
+ * Build a structural index of the outermost levels of a JSON
+ * structure, without decoding any of its values
+ * 
+ * Arrays and objects nested deeper than `max_depth` are skipped
+ * rather than indexed: they get an entry with `skipped` set and
+ * `count` filled in, but their contents get no entries. They
+ * can still be decoded with `libqwaitclient_json_tape_materialise`.
+ * 
+ * @param   this       The tape to fill in
+ * @param   code       The serialised JSON structure, it must not be
+ *                     modified or freed before the tape is destroyed
+ * @param   length     The length of `code`
+ * @param   max_depth  The number of levels of arrays and objects to index,
+ *                     the outermost value is on level zero
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_build_shallow(_this_, const char* restrict code, size_t length, size_t max_depth);
+
+/**
+ * Find a member of an object
+ * 
+ * Keys are compared in their encoded form, unless
+ * they contain escapes, in which case they are decoded
+ * 
+ * @param   this         The tape
+ * @param   object       The index of the object
+ * @param   name         The name of the member
+ * @param   name_length  The length of `name`
+ * @return               The index of the value of the member, zero if not found
+ */
+size_t libqwaitclient_json_tape_member(const _this_, size_t object, const char* restrict name, size_t name_length);
+
+/**
+ * Decode the key of an object member
+ * 
+ * @param   this         The tape
+ * @param   key          The index of the key
+ * @param   name         Output parameter for the key, it will point into
+ *                       the code, unless `*allocated` is set to non-`NULL`
+ * @param   name_length  Output parameter for the length of `*name`
+ * @param   allocated    Output parameter for the allocation of `*name`
+ *                       if the key had to be decoded, the caller must
+ *                       free it; otherwise it is set to `NULL`
+ * @return               Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_key(const _this_, size_t key, const char** restrict name,
+				 size_t* restrict name_length, char** restrict allocated);
+
+/**
+ * Decode a value, and everything in it
+ * 
+ * @param   this   The tape
+ * @param   index  The index of the value
+ * @param   value  Output parameter for the value
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_json_tape_materialise(const _this_, size_t index, libqwaitclient_json_t* restrict value);
+
+
+#undef _this_
+
+
+#endif
+
@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <float.h>
 #include <errno.h>
 
 
@@ -30,6 +31,12 @@
  */
 #define JSON_WHITESPACE  " \t\n\r"
 
+/**
+ * The number of nested arrays and objects that
+ * can be handled without allocating a stack
+ */
+#define JSON_STACK_SIZE  32
+
 
 #if defined(DEBUG) && defined(__GNUC__)
 # pragma GCC diagnostic push
@@ -47,17 +54,6 @@
 
 
 
-/**
- * Parse a part of a JSON structure
- * 
- * @param   this    The JSON structure to fill in
- * @param   code    The serialised JSON structure from where we should begin
- * @param   length  The length of `code` (what is remaining of the original code)
- * @return          The number of read char:s, zero on error
- */
-static size_t libqwaitclient_json_subparse(_this_, const char* restrict code, size_t length);
-
-
 /**
  * Release all resources in a JSON structure
  * 
@@ -65,27 +61,71 @@ static size_t libqwaitclient_json_subparse(_this_, const char* restrict code, si
  */
 void libqwaitclient_json_destroy(_this_)
 {
-  size_t i, n = this->length;
-  
-  if (this->type == LIBQWAITCLIENT_JSON_TYPE_LARGE_INTEGER)
-    free(this->data.large_integer), this->data.large_integer = NULL;
-  else if (this->type == LIBQWAITCLIENT_JSON_TYPE_STRING)
-    free(this->data.string), this->data.string = NULL;
-  else if (this->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+  libqwaitclient_json_t* stack_static[JSON_STACK_SIZE];
+  libqwaitclient_json_t** stack = stack_static;
+  libqwaitclient_json_t** new_stack;
+  libqwaitclient_json_t* restrict node;
+  libqwaitclient_json_t* restrict child;
+  size_t depth = 1, stack_size = JSON_STACK_SIZE;
+  
+  /* Arrays and objects are destroyed without recursion: their elements
+     are taken from the end, one by one, and pushed onto a stack, and
+     when a value has nothing left in it, it is released and popped. */
+  stack[0] = this;
+  while (depth)
     {
-      for (i = 0; i < n; i++)
-	libqwaitclient_json_destroy(this->data.array + i);
-      free(this->data.array), this->data.array = NULL;
-    }
-  else if (this->type == LIBQWAITCLIENT_JSON_TYPE_OBJECT)
-    {
-      for (i = 0; i < n; i++)
+      node = stack[depth - 1];
+      
+      if ((node->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY) && node->length)
+	child = node->data.array + --(node->length);
+      else if ((node->type == LIBQWAITCLIENT_JSON_TYPE_OBJECT) && node->length)
+	{
+	  node->length--;
+	  free(node->data.object[node->length].name);
+	  child = &(node->data.object[node->length].value);
+	}
+      else
+	{
+	  if (node->type == LIBQWAITCLIENT_JSON_TYPE_LARGE_INTEGER)
+	    free(node->data.large_integer), node->data.large_integer = NULL;
+	  else if (node->type == LIBQWAITCLIENT_JSON_TYPE_STRING)
+	    free(node->data.string), node->data.string = NULL;
+	  else if (node->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+	    free(node->data.array), node->data.array = NULL;
+	  else if (node->type == LIBQWAITCLIENT_JSON_TYPE_OBJECT)
+	    free(node->data.object), node->data.object = NULL;
+	  depth--;
+	  continue;
+	}
+      
+      if (depth == stack_size)
 	{
-	  free(this->data.object[i].name);
-	  libqwaitclient_json_destroy(&(this->data.object[i].value));
+	  /* Without memory for a larger stack, we have to use our call stack. */
+	  if (stack == stack_static)
+	    {
+	      if (xmalloc(new_stack, stack_size << 1, libqwaitclient_json_t*))
+		{
+		  libqwaitclient_json_destroy(child);
+		  continue;
+		}
+	      memcpy(new_stack, stack, stack_size * sizeof(libqwaitclient_json_t*));
+	    }
+	  else
+	    {
+	      new_stack = stack;
+	      if (xrealloc(new_stack, stack_size << 1, libqwaitclient_json_t*))
+		{
+		  libqwaitclient_json_destroy(child);
+		  continue;
+		}
+	    }
+	  stack = new_stack, stack_size <<= 1;
 	}
-      free(this->data.object), this->data.object = NULL;
+      stack[depth++] = child;
     }
+  
+  if (stack != stack_static)
+    free(stack);
 }
 
 
@@ -160,6 +200,66 @@ char** libqwaitclient_json_to_zstrs(const _this_)
 }
 
 
+/**
+ * Take the string out of a JSON string as a NUL-terminated string,
+ * without copying it, the JSON string is left empty
+ * 
+ * The string must have been parsed by `libqwaitclient_json_parse`,
+ * which leaves room for the NUL-termination
+ * 
+ * @param   this  The JSON string
+ * @return        The string in NUL-terminated format, `NULL` on error
+ */
+char* libqwaitclient_json_steal_zstr(_this_)
+{
+  char* rc;
+  
+  if (this->type != LIBQWAITCLIENT_JSON_TYPE_STRING)
+    return D("expected string type",), errno = EINVAL, NULL;
+  
+  rc = this->data.string;
+  this->data.string = NULL;
+  this->length = 0;
+  
+  return rc;
+}
+
+
+/**
+ * Take the strings out of a JSON string array as an array of
+ * NUL-terminated strings, without copying them, the JSON
+ * strings are left empty
+ * 
+ * The strings must have been parsed by `libqwaitclient_json_parse`,
+ * which leaves room for the NUL-termination. Nothing is taken if
+ * any element is not a string.
+ * 
+ * @param   this  The JSON string array
+ * @return        The array of NUL-termianted strings, `NULL` on error
+ */
+char** libqwaitclient_json_steal_zstrs(_this_)
+{
+  char** rc;
+  size_t i, n = this->length;
+  
+  if (this->type != LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+    return D("expected string type",), errno = EINVAL, NULL;
+  
+  /* Check everything before anything is taken. */
+  for (i = 0; i < n; i++)
+    if (this->data.array[i].type != LIBQWAITCLIENT_JSON_TYPE_STRING)
+      return D("expected string type",), errno = EINVAL, NULL;
+  
+  if (xmalloc(rc, n, char*))
+    return NULL;
+  
+  for (i = 0; i < n; i++)
+    rc[i] = libqwaitclient_json_steal_zstr(this->data.array + i);
+  
+  return errno = 0, rc;
+}
+
+
 /**
  * Parse a part of a JSON structure that is a string
  * 
@@ -402,11 +502,13 @@ static size_t libqwaitclient_json_subparse_string(_this_, const char* restrict c
   free(utf32);
   this->length = read_length - j;
   memmove(utf8, utf8 + j, this->length);
+  utf8[this->length] = '\0';
 #undef utf8
   
-  /* Shrink the string's allocation so it is not unnecessarily large. */
+  /* Shrink the string's allocation so it is not unnecessarily large,
+     but keep the NUL-termination so that the string can be stolen. */
   new = this->data.string;
-  if (xrealloc(new, this->length, char) && (this->length))
+  if (xrealloc(new, this->length + 1, char))
     return 0;
   this->data.string = new;
   
@@ -415,187 +517,101 @@ static size_t libqwaitclient_json_subparse_string(_this_, const char* restrict c
 
 
 /**
- * Skip whitespaces in a JSON code
- * 
- * @scope  parsed:size_t           The number of read characters, will be updated
- * @scope  length:const size_t     The length of the code
- * @scope  code:const char* const  The code
+ * Powers of ten that fit in an `uint64_t`
  */
-#define SKIP_JSON_WHITESPACE								\
-  while ((parsed < length) && code[parsed] && strchr(JSON_WHITESPACE, code[parsed]))	\
-    parsed++
+static const uint64_t libqwaitclient_json_powers_of_ten[20] =
+  {
+    UINT64_C(1),
+    UINT64_C(10),
+    UINT64_C(100),
+    UINT64_C(1000),
+    UINT64_C(10000),
+    UINT64_C(100000),
+    UINT64_C(1000000),
+    UINT64_C(10000000),
+    UINT64_C(100000000),
+    UINT64_C(1000000000),
+    UINT64_C(10000000000),
+    UINT64_C(100000000000),
+    UINT64_C(1000000000000),
+    UINT64_C(10000000000000),
+    UINT64_C(100000000000000),
+    UINT64_C(1000000000000000),
+    UINT64_C(10000000000000000),
+    UINT64_C(100000000000000000),
+    UINT64_C(1000000000000000000),
+    UINT64_C(10000000000000000000)
+  };
 
 
 /**
- * Parse a part of a JSON structure that is an array
+ * Parse eight decimal digits at once
  * 
- * @param   this    The JSON structure to fill in
- * @param   code    The serialised JSON structure from where we should begin
- * @param   length  The length of `code` (what is remaining of the original code)
- * @return          The number of read char:s, zero on error
+ * @param   code   The digits, does not need to be aligned
+ * @param   value  Output parameter for the value of the digits
+ * @return         Zero on success, -1 if any of the characters is not a digit
  */
-static size_t libqwaitclient_json_subparse_array(_this_, const char* restrict code, size_t length)
+static int libqwaitclient_json_parse_eight_digits(const char* restrict code, uint64_t* restrict value)
 {
-  size_t allocated = 16;
-  size_t parsed = 1;
-  size_t subparsed;
-  
-  SKIP_JSON_WHITESPACE;
-  
-  /* It is an error if the code ends without a ']'. */
-  if (parsed == length)
-    return D("opened array without elements or closer",), errno = EINVAL, 0U;
-  
-  /* Check for empty array. (Edge case) */
-  if (code[parsed] == ']')
-    return parsed + 1;
-  
-  if (xmalloc(this->data.array, allocated, libqwaitclient_json_t))
-    return 0U;
-  
-  do
-    {
-      /* Make sure another element can be added. */
-      if (this->length == allocated)
-	{
-	  libqwaitclient_json_t* new = this->data.array;
-	  if (xrealloc(new, allocated <<= 1, libqwaitclient_json_t))
-	    return 0;
-	  this->data.array = new;
-	}
-      
-      SKIP_JSON_WHITESPACE;
-      
-      /* Parse next element. */
-      subparsed = libqwaitclient_json_subparse(this->data.array + this->length, code + parsed, length - parsed);
-      this->length++;
-      if (subparsed == 0)
-	return 0;
-      parsed += subparsed;
-      
-      SKIP_JSON_WHITESPACE;
-      
-      /* It is an error if the code ends without a ']'. */
-      if (parsed == length)
-	return D("premature end of array",), errno = EINVAL, 0U;
-      
-    } while (code[parsed++] == ',');
-  
-  /* It is an error if the code ends without a ']'. */
-  if (code[parsed - 1] != ']') /* The `while();` increased `parsed`. */
-    return D("array ended but not with the correct symbol",), errno = EINVAL, 0U;
-  
-  /* Shrink the allocated to fit the elements exactly. */
-  if (allocated > this->length)
-    {
-      libqwaitclient_json_t* new = this->data.array;
-      if (xrealloc(new, this->length, libqwaitclient_json_t) && (this->length))
-	return 0;
-      this->data.array = new;
-    }
+  uint64_t word = 0;
+  int i;
+  
+  /* Load the digits so that the first digit is in the least
+     significant byte, regardless of the byte order. */
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+  memcpy(&word, code, 8 * sizeof(char));
+  (void) i;
+#else
+  for (i = 8; i--;)
+    word = (word << 8) | (uint64_t)(unsigned char)(code[i]);
+#endif
+
+  /* Every byte must be in [0x30, 0x39], that is, have 3 in its high
+     nibble both before and after adding 6 to it. */
+  if (((word & UINT64_C(0xF0F0F0F0F0F0F0F0)) != UINT64_C(0x3030303030303030)) ||
+      (((word + UINT64_C(0x0606060606060606)) & UINT64_C(0xF0F0F0F0F0F0F0F0)) != UINT64_C(0x3030303030303030)))
+    return -1;
   
-  return parsed;
+  /* Combine the digits pairwise, then the pairs pairwise, and so on. */
+  word -= UINT64_C(0x3030303030303030);
+  word = (word * 10) + (word >> 8);
+  word = (((word & UINT64_C(0x000000FF000000FF)) * (100 + (UINT64_C(1000000) << 32))) +
+	  (((word >> 16) & UINT64_C(0x000000FF000000FF)) * (1 + (UINT64_C(10000) << 32)))) >> 32;
+  *value = word & UINT64_C(0xFFFFFFFF);
+  return 0;
 }
 
 
 /**
- * Parse a part of a JSON structure that is an object
+ * Parse a string of at most 19 decimal digits
  * 
- * @param   this    The JSON structure to fill in
- * @param   code    The serialised JSON structure from where we should begin
- * @param   length  The length of `code` (what is remaining of the original code)
- * @return          The number of read char:s, zero on error
+ * @param   code    The digits
+ * @param   length  The number of digits, at most 19
+ * @param   value   Output parameter for the value of the digits
+ * @return          Zero on success, -1 if any of the characters is not a digit
  */
-static size_t libqwaitclient_json_subparse_object(_this_, const char* restrict code, size_t length)
+static int libqwaitclient_json_parse_digits(const char* restrict code, size_t length, uint64_t* restrict value)
 {
-  size_t allocated = 16;
-  size_t parsed = 1;
-  size_t subparsed;
-  
-  SKIP_JSON_WHITESPACE;
-  
-  /* It is an error if the code ends without a '}'. */
-  if (parsed == length)
-    return D("opened array without elements or closer",), errno = EINVAL, 0U;
-  
-  /* Check for empty object. (Edge case) */
-  if (code[parsed] == '}')
-    return parsed + 1;
+  uint64_t rc = 0, eight;
   
-  if (xmalloc(this->data.object, allocated, libqwaitclient_json_t))
-    return 0U;
-  
-  do
+  for (; length >= 8; code += 8, length -= 8)
     {
-      #define NEXT  (this->data.object[this->length])
-      
-      /* Make sure another member can be added. */
-      if (this->length == allocated)
-	{
-	  libqwaitclient_json_association_t* new = this->data.object;
-	  if (xrealloc(new, allocated <<= 1, libqwaitclient_json_t))
-	    return 0;
-	  this->data.object = new;
-	}
-      
-      SKIP_JSON_WHITESPACE;
-      
-      /* Parse next member's name. */
-      NEXT.name = NULL;
-      subparsed = libqwaitclient_json_subparse(&(NEXT.value), code + parsed, length - parsed);
-      if (subparsed == 0)
-	return 0;
-      if (NEXT.value.type != LIBQWAITCLIENT_JSON_TYPE_STRING)
-	return D("object key was not a string",), this->length++, errno = EINVAL, 0U;
-      NEXT.name = NEXT.value.data.string;
-      NEXT.name_length = NEXT.value.length;
-      memset(&(NEXT.value), 0, sizeof(libqwaitclient_json_t));
-      parsed += subparsed;
-      
-      SKIP_JSON_WHITESPACE;
-      
-      /* ':' delimits a member's name and its value. */
-      if ((parsed == length) || (code[parsed++] != ':'))
-	return D("invalid delimiter between object key and value",), free(NEXT.name), errno = EINVAL, 0U;
-      
-      SKIP_JSON_WHITESPACE;
-      
-      /* Parse next member's value. */
-      subparsed = libqwaitclient_json_subparse(&(NEXT.value), code + parsed, length - parsed);
-      this->length++;
-      if (subparsed == 0)
-	return 0U;
-      parsed += subparsed;
-      
-      SKIP_JSON_WHITESPACE;
-      
-      /* It is an error if the code ends without a '}'. */
-      if (parsed == length)
-	return D("premature end of object",), errno = EINVAL, 0U;
-      
-      #undef NEXT
-    } while (code[parsed++] == ',');
-  
-  /* It is an error if the code ends without a '}'. */
-  if (code[parsed - 1] != '}') /* The `while();` increased `parsed`. */
-    return D("array ended but not with the correct symbol",), errno = EINVAL, 0U;
-  
-  /* Shrink the allocated to fit the members exactly. */
-  if (allocated > this->length)
+      if (libqwaitclient_json_parse_eight_digits(code, &eight) < 0)
+	return -1;
+      rc = rc * UINT64_C(100000000) + eight;
+    }
+  for (; length; code++, length--)
     {
-      libqwaitclient_json_association_t* new = this->data.object;
-      if (xrealloc(new, this->length, libqwaitclient_json_association_t) && (this->length))
-	return 0U;
-      this->data.object = new;
+      if ((*code < '0') || ('9' < *code))
+	return -1;
+      rc = rc * 10 + (uint64_t)(*code - '0');
     }
   
-  return parsed;
+  *value = rc;
+  return 0;
 }
 
 
-#undef SKIP_JSON_WHITESPACE
-
-
 /**
  * Parse a part of a JSON structure that is an integer
  * 
@@ -606,11 +622,8 @@ static size_t libqwaitclient_json_subparse_object(_this_, const char* restrict c
  */
 static int libqwaitclient_json_subparse_integer(_this_, const char* restrict code, size_t length)
 {
-  #define STR_INT64_END  "9223372036854775808"  /* 2⁶³ = INT64_MAX + 1 */
-  
-  int r, pos, neg;
-  char buf[20];
-  char* end = NULL;
+  uint64_t value;
+  int pos, neg;
   int twoscomp = (-INT64_MAX) != INT64_MIN;
   /* C allows three diffent signaled integer representations:
      
@@ -636,34 +649,26 @@ static int libqwaitclient_json_subparse_integer(_this_, const char* restrict cod
   if (length > 19)
     goto large_integer;
   
-  /* Copy the code into a NUL-terminated buffer so we
-     can compare against the `int64_t` and parse its
-     value with `strtoll`. */
-  memcpy(buf, code, length * sizeof(char));
-  buf[length] = '\0';
+  /* Parse the integer. 19 digits always fit in `uint64_t`. */
+  if (libqwaitclient_json_parse_digits(code, length, &value) < 0)
+    return D("integer was malformated",), errno = EINVAL, -1;
   
   /* Is the integer larger than `int64_t`? We are restricted to `INT64_MAX`. */
   if (!twoscomp || pos)
-    if (strcmp(buf, STR_INT64_END) >= 0)
+    if (value > (uint64_t)INT64_MAX)
       goto large_integer;
   
   /* Is the integer larger than `int64_t`? We are restricted to `INT64_MAX + 1`. */
   if (twoscomp && neg)
     {
-      r = strcmp(buf, STR_INT64_END);
-      if (r == 0)
+      if (value == (uint64_t)INT64_MAX + 1)
 	return this->data.integer = INT64_MIN, 0; /* Edge case. */
-      else if (r > 0)
+      else if (value > (uint64_t)INT64_MAX)
 	goto large_integer;
     }
   
-  /* Parse the integer. */
-  this->data.integer = (int64_t)strtoll(buf, &end, 10);
-  if (end == NULL)
-    return -1;
-  if (*end != '\0')
-    return D("integer was malformated",), errno = EINVAL, -1;
   /* Apply sign. */
+  this->data.integer = (int64_t)value;
   if (neg)
     this->data.integer = -(this->data.integer);
   
@@ -683,6 +688,104 @@ static int libqwaitclient_json_subparse_integer(_this_, const char* restrict cod
 }
 
 
+/**
+ * Parse a floating-point number, if it can be done exactly
+ * with a single floating-point operation
+ * 
+ * This is the case when the significand, with the decimal point
+ * removed, is at most 2⁵³, and the power of ten it is multiplied
+ * or divided by is at most 10²², because then both are exactly
+ * representable, and IEEE 754 rounds the result correctly
+ * 
+ * @param   code    The encoding of the number
+ * @param   length  The length of `code`
+ * @param   value   Output parameter for the number
+ * @return          Zero on success, -1 if the number must be parsed the slow way
+ */
+static int libqwaitclient_json_parse_floating_fast(const char* restrict code, size_t length, double* restrict value)
+{
+#if defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0) && (FLT_RADIX == 2) && (DBL_MANT_DIG == 53)
+  const uint64_t* restrict powers = libqwaitclient_json_powers_of_ten;
+  uint64_t significand = 0;
+  long exponent = 0, e = 0;
+  size_t p = 0, digits = 0, start;
+  int neg = 0, eneg = 0, point = 0;
+  double power;
+  
+  if ((p < length) && ((code[p] == '-') || (code[p] == '+')))
+    neg = code[p++] == '-';
+  
+  /* Read the significand, and move the decimal point to the end. Leading
+     zeroes do not count against the number of digits that fit. */
+  start = p;
+  for (; (p < length) && ('0' <= code[p]) && (code[p] <= '9'); p++)
+    if ((significand != 0) || (code[p] != '0'))
+      {
+	if (++digits > 19)
+	  return -1;
+	significand = significand * 10 + (uint64_t)(code[p] - '0');
+      }
+  if ((p < length) && (code[p] == '.'))
+    for (p++, point = 1; (p < length) && ('0' <= code[p]) && (code[p] <= '9'); p++, exponent--)
+      if ((significand != 0) || (code[p] != '0'))
+	{
+	  if (++digits > 19)
+	    return -1;
+	  significand = significand * 10 + (uint64_t)(code[p] - '0');
+	}
+  
+  /* There must be at least one digit, not just a decimal point. */
+  if (p - start == (size_t)point)
+    return -1;
+  
+  /* Read the exponent, a huge one is left to the slow way. */
+  if ((p < length) && ((code[p] == 'e') || (code[p] == 'E')))
+    {
+      if ((++p < length) && ((code[p] == '-') || (code[p] == '+')))
+	eneg = code[p++] == '-';
+      if ((p == length) || (code[p] < '0') || ('9' < code[p]))
+	return -1;
+      for (; (p < length) && ('0' <= code[p]) && (code[p] <= '9'); p++)
+	if ((e = e * 10 + (code[p] - '0')) > 1000)
+	  return -1;
+      exponent += eneg ? -e : e;
+    }
+  
+  /* Anything else is left to the slow way. */
+  if (p != length)
+    return -1;
+  
+  if (significand > (UINT64_C(1) << 53))
+    return -1;
+  
+  /* Exponents a bit above 22 are fine if the extra zeroes
+     can be moved into the significand without making it too
+     large. */
+  if ((22 < exponent) && (exponent <= 22 + 19) && (significand != 0))
+    {
+      if (significand > (UINT64_C(1) << 53) / powers[exponent - 22])
+	return -1;
+      significand *= powers[exponent - 22];
+      exponent = 22;
+    }
+  
+  if ((exponent < -22) || (22 < exponent))
+    return significand == 0 ? (*value = neg ? -(double)0 : (double)0, 0) : -1;
+  
+  /* All powers of ten up to 10²² are exactly representable. */
+  e = exponent < 0 ? -exponent : exponent;
+  power = e <= 19 ? (double)(powers[e]) : (double)(powers[19]) * (double)(powers[e - 19]);
+  *value = exponent < 0 ? (double)significand / power : (double)significand * power;
+  if (neg)
+    *value = -*value;
+  return 0;
+#else
+  (void) code, (void) length, (void) value;
+  return -1;
+#endif
+}
+
+
 /**
  * Parse a part of a JSON structure that is a floating-point number
  * 
@@ -697,6 +800,10 @@ static int libqwaitclient_json_subparse_floating(_this_, const char* restrict co
   char* end = NULL;
   int saved_errno;
   
+  /* Almost all numbers we get can be parsed exactly without `strtod`. */
+  if (libqwaitclient_json_parse_floating_fast(code, length, &(this->data.floating)) == 0)
+    return 0;
+  
   /* We need NUL-termination for the next step. */
   if (xmalloc(buf, length + 1, char))
     return -1;
@@ -755,58 +862,300 @@ static size_t libqwaitclient_json_subparse_number(_this_, const char* restrict c
 
 
 /**
- * Parse a part of a JSON structure
+ * Skip whitespaces in a JSON code
  * 
- * @param   this    The JSON structure to fill in
- * @param   code    The serialised JSON structure from where we should begin
- * @param   length  The length of `code` (what is remaining of the original code)
- * @return          The number of read char:s, zero on error
+ * @scope  parsed:size_t           The number of read characters, will be updated
+ * @scope  length:const size_t     The length of the code
+ * @scope  code:const char* const  The code
+ */
+#define SKIP_JSON_WHITESPACE								\
+  while ((parsed < length) && code[parsed] && strchr(JSON_WHITESPACE, code[parsed]))	\
+    parsed++
+
+
+/**
+ * Make room for another element in an array or another member in an object
+ * 
+ * @param   this  The JSON array or object
+ * @return        Zero on success, -1 on error
  */
-static size_t libqwaitclient_json_subparse(_this_, const char* restrict code, size_t length)
+static int libqwaitclient_json_grow_container(_this_)
 {
-  /* The data types are not equality large, so we
-   * initalise everything to avoid runtime warnings. */
-  memset(this, 0, sizeof(libqwaitclient_json_t));
-  /* Pleasant side effect: this->length = 0 and arrays are `NULL` */
+  libqwaitclient_json_association_t* new_object;
+  libqwaitclient_json_t* new_array;
+  size_t n = this->length;
+  
+  /* Room is made for 16 values at first, and is doubled when
+     it is filled, so the allocation is full exactly when the
+     length is a power of two that is at least 16. */
+  if (n == 0)
+    {
+      if (this->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+	return xmalloc(this->data.array, 16, libqwaitclient_json_t) ? -1 : 0;
+      else
+	return xmalloc(this->data.object, 16, libqwaitclient_json_association_t) ? -1 : 0;
+    }
+  if ((n < 16) || (n & (n - 1)))
+    return 0;
   
-  /* That would be invalid, and our code below assumes `length` >= 1. */
-  if (length == 0)
-    return D("have nothing to parse",), errno = EINVAL, 0U;
+  if (this->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+    {
+      new_array = this->data.array;
+      if (xrealloc(new_array, n << 1, libqwaitclient_json_t))
+	return -1;
+      this->data.array = new_array;
+    }
+  else
+    {
+      new_object = this->data.object;
+      if (xrealloc(new_object, n << 1, libqwaitclient_json_association_t))
+	return -1;
+      this->data.object = new_object;
+    }
+  return 0;
+}
+
+
+/**
+ * Shrink the allocation of a non-empty array or
+ * object to fit its elements or members exactly
+ * 
+ * @param   this  The JSON array or object
+ * @return        Zero on success, -1 on error
+ */
+static int libqwaitclient_json_shrink_container(_this_)
+{
+  libqwaitclient_json_association_t* new_object;
+  libqwaitclient_json_t* new_array;
+  size_t n = this->length;
   
-  /* String, array and object are easy to identify, delegate it, they are complex. */
-  if (*code == '"')
+  /* Already a perfect fit? */
+  if ((n >= 16) && !(n & (n - 1)))
+    return 0;
+  
+  if (this->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
     {
-      this->type = LIBQWAITCLIENT_JSON_TYPE_STRING;
-      return libqwaitclient_json_subparse_string(this, code, length);
+      new_array = this->data.array;
+      if (xrealloc(new_array, n, libqwaitclient_json_t))
+	return -1;
+      this->data.array = new_array;
     }
-  else if (*code == '[')
+  else
     {
-      this->type = LIBQWAITCLIENT_JSON_TYPE_ARRAY;
-      return libqwaitclient_json_subparse_array(this, code, length);
+      new_object = this->data.object;
+      if (xrealloc(new_object, n, libqwaitclient_json_association_t))
+	return -1;
+      this->data.object = new_object;
     }
-  else if (*code == '{')
+  return 0;
+}
+
+
+/**
+ * Parse a part of a JSON structure
+ * 
+ * Arrays and objects are parsed without recursion, instead
+ * the arrays and objects we are inside are kept on a stack
+ * 
+ * @param   this       The JSON structure to fill in
+ * @param   code       The serialised JSON structure from where we should begin
+ * @param   length     The length of `code` (what is remaining of the original code)
+ * @param   max_depth  The maximum number of arrays and objects that may be nested
+ * @return             The number of read char:s, zero on error
+ */
+static size_t libqwaitclient_json_subparse(_this_, const char* restrict code, size_t length, size_t max_depth)
+{
+  libqwaitclient_json_t* stack_static[JSON_STACK_SIZE];
+  libqwaitclient_json_t** stack = stack_static;
+  libqwaitclient_json_t** new_stack;
+  libqwaitclient_json_t* restrict value = this;
+  libqwaitclient_json_t* restrict top;
+  libqwaitclient_json_association_t* restrict member;
+  size_t parsed = 0, subparsed, depth = 0, stack_size = JSON_STACK_SIZE;
+  int saved_errno;
+  char c;
+  
+  for (;;)
     {
-      this->type = LIBQWAITCLIENT_JSON_TYPE_OBJECT;
-      return libqwaitclient_json_subparse_object(this, code, length);
+      /* The data types are not equality large, so we
+       * initalise everything to avoid runtime warnings. */
+      memset(value, 0, sizeof(libqwaitclient_json_t));
+      /* Pleasant side effect: value->length = 0 and arrays are `NULL` */
+      
+      /* That would be invalid, and our code below assumes there is something left. */
+      if (parsed == length)
+	{
+	  D("have nothing to parse",);
+	  goto einval;
+	}
+      
+      c = code[parsed];
+      if ((c == '[') || (c == '{'))
+	{
+	  /* Enter the array or object. */
+	  if (depth == max_depth)
+	    {
+	      D("arrays and objects are too deeply nested",);
+	      goto einval;
+	    }
+	  if (depth == stack_size)
+	    {
+	      if (stack == stack_static)
+		{
+		  t (xmalloc(new_stack, stack_size << 1, libqwaitclient_json_t*));
+		  memcpy(new_stack, stack, stack_size * sizeof(libqwaitclient_json_t*));
+		}
+	      else
+		{
+		  new_stack = stack;
+		  t (xrealloc(new_stack, stack_size << 1, libqwaitclient_json_t*));
+		}
+	      stack = new_stack, stack_size <<= 1;
+	    }
+	  value->type = c == '[' ? LIBQWAITCLIENT_JSON_TYPE_ARRAY : LIBQWAITCLIENT_JSON_TYPE_OBJECT;
+	  stack[depth++] = value;
+	  parsed++;
+	  
+	  SKIP_JSON_WHITESPACE;
+	  
+	  /* It is an error if the code ends without a ']' or '}'. */
+	  if (parsed == length)
+	    {
+	      D("opened array or object without elements or closer",);
+	      goto einval;
+	    }
+	  
+	  /* Check for empty array or object. (Edge case) */
+	  if (code[parsed] == (c == '[' ? ']' : '}'))
+	    {
+	      parsed++, depth--;
+	      goto value_done;
+	    }
+	  goto next_element;
+	}
+      
+      /* String are complex, delegate it. */
+      if (c == '"')
+	{
+	  value->type = LIBQWAITCLIENT_JSON_TYPE_STRING;
+	  subparsed = libqwaitclient_json_subparse_string(value, code + parsed, length - parsed);
+	}
+      
+      /* Null, true, and false are keyword that are easily distinguishable
+       * and there no other alternatives. We parse the them exactly, we
+       * will fail below of there was something more behind them. */
+      else if ((length - parsed >= 4) && !memcmp(code + parsed, "null", 4 * sizeof(char)))
+	value->type = LIBQWAITCLIENT_JSON_TYPE_NULL, subparsed = 4;
+      else if ((length - parsed >= 4) && !memcmp(code + parsed, "true", 4 * sizeof(char)))
+	value->type = LIBQWAITCLIENT_JSON_TYPE_BOOLEAN, value->data.boolean = 1, subparsed = 4;
+      else if ((length - parsed >= 5) && !memcmp(code + parsed, "false", 5 * sizeof(char)))
+	value->type = LIBQWAITCLIENT_JSON_TYPE_BOOLEAN, value->data.boolean = 0, subparsed = 5;
+      
+      /* Numbers are a bit more complex, delegate it. */
+      else
+	subparsed = libqwaitclient_json_subparse_number(value, code + parsed, length - parsed);
+      
+      t (subparsed == 0);
+      parsed += subparsed;
+    
+    value_done:
+      /* Leave the arrays and objects whose last value we have parsed. */
+      for (;;)
+	{
+	  if (depth == 0)
+	    goto done;
+	  top = stack[depth - 1];
+	  
+	  SKIP_JSON_WHITESPACE;
+	  
+	  /* It is an error if the code ends without a ']' or '}'. */
+	  if (parsed == length)
+	    {
+	      D("premature end of array or object",);
+	      goto einval;
+	    }
+	  
+	  c = code[parsed++];
+	  if (c == ',')
+	    break;
+	  if (c != (top->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY ? ']' : '}'))
+	    {
+	      D("array or object ended but not with the correct symbol",);
+	      goto einval;
+	    }
+	  
+	  /* Shrink the allocation to fit the elements or members exactly. */
+	  t (libqwaitclient_json_shrink_container(top));
+	  depth--;
+	}
+    
+    next_element:
+      top = stack[depth - 1];
+      
+      /* Make sure another element or member can be added. */
+      t (libqwaitclient_json_grow_container(top));
+      
+      SKIP_JSON_WHITESPACE;
+      
+      /* The next element of an array is parsed in the next round. */
+      if (top->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+	{
+	  value = top->data.array + top->length++;
+	  continue;
+	}
+      
+      /* Parse next member's name. It is counted immediately,
+	 so that it is released if there is an error. */
+      member = top->data.object + top->length++;
+      memset(member, 0, sizeof(libqwaitclient_json_association_t));
+      if ((parsed == length) || (code[parsed] != '"'))
+	{
+	  D("object key was not a string",);
+	  goto einval;
+	}
+      member->value.type = LIBQWAITCLIENT_JSON_TYPE_STRING;
+      subparsed = libqwaitclient_json_subparse_string(&(member->value), code + parsed, length - parsed);
+      t (subparsed == 0);
+      parsed += subparsed;
+      member->name = member->value.data.string;
+      member->name_length = member->value.length;
+      memset(&(member->value), 0, sizeof(libqwaitclient_json_t));
+      
+      SKIP_JSON_WHITESPACE;
+      
+      /* ':' delimits a member's name and its value. */
+      if ((parsed == length) || (code[parsed++] != ':'))
+	{
+	  D("invalid delimiter between object key and value",);
+	  goto einval;
+	}
+      
+      SKIP_JSON_WHITESPACE;
+      
+      /* Parse next member's value in the next round. */
+      value = &(member->value);
       /* We will assume that key duplication does not occur,
 	 instead of testing for it. */
     }
   
-  /* Null, true, and false are keyword that are easily distinguishable
-   * and there no other alternatives. We parse the them exactly, a caller
-   * will fail of there was something more behind them. */
-  if ((length >= 4) && !memcmp(code, "null", 4 * sizeof(char)))
-    return this->type = LIBQWAITCLIENT_JSON_TYPE_NULL, 4U;
-  else if ((length >= 4) && !memcmp(code, "true", 4 * sizeof(char)))
-    return this->type = LIBQWAITCLIENT_JSON_TYPE_BOOLEAN, this->data.boolean = 1, 4U;
-  else if ((length >= 5) && !memcmp(code, "false", 5 * sizeof(char)))
-    return this->type = LIBQWAITCLIENT_JSON_TYPE_BOOLEAN, this->data.boolean = 0, 5U;
-  
-  /* Numbers are a bit more complex, delegate it. */
-  return libqwaitclient_json_subparse_number(this, code, length);
+ done:
+  if (stack != stack_static)
+    free(stack);
+  return parsed;
+  
+ einval:
+  errno = EINVAL;
+ fail:
+  saved_errno = errno;
+  if (stack != stack_static)
+    free(stack);
+  return errno = saved_errno, 0U;
 }
 
 
+#undef SKIP_JSON_WHITESPACE
+
+
 /**
  * Parse a JSON structure
  * 
@@ -816,6 +1165,23 @@ static size_t libqwaitclient_json_subparse(_this_, const char* restrict code, si
  * @return          Zero on success, -1 on error
  */
 int libqwaitclient_json_parse(_this_, const char* restrict code, size_t length)
+{
+  return libqwaitclient_json_parse_bounded(this, code, length, LIBQWAITCLIENT_JSON_MAX_DEPTH);
+}
+
+
+/**
+ * Parse a JSON structure, with a limit on how deeply
+ * arrays and objects may be nested
+ * 
+ * @param   this       The JSON structure to fill in
+ * @param   code       The serialised JSON structure
+ * @param   length     The length of `code`
+ * @param   max_depth  The maximum number of arrays and objects that may be
+ *                     nested, a structure that exceeds it is rejected
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_json_parse_bounded(_this_, const char* restrict code, size_t length, size_t max_depth)
 {
   size_t parsed;
   int saved_errno;
@@ -827,7 +1193,7 @@ int libqwaitclient_json_parse(_this_, const char* restrict code, size_t length)
     length--;
   
   /* Parse the code. */
-  parsed = libqwaitclient_json_subparse(this, code, length);
+  parsed = libqwaitclient_json_subparse(this, code, length, max_depth);
   if (parsed == 0)
     {
       saved_errno = errno;
@@ -843,6 +1209,97 @@ int libqwaitclient_json_parse(_this_, const char* restrict code, size_t length)
 }
 
 
+/**
+ * Skip over a value in a JSON structure without decoding it
+ * 
+ * Nothing is allocated, strings are jumped over without
+ * decoding or validating their escapes, arrays and objects
+ * are skipped by balancing brackets, but whether the
+ * brackets are of matching kinds is not checked
+ * 
+ * @param   code    The serialised JSON structure, beginning with the value
+ * @param   length  The length of `code`
+ * @param   count   Output parameter for the number of elements or members
+ *                  if the value is an array or object, zero otherwise,
+ *                  may be `NULL`
+ * @return          The length of the value's encoding, zero on error
+ */
+size_t libqwaitclient_json_skip(const char* restrict code, size_t length, size_t* restrict count)
+{
+  const char* quote;
+  size_t p, i, escapes, depth = 0, commas = 0;
+  int empty = 1;
+  char c;
+  
+  if (count != NULL)
+    *count = 0;
+  
+  if (length == 0)
+    return D("have nothing to skip",), errno = EINVAL, 0U;
+  
+  /* Strings end at the first quote that is not escaped
+     by an odd number of backslashes. */
+  if (*code == '"')
+    for (p = 1;;)
+      {
+	if ((quote = memchr(code + p, '"', (length - p) * sizeof(char))) == NULL)
+	  return D("premature end of string",), errno = EINVAL, 0U;
+	i = (size_t)(quote - code);
+	for (escapes = 0; (i - escapes > 1) && (code[i - escapes - 1] == '\\'); escapes++);
+	if ((escapes & 1) == 0)
+	  return i + 1;
+	p = i + 1;
+      }
+  
+  /* Numbers, booleans and null end at the first delimiter. */
+  if ((*code != '[') && (*code != '{'))
+    {
+      for (p = 0; p < length; p++)
+	if (strchr(",:]}" JSON_WHITESPACE, code[p]))
+	  break;
+      return p ? p : (D("expected a value",), errno = EINVAL, 0U);
+    }
+  
+  /* Arrays and objects end where their brackets balance. The number
+     of elements is one more than the number of commas at the top
+     level, unless there are no elements at all. */
+  for (p = 0; p < length; p++)
+    {
+      c = code[p];
+      if (c == '"')
+	{
+	  if ((i = libqwaitclient_json_skip(code + p, length - p, NULL)) == 0)
+	    return 0;
+	  p += i - 1;
+	  empty &= depth != 1;
+	}
+      else if ((c == '[') || (c == '{'))
+	{
+	  empty &= depth != 1;
+	  depth++;
+	}
+      else if ((c == ']') || (c == '}'))
+	{
+	  if (--depth == 0)
+	    {
+	      if (count != NULL)
+		*count = empty ? 0 : commas + 1;
+	      return p + 1;
+	    }
+	}
+      else if (depth == 1)
+	{
+	  if (c == ',')
+	    commas++;
+	  else if (!strchr(JSON_WHITESPACE, c))
+	    empty = 0;
+	}
+    }
+  
+  return D("premature end of array or object",), errno = EINVAL, 0U;
+}
+
+
 /**
  * Print a string as part of a JSON structure in debug format, exclude surrounding quotes
  * 
@@ -900,96 +1357,124 @@ static void libqwaitclient_json_subdump_string(FILE* f, const char* string, size
 /**
  * Print a part of a JSON structure in debug format
  * 
- * @param  this    The JSON structure
- * @param  f       The output sink
- * @parma  indent  The size of the indent
+ * @param  this  The JSON structure
+ * @param  f     The output sink
  */
-static void libqwaitclient_json_subdump(const _this_, FILE* f, int indent)
+static void libqwaitclient_json_subdump(const _this_, FILE* f)
 {
 #define PRIindent  "*.s"
-  size_t i, n = this->length;
-  
-  switch (this->type)
+  const libqwaitclient_json_t** nodes = NULL;
+  const libqwaitclient_json_t** new_nodes;
+  const libqwaitclient_json_t* restrict node = this;
+  size_t* indices = NULL;
+  size_t* new_indices;
+  size_t i, n, depth = 0, stack_size = 0;
+  int indent = 0;
+  
+  /* Arrays and objects are printed without recursion, instead the arrays
+     and objects we are inside, and how far we have come in them, are
+     kept on a stack. */
+  for (;;)
     {
-    case LIBQWAITCLIENT_JSON_TYPE_INTEGER:
-      fprintf(f, "%" PRIi64, this->data.integer);
-      break;
-      
-    case LIBQWAITCLIENT_JSON_TYPE_LARGE_INTEGER:
-      fprintf(f, "%s(L)", this->data.large_integer);
-      break;
-      
-    case LIBQWAITCLIENT_JSON_TYPE_FLOATING:
-      fprintf(f, "%lf(F)", this->data.floating);
-      break;
-      
-    case LIBQWAITCLIENT_JSON_TYPE_STRING:
-      fprintf(f, "\"");
-      libqwaitclient_json_subdump_string(f, this->data.string, n);
-      fprintf(f, "\"(%zu)", this->length);
-      break;
-      
-    case LIBQWAITCLIENT_JSON_TYPE_BOOLEAN:
-      fprintf(f, this->data.boolean ? "true" : "false");
-      break;
-      
-    case LIBQWAITCLIENT_JSON_TYPE_ARRAY:
-      if (n == 0)
+      n = node->length;
+      switch (node->type)
 	{
-	  fprintf(f, "[]");
+	case LIBQWAITCLIENT_JSON_TYPE_INTEGER:
+	  fprintf(f, "%" PRIi64, node->data.integer);
 	  break;
-	}
-      if (n == 1)
-	{
-	  fprintf(f, "[");
-	  libqwaitclient_json_subdump(this->data.array, f, indent);
-	  fprintf(f, "]");
+	
+	case LIBQWAITCLIENT_JSON_TYPE_LARGE_INTEGER:
+	  fprintf(f, "%s(L)", node->data.large_integer);
 	  break;
-	}
-      fprintf(f, "[\n%" PRIindent, indent + 2, "");
-      for (i = 0; i < n; i++)
-	{
-	  fprintf(f, "%s%" PRIindent "", i ? ",\n" : "", i ? indent + 2 : 0, "");
-	  libqwaitclient_json_subdump(this->data.array + i, f, indent + 2);
-	}
-      fprintf(f, "\n%" PRIindent "]", indent, "");
-      break;
-      
-    case LIBQWAITCLIENT_JSON_TYPE_OBJECT:
-      if (n == 0)
-	{
-	  fprintf(f, "{ }");
+	
+	case LIBQWAITCLIENT_JSON_TYPE_FLOATING:
+	  fprintf(f, "%lf(F)", node->data.floating);
 	  break;
-	}
-      if (n == 1)
-	{
-	  fprintf(f, "{ \"");
-	  libqwaitclient_json_subdump_string(f, this->data.object->name, this->data.object->name_length);
-	  fprintf(f, "\"(%zu) = ", this->data.object->name_length);
-	  libqwaitclient_json_subdump(&(this->data.object->value), f, indent);
-	  fprintf(f, " }");
+	
+	case LIBQWAITCLIENT_JSON_TYPE_STRING:
+	  fprintf(f, "\"");
+	  libqwaitclient_json_subdump_string(f, node->data.string, n);
+	  fprintf(f, "\"(%zu)", node->length);
+	  break;
+	
+	case LIBQWAITCLIENT_JSON_TYPE_BOOLEAN:
+	  fprintf(f, node->data.boolean ? "true" : "false");
+	  break;
+	
+	case LIBQWAITCLIENT_JSON_TYPE_ARRAY:
+	case LIBQWAITCLIENT_JSON_TYPE_OBJECT:
+	  if (n == 0)
+	    {
+	      fprintf(f, node->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY ? "[]" : "{ }");
+	      break;
+	    }
+	  if (depth == stack_size)
+	    {
+	      new_nodes = nodes, new_indices = indices;
+	      stack_size = stack_size ? (stack_size << 1) : JSON_STACK_SIZE;
+	      if (xrealloc(new_nodes, stack_size, const libqwaitclient_json_t*))
+		perror("libqwaitclient_json_subdump"), abort();
+	      nodes = new_nodes;
+	      if (xrealloc(new_indices, stack_size, size_t))
+		perror("libqwaitclient_json_subdump"), abort();
+	      indices = new_indices;
+	    }
+	  nodes[depth] = node, indices[depth++] = 0;
+	  /* Single-valued arrays and objects are printed on one line. */
+	  if (node->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+	    fprintf(f, n == 1 ? "[" : "[\n");
+	  else
+	    fprintf(f, n == 1 ? "{ " : "{\n");
+	  if (n > 1)
+	    indent += 2;
+	  break;
+	
+	case LIBQWAITCLIENT_JSON_TYPE_NULL:
+	  fprintf(f, "null");
+	  break;
+	
+	default:
+	  abort();
 	  break;
 	}
-      fprintf(f, "{\n%" PRIindent, indent + 2, "");
-      for (i = 0; i < n; i++)
+      
+      /* Find the next value to print, and print
+	 the ends of arrays and objects we leave. */
+      for (;;)
 	{
-	  fprintf(f, "%s%" PRIindent "\"", i ? ",\n" : "", i ? indent + 2 : 0, "");
-	  libqwaitclient_json_subdump_string(f, this->data.object[i].name, this->data.object[i].name_length);
-	  fprintf(f, "\"(%zu) = ", this->data.object[i].name_length);
-	  libqwaitclient_json_subdump(&(this->data.object[i].value), f, indent + 2);
+	  if (depth == 0)
+	    goto done;
+	  node = nodes[depth - 1];
+	  i = indices[depth - 1]++;
+	  n = node->length;
+	  
+	  if (i < n)
+	    break;
+	  
+	  if (n > 1)
+	    fprintf(f, "\n%" PRIindent "%s", indent -= 2, "",
+		    node->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY ? "]" : "}");
+	  else
+	    fprintf(f, node->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY ? "]" : " }");
+	  depth--;
 	}
-      fprintf(f, "\n%" PRIindent "}", indent, "");
-      break;
-      
-    case LIBQWAITCLIENT_JSON_TYPE_NULL:
-      fprintf(f, "null");
-      break;
       
-    default:
-      abort();
-      break;
+      if (n > 1)
+	fprintf(f, "%s%" PRIindent, i ? ",\n" : "", indent, "");
+      if (node->type == LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+	node = node->data.array + i;
+      else
+	{
+	  fprintf(f, "\"");
+	  libqwaitclient_json_subdump_string(f, node->data.object[i].name, node->data.object[i].name_length);
+	  fprintf(f, "\"(%zu) = ", node->data.object[i].name_length);
+	  node = &(node->data.object[i].value);
+	}
     }
   
+ done:
+  free(nodes);
+  free(indices);
 #undef PRIindent
 }
 
@@ -1004,7 +1489,7 @@ static void libqwaitclient_json_subdump(const _this_, FILE* f, int indent)
  */
 void libqwaitclient_json_dump(const _this_, FILE* output)
 {
-  libqwaitclient_json_subdump(this, output, 0);
+  libqwaitclient_json_subdump(this, output);
   fprintf(output, "\n");
 }
 
@@ -66,6 +66,13 @@
 #define LIBQWAITCLIENT_JSON_TYPE_NULL  7
 
 
+/**
+ * The maximum number of arrays and objects that may be
+ * nested in a structure parsed by `libqwaitclient_json_parse`
+ */
+#define LIBQWAITCLIENT_JSON_MAX_DEPTH  64
+
+
 
 /**
  * JavaScript Object Notation
@@ -128,7 +135,9 @@ typedef struct libqwaitclient_json
      * 
      * UTF-8 encoding length attacks are mitigated
      * 
-     * The number of bytes are determined by `length`
+     * The number of bytes are determined by `length`, strings
+     * parsed by `libqwaitclient_json_parse` are followed by a
+     * NUL byte that is not included in `length`
      */
     char* string;
     
@@ -223,6 +232,32 @@ char* libqwaitclient_json_to_zstr(const _this_);
  */
 char** libqwaitclient_json_to_zstrs(const _this_);
 
+/**
+ * Take the string out of a JSON string as a NUL-terminated string,
+ * without copying it, the JSON string is left empty
+ * 
+ * The string must have been parsed by `libqwaitclient_json_parse`,
+ * which leaves room for the NUL-termination
+ * 
+ * @param   this  The JSON string
+ * @return        The string in NUL-terminated format, `NULL` on error
+ */
+char* libqwaitclient_json_steal_zstr(_this_);
+
+/**
+ * Take the strings out of a JSON string array as an array of
+ * NUL-terminated strings, without copying them, the JSON
+ * strings are left empty
+ * 
+ * The strings must have been parsed by `libqwaitclient_json_parse`,
+ * which leaves room for the NUL-termination. Nothing is taken if
+ * any element is not a string.
+ * 
+ * @param   this  The JSON string array
+ * @return        The array of NUL-termianted strings, `NULL` on error
+ */
+char** libqwaitclient_json_steal_zstrs(_this_);
+
 /**
  * Parse a JSON structure
  * 
@@ -233,6 +268,36 @@ char** libqwaitclient_json_to_zstrs(const _this_);
  */
 int libqwaitclient_json_parse(_this_, const char* restrict code, size_t length);
 
+/**
+ * Parse a JSON structure, with a limit on how deeply
+ * arrays and objects may be nested
+ * 
+ * @param   this       The JSON structure to fill in
+ * @param   code       The serialised JSON structure
+ * @param   length     The length of `code`
+ * @param   max_depth  The maximum number of arrays and objects that may be
+ *                     nested, a structure that exceeds it is rejected
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_json_parse_bounded(_this_, const char* restrict code, size_t length, size_t max_depth);
+
+/**
+ * Skip over a value in a JSON structure without decoding it
+ * 
+ * Nothing is allocated, strings are jumped over without
+ * decoding or validating their escapes, arrays and objects
+ * are skipped by balancing brackets, but whether the
+ * brackets are of matching kinds is not checked
+ * 
+ * @param   code    The serialised JSON structure, beginning with the value
+ * @param   length  The length of `code`
+ * @param   count   Output parameter for the number of elements or members
+ *                  if the value is an array or object, zero otherwise,
+ *                  may be `NULL`
+ * @return          The length of the value's encoding, zero on error
+ */
+size_t libqwaitclient_json_skip(const char* restrict code, size_t length, size_t* restrict count);
+
 /**
  * Print a JSON structure in debug format, this
  * is not a serialisation for sending data to
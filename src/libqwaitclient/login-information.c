@@ -307,7 +307,7 @@ static int array0(libqwaitclient_json_association_t* restrict member, const char
  */
 static int libqwaitclient_login_information_parse_json(_this_, _json_)
 {
-  const libqwaitclient_json_t* restrict data_hostname     = NULL;
+  libqwaitclient_json_t*       restrict data_hostname     = NULL;
   libqwaitclient_json_t*       restrict data_current_user = NULL;
   libqwaitclient_json_t*       restrict data_product      = NULL;
   libqwaitclient_json_association_t* old;
@@ -342,7 +342,7 @@ static int libqwaitclient_login_information_parse_json(_this_, _json_)
   
 #define str(var, have)  	 (((have)->type == LIBQWAITCLIENT_JSON_TYPE_NULL) ?	\
 				  (var = NULL, 0) :					\
-				  (var = libqwaitclient_json_to_zstr(have), var == NULL))
+				  (var = libqwaitclient_json_steal_zstr(have), var == NULL))
 #define test_name(member, key)	 (((member).name_length == strlen(key)) && 		\
 				  !memcmp((member).name, key, (member).name_length * sizeof(char)))
   
@@ -455,10 +455,12 @@ int libqwaitclient_login_information_parse(_this_, char* restrict message, size_
  */
 void libqwaitclient_login_information_dump(const _this_, FILE* output)
 {
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  const char* str_id = libqwaitclient_qwait_user_get_user_id(&(this->current_user), user_id);
   size_t i, n;
   
   fprintf(output, "current user:\n");
-  fprintf(output, "  %s (%s)\n", this->current_user.real_name, this->current_user.user_id);
+  fprintf(output, "  %s (%s)\n", this->current_user.real_name, str_id ? str_id : "(none)");
   fprintf(output, "    admin: %s\n",   this->current_user.admin     ? "yes" : "no");
   fprintf(output, "    anonymous: %s\n", this->current_user.anonymous ? "yes" : "no");
   
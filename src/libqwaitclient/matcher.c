@@ -0,0 +1,341 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "matcher.h"
+
+#include "macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_matcher_t* restrict this
+
+
+
+/**
+ * Case fold a byte in a UTF-8 string, ASCII letters and
+ * the letters in the Latin-1 supplement are folded to
+ * lower case, U+00C0 to U+00DE, except U+00D7, are
+ * encoded as 0xC3 followed by 0x80 to 0x9E, and their
+ * lower case letters differ by 0x20 in the second byte
+ * 
+ * @param   c     The byte
+ * @param   prev  The previous byte in the string, zero if none
+ * @return        The byte after case folding
+ */
+static inline unsigned char __attribute__((const)) libqwaitclient_matcher_fold(unsigned char c, unsigned char prev)
+{
+  if (('A' <= c) && (c <= 'Z'))
+    return (unsigned char)(c | 0x20);
+  if ((prev == 0xC3) && (0x80 <= c) && (c <= 0x9E) && (c != 0x97))
+    return (unsigned char)(c + 0x20);
+  return c;
+}
+
+
+/**
+ * Check whether a byte, after case folding, is part
+ * of a letter, any byte of a non-ASCII character is
+ * regarded as part of a letter
+ * 
+ * @param   c  The byte
+ * @return     Whether the byte is part of a letter
+ */
+static inline int __attribute__((const)) libqwaitclient_matcher_is_letter(unsigned char c)
+{
+  return (('a' <= c) && (c <= 'z')) || (c >= 0x80);
+}
+
+
+/**
+ * Initialise a matcher, it matches nothing
+ * until patterns have been compiled into it
+ * 
+ * @param  this  The matcher
+ */
+void libqwaitclient_matcher_initialise(_this_)
+{
+  memset(this, 0, sizeof(libqwaitclient_matcher_t));
+}
+
+
+/**
+ * Release all resources in a matcher, but not the matcher itself
+ * 
+ * @param  this  The matcher
+ */
+void libqwaitclient_matcher_destroy(_this_)
+{
+  free(this->transitions);
+  free(this->least);
+  free(this->mask);
+  memset(this, 0, sizeof(libqwaitclient_matcher_t));
+}
+
+
+/**
+ * Compile a set of patterns into a matcher
+ * 
+ * @param   this      The matcher, must be initialised or destroyed
+ * @param   patterns  The patterns, empty patterns are ignored
+ * @param   count     The number of elements in `patterns`
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_matcher_compile(_this_, const libqwaitclient_matcher_pattern_t* restrict patterns, size_t count)
+{
+  uint16_t* restrict fail = NULL;
+  uint16_t* restrict queue = NULL;
+  const unsigned char* restrict p;
+  unsigned char c, prev;
+  size_t i, j, n = 1, cc, head, tail;
+  size_t state, next;
+  uint16_t* edge;
+  int saved_errno;
+  
+  libqwaitclient_matcher_initialise(this);
+  
+  for (i = 0; i < count; i++)
+    if (patterns[i].flags & LIBQWAITCLIENT_MATCHER_WORD)
+      this->words = 1;
+  
+  /* Assign classes to the bytes in the patterns, and count the states.
+     When matching words, non-letters keep class zero, which is then
+     the word boundary, letters that do not occur in any pattern
+     share a class, and each anchor takes a state of its own. */
+  for (i = 0; i < count; i++)
+    {
+      if (*(patterns[i].pattern) == 0)
+	continue;
+      n += (patterns[i].flags & LIBQWAITCLIENT_MATCHER_WORD_START) ? 1 : 0;
+      n += (patterns[i].flags & LIBQWAITCLIENT_MATCHER_WORD_END)   ? 1 : 0;
+      for (p = (const unsigned char*)(patterns[i].pattern), prev = 0; *p; prev = *p++, n++)
+	if (c = libqwaitclient_matcher_fold(*p, prev), this->words && !libqwaitclient_matcher_is_letter(c))
+	  continue;
+	else if (this->classes[c] == 0)
+	  this->classes[c] = (uint8_t)++(this->class_count);
+    }
+  if (this->words)
+    for (j = 0, cc = ++(this->class_count); j < 256; j++)
+      if (libqwaitclient_matcher_is_letter((unsigned char)j) && (this->classes[j] == 0))
+	this->classes[j] = (uint8_t)cc;
+  if (n > LIBQWAITCLIENT_MATCHER_MAX_STATES)
+    return errno = EOVERFLOW, -1;
+  this->class_count = cc = this->class_count + 1;
+  
+  if (xcalloc(this->transitions, n * cc, uint16_t))  goto fail;
+  if (xcalloc(this->least, n, uint32_t))             goto fail;
+  if (xcalloc(this->mask, n, uint32_t))              goto fail;
+  if (xcalloc(fail, n, uint16_t))                    goto fail;
+  if (xmalloc(queue, n, uint16_t))                   goto fail;
+  
+  /* Build the trie, the initial state is never the target of
+     an edge in the trie, so zero means that there is no edge. */
+  this->state_count = 1;
+  for (i = 0; i < count; i++)
+    {
+      p = (const unsigned char*)(patterns[i].pattern);
+      if (*p == 0)
+	continue;
+      state = 0;
+      if (patterns[i].flags & LIBQWAITCLIENT_MATCHER_WORD_START)
+	{
+	  edge = this->transitions;
+	  if (*edge == 0)
+	    *edge = (uint16_t)(this->state_count++);
+	  state = *edge;
+	}
+      for (prev = 0; *p; prev = *p++, state = *edge)
+	{
+	  c = libqwaitclient_matcher_fold(*p, prev);
+	  edge = this->transitions + state * cc + this->classes[c];
+	  if (*edge == 0)
+	    *edge = (uint16_t)(this->state_count++);
+	}
+      if (patterns[i].flags & LIBQWAITCLIENT_MATCHER_WORD_END)
+	{
+	  edge = this->transitions + state * cc;
+	  if (*edge == 0)
+	    *edge = (uint16_t)(this->state_count++);
+	  state = *edge;
+	}
+      this->least[state] = this->least[state] ? min(this->least[state], patterns[i].value) : patterns[i].value;
+      this->mask[state] |= patterns[i].value;
+    }
+  
+  /* Add the failure edges breadth first, so that a state's failure
+     state is complete before the state itself is. Missing edges are
+     replaced by the edge from the failure state, which turns the trie
+     into a deterministic automaton. */
+  head = tail = 0;
+  for (j = 0; j < cc; j++)
+    if ((next = this->transitions[j]))
+      queue[tail++] = (uint16_t)next;
+  while (head < tail)
+    {
+      state = queue[head++];
+      for (j = 0; j < cc; j++)
+	{
+	  next = this->transitions[state * cc + j];
+	  if (next == 0)
+	    {
+	      this->transitions[state * cc + j] = this->transitions[fail[state] * cc + j];
+	      continue;
+	    }
+	  fail[next] = this->transitions[fail[state] * cc + j];
+	  if (this->least[fail[next]])
+	    this->least[next] = this->least[next] ? min(this->least[next], this->least[fail[next]])
+						  : this->least[fail[next]];
+	  this->mask[next] |= this->mask[fail[next]];
+	  queue[tail++] = (uint16_t)next;
+	}
+    }
+  
+  free(fail);
+  free(queue);
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  free(fail);
+  free(queue);
+  libqwaitclient_matcher_destroy(this);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Get the least value of the patterns that occur in a text
+ * 
+ * @param   this  The matcher
+ * @param   text  The text, may be `NULL`
+ * @return        The least value of the patterns that occur in `text`, zero if none
+ */
+uint32_t libqwaitclient_matcher_least(const _this_, const char* restrict text)
+{
+  const unsigned char* restrict p = (const unsigned char*)text;
+  unsigned char prev = 0;
+  size_t state = 0, cc = this->class_count;
+  uint32_t rc = 0, value;
+  
+  if ((text == NULL) || (this->transitions == NULL))
+    return 0;
+  
+  /* The start of the text is a word boundary. */
+  if (this->words)
+    state = this->transitions[0];
+  
+  for (; *p; prev = *p++)
+    {
+      if (this->squeeze && (*p == prev))
+	continue;
+      state = this->transitions[state * cc + this->classes[libqwaitclient_matcher_fold(*p, prev)]];
+      if ((value = this->least[state]) && ((rc == 0) || (value < rc)))
+	rc = value;
+    }
+  
+  /* So is the end of the text. */
+  if (this->words)
+    {
+      state = this->transitions[state * cc];
+      if ((value = this->least[state]) && ((rc == 0) || (value < rc)))
+	rc = value;
+    }
+  
+  return rc;
+}
+
+
+/**
+ * Get the bitwise OR of the values of the patterns that occur in a text
+ * 
+ * @param   this  The matcher
+ * @param   text  The text, may be `NULL`
+ * @return        The bitwise OR of the values of the patterns that occur in `text`
+ */
+uint32_t libqwaitclient_matcher_mask(const _this_, const char* restrict text)
+{
+  const unsigned char* restrict p = (const unsigned char*)text;
+  unsigned char prev = 0;
+  size_t state = 0, cc = this->class_count;
+  uint32_t rc = 0;
+  
+  if ((text == NULL) || (this->transitions == NULL))
+    return 0;
+  
+  /* The start of the text is a word boundary. */
+  if (this->words)
+    state = this->transitions[0];
+  
+  for (; *p; prev = *p++)
+    {
+      if (this->squeeze && (*p == prev))
+	continue;
+      state = this->transitions[state * cc + this->classes[libqwaitclient_matcher_fold(*p, prev)]];
+      rc |= this->mask[state];
+    }
+  
+  /* So is the end of the text. */
+  if (this->words)
+    rc |= this->mask[this->transitions[state * cc]];
+  
+  return rc;
+}
+
+
+/**
+ * Get the value of the pattern that occurs first in a text,
+ * that is, the pattern whose first occurrence ends first,
+ * the least value if several patterns end there
+ * 
+ * @param   this  The matcher
+ * @param   text  The text, may be `NULL`
+ * @return        The value of the pattern that occurs first in `text`, zero if none
+ */
+uint32_t libqwaitclient_matcher_first(const _this_, const char* restrict text)
+{
+  const unsigned char* restrict p = (const unsigned char*)text;
+  unsigned char prev = 0;
+  size_t state = 0, cc = this->class_count;
+  
+  if ((text == NULL) || (this->transitions == NULL))
+    return 0;
+  
+  /* The start of the text is a word boundary. */
+  if (this->words)
+    state = this->transitions[0];
+  
+  for (; *p; prev = *p++)
+    {
+      if (this->squeeze && (*p == prev))
+	continue;
+      state = this->transitions[state * cc + this->classes[libqwaitclient_matcher_fold(*p, prev)]];
+      if (this->least[state])
+	return this->least[state];
+    }
+  
+  /* So is the end of the text. */
+  if (this->words)
+    return this->least[this->transitions[state * cc]];
+  
+  return 0;
+}
+
+
+#undef _this_
+
@@ -0,0 +1,212 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_MATCHER_H
+#define LIBQWAITCLIENT_MATCHER_H
+
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * The maximum number of states a matcher may have,
+ * a matcher has at most one state more than the
+ * total length of its patterns
+ */
+#define LIBQWAITCLIENT_MATCHER_MAX_STATES  UINT16_MAX
+
+
+/**
+ * Pattern flag: the pattern only matches at the start of a word
+ */
+#define LIBQWAITCLIENT_MATCHER_WORD_START  1
+
+/**
+ * Pattern flag: the pattern only matches at the end of a word
+ */
+#define LIBQWAITCLIENT_MATCHER_WORD_END  2
+
+/**
+ * Pattern flag: the pattern only matches whole words
+ */
+#define LIBQWAITCLIENT_MATCHER_WORD  (LIBQWAITCLIENT_MATCHER_WORD_START | LIBQWAITCLIENT_MATCHER_WORD_END)
+
+
+
+/**
+ * A pattern to compile into a matcher
+ */
+typedef struct libqwaitclient_matcher_pattern
+{
+  /**
+   * The pattern, a NUL-terminated UTF-8 string
+   */
+  const char* pattern;
+  
+  /**
+   * The value the pattern stands for, must not be zero
+   */
+  uint32_t value;
+  
+  /**
+   * Word boundaries the pattern must be anchored at, a combination
+   * of `LIBQWAITCLIENT_MATCHER_WORD_START` and
+   * `LIBQWAITCLIENT_MATCHER_WORD_END`; a word is a run of
+   * letters, ASCII letters and any non-ASCII character, so
+   * digits and punctuation separate words
+   */
+  int flags;
+  
+} libqwaitclient_matcher_pattern_t;
+
+
+/**
+ * A set of patterns compiled into an Aho–Corasick automaton, that
+ * finds every occurrence of any of the patterns in a text in one
+ * pass over the text
+ * 
+ * Matching is case-insensitive for ASCII and for the Latin-1
+ * supplement letters, the text is expected to be UTF-8 encoded
+ * 
+ * If any pattern is anchored at a word boundary, all non-letters,
+ * in the patterns and in the text, are matched as the same byte,
+ * and the text is matched as if it was surrounded by non-letters
+ */
+typedef struct libqwaitclient_matcher
+{
+  /**
+   * The class of each byte, after case folding, bytes
+   * that do not occur in any pattern have class zero,
+   * if `words` is set, non-letters have class zero
+   * and letters that do not occur in any pattern
+   * have a class of their own
+   */
+  uint8_t classes[256];
+  
+  /**
+   * The number of byte classes
+   */
+  size_t class_count;
+  
+  /**
+   * The number of states, the initial state is zero
+   */
+  size_t state_count;
+  
+  /**
+   * The next state for each state and byte class,
+   * state `s` and class `c` is at `s * class_count + c`
+   */
+  uint16_t* transitions;
+  
+  /**
+   * The least value of the patterns that have been
+   * matched when each state is entered, zero if none
+   */
+  uint32_t* least;
+  
+  /**
+   * The bitwise OR of the values of the patterns that
+   * have been matched when each state is entered
+   */
+  uint32_t* mask;
+  
+  /**
+   * Whether runs of a repeated byte in the text are
+   * matched as a single byte, so that for example
+   * "heeelp" matches "help", the patterns must not
+   * contain such runs; zero by default, may be set
+   * after the patterns have been compiled
+   */
+  int squeeze;
+  
+  /**
+   * Whether any pattern is anchored at a word boundary,
+   * set when the patterns are compiled, if so class
+   * zero is the word boundary
+   */
+  int words;
+  
+} libqwaitclient_matcher_t;
+
+
+
+#define _this_  libqwaitclient_matcher_t* restrict this
+
+
+/**
+ * Initialise a matcher, it matches nothing
+ * until patterns have been compiled into it
+ * 
+ * @param  this  The matcher
+ */
+void libqwaitclient_matcher_initialise(_this_);
+
+/**
+ * Release all resources in a matcher, but not the matcher itself
+ * 
+ * @param  this  The matcher
+ */
+void libqwaitclient_matcher_destroy(_this_);
+
+/**
+ * Compile a set of patterns into a matcher
+ * 
+ * @param   this      The matcher, must be initialised or destroyed
+ * @param   patterns  The patterns, empty patterns are ignored
+ * @param   count     The number of elements in `patterns`
+ * @return            Zero on success, -1 on error
+ */
+int libqwaitclient_matcher_compile(_this_, const libqwaitclient_matcher_pattern_t* restrict patterns, size_t count);
+
+/**
+ * Get the least value of the patterns that occur in a text
+ * 
+ * @param   this  The matcher
+ * @param   text  The text, may be `NULL`
+ * @return        The least value of the patterns that occur in `text`, zero if none
+ */
+uint32_t libqwaitclient_matcher_least(const _this_, const char* restrict text) __attribute__((pure));
+
+/**
+ * Get the bitwise OR of the values of the patterns that occur in a text
+ * 
+ * @param   this  The matcher
+ * @param   text  The text, may be `NULL`
+ * @return        The bitwise OR of the values of the patterns that occur in `text`
+ */
+uint32_t libqwaitclient_matcher_mask(const _this_, const char* restrict text) __attribute__((pure));
+
+/**
+ * Get the value of the pattern that occurs first in a text,
+ * that is, the pattern whose first occurrence ends first,
+ * the least value if several patterns end there
+ * 
+ * @param   this  The matcher
+ * @param   text  The text, may be `NULL`
+ * @return        The value of the pattern that occurs first in `text`, zero if none
+ */
+uint32_t libqwaitclient_matcher_first(const _this_, const char* restrict text) __attribute__((pure));
+
+
+#undef _this_
+
+
+#endif
+
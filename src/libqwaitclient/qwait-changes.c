@@ -0,0 +1,408 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qwait-changes.h"
+
+#include "macros.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_qwait_changes_t* restrict this
+#define _pos_   const libqwaitclient_qwait_position_t* restrict
+
+
+/**
+ * Names of the change types, for debugging
+ */
+static const char* change_names[] = { "joined", "left", "moved", "comment", "location", "locked",
+				      "unlocked", "hidden", "unhidden", "queue added", "queue removed" };
+
+
+
+/**
+ * Initialise a change set
+ * 
+ * @param  this  The change set
+ */
+void libqwaitclient_qwait_changes_initialise(_this_)
+{
+  memset(this, 0, sizeof(libqwaitclient_qwait_changes_t));
+}
+
+
+/**
+ * Release all resources in a change set, but not the change set itself
+ * 
+ * @param  this  The change set
+ */
+void libqwaitclient_qwait_changes_destroy(_this_)
+{
+  free(this->changes);
+  memset(this, 0, sizeof(libqwaitclient_qwait_changes_t));
+}
+
+
+/**
+ * Add a change to a change set
+ * 
+ * @param   this          The change set
+ * @param   type          What changed, `LIBQWAITCLIENT_QWAIT_CHANGE_*`
+ * @param   old_queue     The index of the queue in the old snapshot
+ * @param   new_queue     The index of the queue in the new snapshot
+ * @param   old_position  The index of the entry in the old snapshot of the queue
+ * @param   new_position  The index of the entry in the new snapshot of the queue
+ * @param   user_id       The user of the entry
+ * @return                Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_changes_add(_this_, int type, size_t old_queue, size_t new_queue,
+					    size_t old_position, size_t new_position,
+					    libqwaitclient_qwait_user_id_t user_id)
+{
+  libqwaitclient_qwait_change_t* new;
+  libqwaitclient_qwait_change_t* restrict change;
+  
+  if (this->count == this->capacity)
+    {
+      new = this->changes;
+      if (xrealloc(new, this->capacity ? this->capacity << 1 : 16, libqwaitclient_qwait_change_t))
+	return -1;
+      this->changes = new;
+      this->capacity = this->capacity ? this->capacity << 1 : 16;
+    }
+  
+  change = this->changes + this->count++;
+  change->type = type;
+  change->old_queue = old_queue;
+  change->new_queue = new_queue;
+  change->old_position = old_position;
+  change->new_position = new_position;
+  change->user_id = user_id;
+  return 0;
+}
+
+
+/**
+ * Calculate the hash of the user of a queue entry, entries
+ * without a user ID are hashed by their time instead
+ * 
+ * @param   pos  The queue entry
+ * @return       The hash of the entry
+ */
+static size_t __attribute__((pure)) libqwaitclient_qwait_changes_hash_position(_pos_ pos)
+{
+  if (pos->user_id != LIBQWAITCLIENT_QWAIT_USER_ID_NONE)
+    return libqwaitclient_qwait_user_id_hash(pos->user_id);
+  return libqwaitclient_qwait_user_id_hash((libqwaitclient_qwait_user_id_t)(pos->enter_time_seconds) * 1000 +
+					   (libqwaitclient_qwait_user_id_t)(pos->enter_time_mseconds));
+}
+
+
+/**
+ * Check whether two queue entries, from different
+ * snapshots of a queue, are by the same user
+ * 
+ * @param   a  One of the entries
+ * @param   b  The other entry
+ * @return     1 if the entries are by the same user, 0 otherwise
+ */
+static int __attribute__((pure)) libqwaitclient_qwait_changes_same_user(_pos_ a, _pos_ b)
+{
+  if (a->user_id != b->user_id)
+    return 0;
+  if (a->user_id != LIBQWAITCLIENT_QWAIT_USER_ID_NONE)
+    return 1;
+  return (a->enter_time_seconds == b->enter_time_seconds) && (a->enter_time_mseconds == b->enter_time_mseconds);
+}
+
+
+/**
+ * Check whether two strings that may be `NULL` are different
+ * 
+ * @param   a  One of the strings
+ * @param   b  The other string
+ * @return     1 if the strings are different, 0 otherwise
+ */
+static int __attribute__((pure)) libqwaitclient_qwait_changes_differ(const char* restrict a, const char* restrict b)
+{
+  if ((a == NULL) || (b == NULL))
+    return a != b;
+  return strcmp(a, b) != 0;
+}
+
+
+/**
+ * Get the number of slots to use in a hash table
+ * 
+ * @param   n  The number of elements to store in the table
+ * @return     A power of two that is at least twice `n`
+ */
+static size_t __attribute__((const)) libqwaitclient_qwait_changes_table_size(size_t n)
+{
+  size_t size = 8;
+  while (size < 2 * n)
+    size <<= 1;
+  return size;
+}
+
+
+/**
+ * Find the changes between two snapshots of a queue,
+ * and add them to a change set
+ * 
+ * @param   this       The change set
+ * @param   old_data   The old snapshot
+ * @param   new_data   The new snapshot
+ * @param   old_queue  The index of the queue in the old snapshot
+ * @param   new_queue  The index of the queue in the new snapshot
+ * @return             Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_changes_diff(_this_, const libqwaitclient_qwait_queue_t* restrict old_data,
+					     const libqwaitclient_qwait_queue_t* restrict new_data,
+					     size_t old_queue, size_t new_queue)
+{
+  size_t* restrict table = NULL;
+  char* restrict matched = NULL;
+  const libqwaitclient_qwait_position_t* restrict a;
+  const libqwaitclient_qwait_position_t* restrict b;
+  size_t i, j, k, mask, n = old_data->position_count, m = new_data->position_count;
+  int saved_errno;
+
+#define add(type, i, j, user_id)  \
+  if (libqwaitclient_qwait_changes_add(this, LIBQWAITCLIENT_QWAIT_CHANGE_##type, old_queue, new_queue, i, j, user_id) < 0)  \
+    goto fail
+#define NO_INDEX  LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX
+#define NO_USER   LIBQWAITCLIENT_QWAIT_USER_ID_NONE
+
+  /* Compare the queues themselves. */
+  if (old_data->locked != new_data->locked)
+    {
+      if (new_data->locked)  { add(LOCKED,   NO_INDEX, NO_INDEX, NO_USER); }
+      else                   { add(UNLOCKED, NO_INDEX, NO_INDEX, NO_USER); }
+    }
+  if (old_data->hidden != new_data->hidden)
+    {
+      if (new_data->hidden)  { add(HIDDEN,   NO_INDEX, NO_INDEX, NO_USER); }
+      else                   { add(UNHIDDEN, NO_INDEX, NO_INDEX, NO_USER); }
+    }
+  
+  /* Summaries do not have any entries to compare. */
+  if ((old_data->positions == NULL) || (new_data->positions == NULL))
+    return 0;
+  
+  /* Index the old entries by user, the table stores
+     the index of the entries plus one, so that zero
+     can be used to mark empty slots. */
+  mask = libqwaitclient_qwait_changes_table_size(n) - 1;
+  if (xcalloc(table, mask + 1, size_t))   goto fail;
+  if (xcalloc(matched, n ? n : 1, char))  goto fail;
+  for (i = 0; i < n; i++)
+    {
+      k = libqwaitclient_qwait_changes_hash_position(old_data->positions + i) & mask;
+      while (table[k])
+	k = (k + 1) & mask;
+      table[k] = i + 1;
+    }
+  
+  /* Find the old entry for each new entry. */
+  for (j = 0; j < m; j++)
+    {
+      b = new_data->positions + j;
+      for (k = libqwaitclient_qwait_changes_hash_position(b) & mask; table[k]; k = (k + 1) & mask)
+	if (!matched[table[k] - 1] && libqwaitclient_qwait_changes_same_user(old_data->positions + table[k] - 1, b))
+	  break;
+      
+      if (table[k] == 0)
+	{
+	  add(JOINED, NO_INDEX, j, b->user_id);
+	  continue;
+	}
+      
+      matched[i = table[k] - 1] = 1;
+      a = old_data->positions + i;
+      if ((a->enter_time_seconds != b->enter_time_seconds) || (a->enter_time_mseconds != b->enter_time_mseconds))
+	add(MOVED, i, j, b->user_id);
+      if (libqwaitclient_qwait_changes_differ(a->comment, b->comment))
+	add(COMMENT, i, j, b->user_id);
+      if (libqwaitclient_qwait_changes_differ(a->location, b->location))
+	add(LOCATION, i, j, b->user_id);
+    }
+  
+  /* Everyone else has left. */
+  for (i = 0; i < n; i++)
+    if (!matched[i])
+      add(LEFT, i, NO_INDEX, old_data->positions[i].user_id);
+
+#undef NO_USER
+#undef NO_INDEX
+#undef add
+
+  free(table);
+  free(matched);
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  free(table);
+  free(matched);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Find the changes between two snapshots of a queue,
+ * and add them to a change set
+ * 
+ * Entries are matched by user ID, entries without a
+ * user ID are matched by the time they entered the queue.
+ * Entries are not compared if either snapshot is a summary.
+ * 
+ * @param   this      The change set
+ * @param   old_data  The old snapshot
+ * @param   new_data  The new snapshot
+ * @return            Zero on success, -1 on error, in which
+ *                    case the change set is left unmodified
+ */
+int libqwaitclient_qwait_changes_diff_queue(_this_, const libqwaitclient_qwait_queue_t* restrict old_data,
+					    const libqwaitclient_qwait_queue_t* restrict new_data)
+{
+  size_t count = this->count;
+  
+  if (libqwaitclient_qwait_changes_diff(this, old_data, new_data, 0, 0) < 0)
+    return this->count = count, -1;
+  
+  return 0;
+}
+
+
+/**
+ * Find the changes between two snapshots of the list
+ * of queues, and add them to a change set
+ * 
+ * Queues are matched by their ID, and matched queues
+ * are compared as by `libqwaitclient_qwait_changes_diff_queue`
+ * 
+ * @param   this       The change set
+ * @param   old_data   The old snapshot
+ * @param   old_count  The number of elements in `old_data`
+ * @param   new_data   The new snapshot
+ * @param   new_count  The number of elements in `new_data`
+ * @return             Zero on success, -1 on error, in which
+ *                     case the change set is left unmodified
+ */
+int libqwaitclient_qwait_changes_diff_queues(_this_, const libqwaitclient_qwait_queue_t* restrict old_data,
+					     size_t old_count, const libqwaitclient_qwait_queue_t* restrict new_data,
+					     size_t new_count)
+{
+  size_t* restrict table = NULL;
+  char* restrict matched = NULL;
+  size_t i, j, k, mask, count = this->count;
+  int saved_errno;
+  
+  /* Index the new queues by ID, as the entries are indexed
+     in `libqwaitclient_qwait_changes_diff`. */
+  mask = libqwaitclient_qwait_changes_table_size(new_count) - 1;
+  if (xcalloc(table, mask + 1, size_t))                    goto fail;
+  if (xcalloc(matched, new_count ? new_count : 1, char))  goto fail;
+  for (j = 0; j < new_count; j++)
+    {
+      k = libqwaitclient_intern_hash(new_data[j].name) & mask;
+      while (table[k])
+	k = (k + 1) & mask;
+      table[k] = j + 1;
+    }
+  
+  /* Find the new snapshot of each old queue. */
+  for (i = 0; i < old_count; i++)
+    {
+      for (k = libqwaitclient_intern_hash(old_data[i].name) & mask; table[k]; k = (k + 1) & mask)
+	if (!matched[table[k] - 1] && !strcmp(new_data[table[k] - 1].name, old_data[i].name))
+	  break;
+      
+      if (table[k] == 0)
+	{
+	  if (libqwaitclient_qwait_changes_add(this, LIBQWAITCLIENT_QWAIT_CHANGE_QUEUE_REMOVED,
+					       i, LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX,
+					       LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX,
+					       LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX,
+					       LIBQWAITCLIENT_QWAIT_USER_ID_NONE) < 0)
+	    goto fail;
+	  continue;
+	}
+      
+      matched[j = table[k] - 1] = 1;
+      if (libqwaitclient_qwait_changes_diff(this, old_data + i, new_data + j, i, j) < 0)
+	goto fail;
+    }
+  
+  /* Everything else is new. */
+  for (j = 0; j < new_count; j++)
+    if (!matched[j])
+      if (libqwaitclient_qwait_changes_add(this, LIBQWAITCLIENT_QWAIT_CHANGE_QUEUE_ADDED,
+					   LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX, j,
+					   LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX,
+					   LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX,
+					   LIBQWAITCLIENT_QWAIT_USER_ID_NONE) < 0)
+	goto fail;
+  
+  free(table);
+  free(matched);
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  free(table);
+  free(matched);
+  this->count = count;
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Print a change set to a file for debugging
+ * 
+ * @param  this    The change set
+ * @param  output  The output sink
+ */
+void libqwaitclient_qwait_changes_dump(const _this_, FILE* output)
+{
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  const libqwaitclient_qwait_change_t* restrict change;
+  const char* str_id;
+  size_t i, n;
+
+#define idx(member)  (change->member == LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX ? (ssize_t)-1 : (ssize_t)(change->member))
+
+  fprintf(output, this->count ? "changes:\n" : "no changes\n");
+  for (i = 0, n = this->count; i < n; i++)
+    {
+      change = this->changes + i;
+      str_id = libqwaitclient_qwait_user_id_format(change->user_id, user_id);
+      fprintf(output, "  %s: queue %zi -> %zi, entry %zi -> %zi, user %s\n",
+	      change_names[change->type], idx(old_queue), idx(new_queue),
+	      idx(old_position), idx(new_position), str_id ? str_id : "(none)");
+    }
+
+#undef idx
+}
+
+
+#undef _pos_
+#undef _this_
+
@@ -0,0 +1,237 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_QWAIT_CHANGES_H
+#define LIBQWAITCLIENT_QWAIT_CHANGES_H
+
+
+#include "qwait-queue.h"
+#include "qwait-user-id.h"
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+/**
+ * Used for indices that do not apply to a change
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX  SIZE_MAX
+
+
+/**
+ * A user entered a queue, `new_position` is set
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_JOINED  0
+
+/**
+ * A user left a queue, `old_position` is set
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_LEFT  1
+
+/**
+ * The time a user entered a queue changed, and thus
+ * the user's place in the queue relative to the other
+ * entries, `old_position` and `new_position` are set
+ * 
+ * Moving up in the queue because someone ahead left
+ * is not reported as a move
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_MOVED  2
+
+/**
+ * The comment of an entry in a queue changed,
+ * `old_position` and `new_position` are set
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_COMMENT  3
+
+/**
+ * The location of an entry in a queue changed,
+ * `old_position` and `new_position` are set
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_LOCATION  4
+
+/**
+ * A queue was locked
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_LOCKED  5
+
+/**
+ * A queue was unlocked
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_UNLOCKED  6
+
+/**
+ * A queue was hidden
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_HIDDEN  7
+
+/**
+ * A queue was unhidden
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_UNHIDDEN  8
+
+/**
+ * A queue was created, only `new_queue` is set
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_QUEUE_ADDED  9
+
+/**
+ * A queue was removed, only `old_queue` is set
+ */
+#define LIBQWAITCLIENT_QWAIT_CHANGE_QUEUE_REMOVED  10
+
+
+
+/**
+ * A change between two snapshots of a queue,
+ * or of the list of queues
+ */
+typedef struct libqwaitclient_qwait_change
+{
+  /**
+   * What changed, `LIBQWAITCLIENT_QWAIT_CHANGE_*`
+   */
+  int type;
+  
+  /**
+   * The index of the queue in the old snapshot,
+   * `LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX` if not
+   * applicable, zero when a single queue is diffed
+   */
+  size_t old_queue;
+  
+  /**
+   * The index of the queue in the new snapshot,
+   * `LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX` if not
+   * applicable, zero when a single queue is diffed
+   */
+  size_t new_queue;
+  
+  /**
+   * The index of the entry in the old snapshot of the queue,
+   * `LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX` if not applicable
+   */
+  size_t old_position;
+  
+  /**
+   * The index of the entry in the new snapshot of the queue,
+   * `LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX` if not applicable
+   */
+  size_t new_position;
+  
+  /**
+   * The user of the entry, `LIBQWAITCLIENT_QWAIT_USER_ID_NONE`
+   * if not applicable or if the user ID is unknown
+   */
+  libqwaitclient_qwait_user_id_t user_id;
+  
+} libqwaitclient_qwait_change_t;
+
+
+/**
+ * A set of changes between two snapshots
+ */
+typedef struct libqwaitclient_qwait_changes
+{
+  /**
+   * The changes
+   */
+  libqwaitclient_qwait_change_t* changes;
+  
+  /**
+   * The number of elements in `changes`
+   */
+  size_t count;
+  
+  /**
+   * The allocation size of `changes`
+   */
+  size_t capacity;
+  
+} libqwaitclient_qwait_changes_t;
+
+
+
+#define _this_  libqwaitclient_qwait_changes_t* restrict this
+
+
+/**
+ * Initialise a change set
+ * 
+ * @param  this  The change set
+ */
+void libqwaitclient_qwait_changes_initialise(_this_);
+
+/**
+ * Release all resources in a change set, but not the change set itself
+ * 
+ * @param  this  The change set
+ */
+void libqwaitclient_qwait_changes_destroy(_this_);
+
+/**
+ * Find the changes between two snapshots of a queue,
+ * and add them to a change set
+ * 
+ * Entries are matched by user ID, entries without a
+ * user ID are matched by the time they entered the queue.
+ * Entries are not compared if either snapshot is a summary.
+ * 
+ * @param   this      The change set
+ * @param   old_data  The old snapshot
+ * @param   new_data  The new snapshot
+ * @return            Zero on success, -1 on error, in which
+ *                    case the change set is left unmodified
+ */
+int libqwaitclient_qwait_changes_diff_queue(_this_, const libqwaitclient_qwait_queue_t* restrict old_data,
+					    const libqwaitclient_qwait_queue_t* restrict new_data);
+
+/**
+ * Find the changes between two snapshots of the list
+ * of queues, and add them to a change set
+ * 
+ * Queues are matched by their ID, and matched queues
+ * are compared as by `libqwaitclient_qwait_changes_diff_queue`
+ * 
+ * @param   this       The change set
+ * @param   old_data   The old snapshot
+ * @param   old_count  The number of elements in `old_data`
+ * @param   new_data   The new snapshot
+ * @param   new_count  The number of elements in `new_data`
+ * @return             Zero on success, -1 on error, in which
+ *                     case the change set is left unmodified
+ */
+int libqwaitclient_qwait_changes_diff_queues(_this_, const libqwaitclient_qwait_queue_t* restrict old_data,
+					     size_t old_count, const libqwaitclient_qwait_queue_t* restrict new_data,
+					     size_t new_count);
+
+/**
+ * Print a change set to a file for debugging
+ * 
+ * @param  this    The change set
+ * @param  output  The output sink
+ */
+void libqwaitclient_qwait_changes_dump(const _this_, FILE* output);
+
+
+#undef _this_
+
+
+#endif
+
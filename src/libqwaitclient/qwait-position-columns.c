@@ -0,0 +1,145 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qwait-position-columns.h"
+
+#include "macros.h"
+#include "computers.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_qwait_position_columns_t* restrict this
+
+
+
+/**
+ * Initialises columnar queue entries
+ * 
+ * @param  this  The columns
+ */
+void libqwaitclient_qwait_position_columns_initialise(_this_)
+{
+  memset(this, 0, sizeof(libqwaitclient_qwait_position_columns_t));
+}
+
+
+/**
+ * Releases all resources in columnar queue entries,
+ * but not the structure itself
+ * 
+ * @param  this  The columns
+ */
+void libqwaitclient_qwait_position_columns_destroy(_this_)
+{
+  free(this->enter_times);
+  free(this->user_ids);
+  free(this->rooms);
+  free(this->flags);
+  free(this->real_names);
+  free(this->locations);
+  free(this->comments);
+  free(this->pool);
+  memset(this, 0, sizeof(libqwaitclient_qwait_position_columns_t));
+}
+
+
+/**
+ * Store queue entries column by column
+ * 
+ * @param   this       The columns to fill in
+ * @param   positions  The queue entries
+ * @param   count      The number of elements in `positions`
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_position_columns_build(_this_, const libqwaitclient_qwait_position_t* restrict positions,
+						size_t count)
+{
+  const libqwaitclient_qwait_position_t* restrict pos;
+  size_t i, size = 0, n = count ? count : 1;
+  char* p;
+  int saved_errno;
+
+#define len(member)  (pos->member == NULL ? 0 : strlen(pos->member) + 1)
+#define put(member, column)							\
+  if (pos->member == NULL)							\
+    this->column[i] = LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL;		\
+  else										\
+    this->column[i] = (size_t)(p - this->pool), p = stpcpy(p, pos->member) + 1
+  
+  libqwaitclient_qwait_position_columns_initialise(this);
+  
+  /* Measure the string pool so that it is allocated once. */
+  for (i = 0; i < count; i++)
+    {
+      pos = positions + i;
+      size += len(real_name) + len(location) + len(comment);
+    }
+  
+  if (xmalloc(this->enter_times, n, int64_t))                         goto fail;
+  if (xmalloc(this->user_ids,    n, libqwaitclient_qwait_user_id_t))  goto fail;
+  if (xmalloc(this->rooms,       n, uint8_t))                         goto fail;
+  if (xmalloc(this->flags,       n, int))                             goto fail;
+  if (xmalloc(this->real_names,  n, size_t))                          goto fail;
+  if (xmalloc(this->locations,   n, size_t))                          goto fail;
+  if (xmalloc(this->comments,    n, size_t))                          goto fail;
+  if (xmalloc(this->pool, size ? size : 1, char))                     goto fail;
+  this->pool_size = size;
+  this->count = count;
+  
+  /* Fill in the columns. */
+  for (i = 0, p = this->pool; i < count; i++)
+    {
+      pos = positions + i;
+      this->enter_times[i] = (int64_t)(pos->enter_time_seconds) * 1000 + pos->enter_time_mseconds;
+      this->user_ids[i] = pos->user_id;
+      this->rooms[i] = (uint8_t)libqwaitclient_computers_get_room(pos->location);
+      this->flags[i] = pos->flags;
+      put(real_name, real_names);
+      put(location, locations);
+      put(comment, comments);
+    }
+
+#undef put
+#undef len
+
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  libqwaitclient_qwait_position_columns_destroy(this);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Get a string from the string pool
+ * 
+ * @param   this    The columns
+ * @param   offset  The offset of the string, from `real_names`, `locations` or `comments`
+ * @return          The string, `NULL` if `offset` is `LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL`
+ */
+const char* libqwaitclient_qwait_position_columns_string(const _this_, size_t offset)
+{
+  return offset == LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL ? NULL : this->pool + offset;
+}
+
+
+#undef _this_
+
@@ -0,0 +1,147 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_H
+#define LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_H
+
+
+#include "qwait-position.h"
+#include "qwait-user-id.h"
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * The string offset used for strings that are `NULL`
+ */
+#define LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL  SIZE_MAX
+
+
+
+/**
+ * Queue entries stored column by column, so that
+ * loops that look at only one or two properties of
+ * each entry run over dense arrays; element `i` of
+ * each array belongs to the `i`:th entry
+ */
+typedef struct libqwaitclient_qwait_position_columns
+{
+  /**
+   * The number of entries
+   */
+  size_t count;
+  
+  /**
+   * The wall-clock time each entry was added
+   * to its queue, in milliseconds since the epoch
+   */
+  int64_t* enter_times;
+  
+  /**
+   * The user ID for each entry
+   */
+  libqwaitclient_qwait_user_id_t* user_ids;
+  
+  /**
+   * The computer room for each entry's location,
+   * `LIBQWAITCLIENT_COMPUTERS_UKNOWN` if unknown
+   */
+  uint8_t* rooms;
+  
+  /**
+   * `LIBQWAITCLIENT_QWAIT_POSITION_*` flags for each entry
+   */
+  int* flags;
+  
+  /**
+   * The offset in `pool` of each entry's real name,
+   * `LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL` if `NULL`
+   */
+  size_t* real_names;
+  
+  /**
+   * The offset in `pool` of each entry's location,
+   * `LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL` if `NULL`
+   */
+  size_t* locations;
+  
+  /**
+   * The offset in `pool` of each entry's comment,
+   * `LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL` if `NULL`
+   */
+  size_t* comments;
+  
+  /**
+   * All strings, NUL-terminated and back to back
+   */
+  char* pool;
+  
+  /**
+   * The size of `pool`
+   */
+  size_t pool_size;
+  
+} libqwaitclient_qwait_position_columns_t;
+
+
+
+#define _this_  libqwaitclient_qwait_position_columns_t* restrict this
+
+
+/**
+ * Initialises columnar queue entries
+ * 
+ * @param  this  The columns
+ */
+void libqwaitclient_qwait_position_columns_initialise(_this_);
+
+/**
+ * Releases all resources in columnar queue entries,
+ * but not the structure itself
+ * 
+ * @param  this  The columns
+ */
+void libqwaitclient_qwait_position_columns_destroy(_this_);
+
+/**
+ * Store queue entries column by column
+ * 
+ * @param   this       The columns to fill in
+ * @param   positions  The queue entries
+ * @param   count      The number of elements in `positions`
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_position_columns_build(_this_, const libqwaitclient_qwait_position_t* restrict positions,
+						size_t count);
+
+/**
+ * Get a string from the string pool
+ * 
+ * @param   this    The columns
+ * @param   offset  The offset of the string, from `real_names`, `locations` or `comments`
+ * @return          The string, `NULL` if `offset` is `LIBQWAITCLIENT_QWAIT_POSITION_COLUMNS_NULL`
+ */
+const char* libqwaitclient_qwait_position_columns_string(const _this_, size_t offset) __attribute__((pure));
+
+
+#undef _this_
+
+
+#endif
+
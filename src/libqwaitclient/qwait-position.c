@@ -19,10 +19,13 @@
 
 #include "macros.h"
 #include "json.h"
+#include "json-schema.h"
 
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <limits.h>
 #include <errno.h>
 #include <time.h>
 #include <sys/time.h>
@@ -44,6 +47,105 @@ static const char* months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
 static const char* wdays[] = { "Mon", "Tue", "Wed", "Thu", "Fri", "Say", "Sun" };
 
 
+/**
+ * The shortest time, in seconds, between two changes of the
+ * local timezone, that is assumed when caching timezones;
+ * if the timezone changes more often than this, and back,
+ * times in between may be given the wrong timezone
+ */
+#define ZONE_SPAN  (7L * 24L * 60L * 60L)
+
+
+/**
+ * A local timezone, and the interval in which it is used
+ */
+typedef struct libqwaitclient_qwait_position_zone
+{
+  /**
+   * The first second the timezone is known to be used
+   */
+  time_t from;
+  
+  /**
+   * The last second the timezone is known to be used
+   */
+  time_t until;
+  
+  /**
+   * The timezone offset, in seconds east of UTC
+   */
+  long gmtoff;
+  
+  /**
+   * The timezone acronym
+   */
+  char timezone[11];
+  
+} libqwaitclient_qwait_position_zone_t;
+
+
+#define F(name, type, member, aux)						\
+  LIBQWAITCLIENT_JSON_FIELD(name, LIBQWAITCLIENT_JSON_FIELD_##type, 1,		\
+			    offsetof(libqwaitclient_qwait_position_t, member),	\
+			    offsetof(libqwaitclient_qwait_position_t, aux))
+
+/**
+ * The members of a queue entry
+ */
+static const libqwaitclient_json_field_t fields[] =
+  {
+    F("location",     NULLABLE_STRING, location,           location),
+    F("comment",      NULLABLE_STRING, comment,            comment),
+    F("userName",     USER_ID,         user_id,            user_id),
+    F("readableName", NULLABLE_STRING, real_name,          real_name),
+    F("startTime",    MILLISECONDS,    enter_time_seconds, enter_time_mseconds),
+  };
+
+#undef F
+
+
+/**
+ * The default keywords for classifying queue entries by their comments
+ */
+static const libqwaitclient_matcher_pattern_t comment_keywords[] =
+  {
+    { "help",    LIBQWAITCLIENT_QWAIT_POSITION_HELP,         0 },
+    { "hjälp",   LIBQWAITCLIENT_QWAIT_POSITION_HELP,         0 },
+    { "hjalp",   LIBQWAITCLIENT_QWAIT_POSITION_HELP,         0 },
+    { "present", LIBQWAITCLIENT_QWAIT_POSITION_PRESENTATION, 0 },
+    { "redovis", LIBQWAITCLIENT_QWAIT_POSITION_PRESENTATION, 0 }
+  };
+
+
+/**
+ * `comment_keywords` compiled into a matcher,
+ * it is compiled when the library is loaded
+ */
+static libqwaitclient_matcher_t comment_matcher;
+
+
+
+/**
+ * Compile `comment_keywords` when the library is loaded,
+ * if it fails, no queue entry will be classified
+ */
+static void __attribute__((constructor)) libqwaitclient_qwait_position_load(void)
+{
+  if (libqwaitclient_matcher_compile(&comment_matcher, comment_keywords,
+				     sizeof(comment_keywords) / sizeof(*comment_keywords)) == 0)
+    comment_matcher.squeeze = 1;
+}
+
+
+/**
+ * Release `comment_matcher` when the library is unloaded
+ */
+static void __attribute__((destructor)) libqwaitclient_qwait_position_unload(void)
+{
+  libqwaitclient_matcher_destroy(&comment_matcher);
+}
+
+
 /**
  * Initialises a queue entry
  * 
@@ -64,7 +166,6 @@ void libqwaitclient_qwait_position_destroy(_this_)
 {
   free(this->location);
   free(this->comment);
-  free(this->user_id);
   free(this->real_name);
   memset(this, 0, sizeof(libqwaitclient_qwait_position_t));
 }
@@ -74,71 +175,36 @@ void libqwaitclient_qwait_position_destroy(_this_)
  * Contextually parses parsed JSON data into a queue entry
  * 
  * @param   this  The queue entry to fill in
- * @param   data  The data to parse
+ * @param   data  The data to parse, strings are taken out of it
  * @return        Zero on success, -1 on error
  */
-int libqwaitclient_qwait_position_parse(_this_, const libqwaitclient_json_t* restrict data)
+int libqwaitclient_qwait_position_parse(_this_, libqwaitclient_json_t* restrict data)
 {
-  const libqwaitclient_json_t* restrict data_location   = NULL;
-  const libqwaitclient_json_t* restrict data_comment    = NULL;
-  const libqwaitclient_json_t* restrict data_user_id    = NULL;
-  const libqwaitclient_json_t* restrict data_real_name  = NULL;
-  const libqwaitclient_json_t* restrict data_enter_time = NULL;
-  size_t i, n = data->length;
   int saved_errno;
   
-  if (data->type != LIBQWAITCLIENT_JSON_TYPE_OBJECT)
-    return errno = EINVAL, -1;
-  
-#define test(want)      ((strlen(want) == len) && !memcmp(name, want, len * sizeof(char)))
-#define str(var, have)  ((have->type == LIBQWAITCLIENT_JSON_TYPE_NULL) ?	\
-			  (var = NULL, 0) :					\
-			  (var = libqwaitclient_json_to_zstr(have), var == NULL))
-  
-  /* Read information. */
-  for (i = 0; i < n; i++)
+  if (libqwaitclient_json_schema_decode(this, fields, sizeof(fields) / sizeof(*fields), data, NULL) < 0)
     {
-      const libqwaitclient_json_t* restrict value = &(data->data.object[i].value);
-      char* name = data->data.object[i].name;
-      size_t len = data->data.object[i].name_length;
-      
-      if      (test("location"))      data_location   = value;
-      else if (test("comment"))       data_comment    = value;
-      else if (test("userName"))      data_user_id    = value;
-      else if (test("readableName"))  data_real_name  = value;
-      else if (test("startTime"))     data_enter_time = value;
-      else
-	goto einval;
+      saved_errno = errno;
+      libqwaitclient_qwait_position_destroy(this);
+      return errno = saved_errno, -1;
     }
   
-  /* Check that everything was found. */
-  if (data_location   == NULL)  goto einval;
-  if (data_comment    == NULL)  goto einval;
-  if (data_user_id    == NULL)  goto einval;
-  if (data_real_name  == NULL)  goto einval;
-  if (data_enter_time == NULL)  goto einval;
-  
-  /* Evaluate data. */
-  if (str(this->location,  data_location))    goto fail;
-  if (str(this->comment,   data_comment))     goto fail;
-  if (str(this->user_id,   data_user_id))     goto fail;
-  if (str(this->real_name, data_real_name))   goto fail;
-  if (data_enter_time->type != LIBQWAITCLIENT_JSON_TYPE_INTEGER)
-    goto einval;
-  this->enter_time_seconds = (time_t)(data_enter_time->data.integer / 1000);
-  this->enter_time_mseconds   = (int)(data_enter_time->data.integer % 1000);
-  
-#undef str
-#undef test
-  
+  libqwaitclient_qwait_position_classify(this, NULL);
   return 0;
-  
- einval:
-  errno = EINVAL;
- fail:
-  saved_errno = errno;
-  libqwaitclient_qwait_position_destroy(this);
-  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Get the user ID of a queue entry as a string
+ * 
+ * @param   this    The queue entry
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, `NULL` if the user ID is unknown
+ */
+char* libqwaitclient_qwait_position_get_user_id(const _this_, char* restrict buffer)
+{
+  return libqwaitclient_qwait_user_id_format(this->user_id, buffer);
 }
 
 
@@ -164,6 +230,68 @@ int libqwaitclient_qwait_position_compare_by_time(const void* a, const void* b)
 }
 
 
+/**
+ * Classify a queue entry by its comment, this is done
+ * when the entry is parsed, with the default keywords
+ * 
+ * The keyword that occurs first in the comment decides the
+ * flags, so "Redovisa, behöver hjälp" is a presentation
+ * 
+ * The default keywords are "help", "hjälp" and "hjalp" for
+ * `LIBQWAITCLIENT_QWAIT_POSITION_HELP`, and "present" and
+ * "redovis" for `LIBQWAITCLIENT_QWAIT_POSITION_PRESENTATION`,
+ * runs of repeated letters are squeezed, so "heeelp" matches
+ * 
+ * @param  this      The queue entry
+ * @param  keywords  Matcher with `LIBQWAITCLIENT_QWAIT_POSITION_*` flags as the
+ *                   values of the keywords, `NULL` for the default keywords
+ */
+void libqwaitclient_qwait_position_classify(_this_, const libqwaitclient_matcher_t* restrict keywords)
+{
+  const char* restrict p = this->comment;
+  int exercise = -1;
+  
+  this->flags = (int)libqwaitclient_matcher_first(keywords ? keywords : &comment_matcher, p);
+  
+  /* Find the first number, without overflowing. */
+  if (p != NULL)
+    for (p += strcspn(p, "0123456789"); ('0' <= *p) && (*p <= '9') && (exercise < INT_MAX / 10); p++)
+      exercise = (exercise < 0 ? 0 : exercise * 10) + (*p & 15);
+  this->exercise = exercise;
+}
+
+
+/**
+ * Classify a set of queue entries by their comments
+ * 
+ * @param  positions  The queue entries
+ * @param  count      The number of elements in `positions`
+ * @param  keywords   Matcher with `LIBQWAITCLIENT_QWAIT_POSITION_*` flags as the
+ *                    values of the keywords, `NULL` for the default keywords
+ */
+void libqwaitclient_qwait_position_classify_all(libqwaitclient_qwait_position_t* restrict positions, size_t count,
+						const libqwaitclient_matcher_t* restrict keywords)
+{
+  size_t i;
+  for (i = 0; i < count; i++)
+    libqwaitclient_qwait_position_classify(positions + i, keywords);
+}
+
+
+/**
+ * Check whether a queue entry is a request for help,
+ * rather than for presentation, by looking at the
+ * flags it was classified with
+ * 
+ * @param   this  The queue entry
+ * @return        1 if the entry is a request for help, 0 otherwise
+ */
+int libqwaitclient_qwait_position_is_help(const _this_)
+{
+  return (this->flags & LIBQWAITCLIENT_QWAIT_POSITION_HELP) ? 1 : 0;
+}
+
+
 /**
  * Print a queue entry to a file for debugging
  * 
@@ -174,39 +302,115 @@ void libqwaitclient_qwait_position_dump(const _this_, FILE* output)
 {
   libqwaitclient_qwait_position_time_t enter_time;
   libqwaitclient_qwait_position_time_t enter_diff;
-  char* str_time = NULL;
-  char* str_diff = NULL;
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  char str_time[LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE] = "(null)";
+  char str_diff[LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE] = "(null)";
+  const char* str_id = libqwaitclient_qwait_position_get_user_id(this, user_id);
   
   if (!libqwaitclient_qwait_position_parse_time(this, &enter_time, 1))
-    str_time = libqwaitclient_qwait_position_string_time(&enter_time, 0);
+    libqwaitclient_qwait_position_format_time(&enter_time, 0, str_time);
   if (!libqwaitclient_qwait_position_diff_time(this, &enter_diff, NULL))
-    str_diff = libqwaitclient_qwait_position_string_time(&enter_diff, 0);
+    libqwaitclient_qwait_position_format_time(&enter_diff, 0, str_diff);
   
   fprintf(output, "\"%s\"(%s) @ %s: %s, entered %ji.%03i (%s; %s)\n",
-	  this->real_name, this->user_id, this->location, this->comment,
+	  this->real_name, str_id ? str_id : "(none)",
+	  this->location, this->comment,
 	  (intmax_t)(this->enter_time_seconds), this->enter_time_mseconds,
 	  str_time, str_diff);
+}
+
+
+/**
+ * Resolve the local timezone at a point in time
+ * 
+ * @param   zone  Output parameter for the timezone, `from` and `until` are not set
+ * @param   t     The point in time
+ * @return        Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_position_zone_at(libqwaitclient_qwait_position_zone_t* restrict zone, time_t t)
+{
+  struct tm local_time;
+  if (localtime_r(&t, &local_time) == NULL)
+    return -1;
+  zone->gmtoff = local_time.tm_gmtoff;
+  snprintf(zone->timezone, sizeof(zone->timezone), "%s", local_time.tm_zone);
+  return 0;
+}
+
+
+/**
+ * Extend the interval a resolved timezone is known to be used in
+ * by `ZONE_SPAN` seconds, towards a point in time that is at most
+ * that far outside of it; if the timezone changes in between, the
+ * interval is ended at the change, and if the point in time is
+ * after the change, the timezone is replaced by the new one
+ * 
+ * Since the timezone is assumed to change at most once within
+ * `ZONE_SPAN` seconds, it is unchanged if it is the same at
+ * both ends of the extension, so this normally takes one probe
+ * 
+ * @param   zone       The timezone, its interval will cover `t`
+ * @param   t          The point in time
+ * @param   direction  -1 if `t` is before `zone->from`,
+ *                     1 if `t` is after `zone->until`
+ * @return             Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_position_zone_extend(libqwaitclient_qwait_position_zone_t* restrict zone,
+						      time_t t, int direction)
+{
+  libqwaitclient_qwait_position_zone_t next, probe;
+  time_t inside = direction < 0 ? zone->from : zone->until;
+  time_t outside = inside + direction * ZONE_SPAN, far = outside, mid;
+
+#define same(a, b)  (((a).gmtoff == (b).gmtoff) && !strcmp((a).timezone, (b).timezone))
+#define bound(z)    *(direction < 0 ? &((z)->from) : &((z)->until))
+
+  if (libqwaitclient_qwait_position_zone_at(&next, far) < 0)
+    return -1;
+  if (same(next, *zone))
+    return bound(zone) = far, 0;
+  
+  /* Binary search for the change, it is the only one in the extension. */
+  while ((inside - outside) * direction < -1)
+    {
+      mid = inside + (outside - inside) / 2;
+      if (libqwaitclient_qwait_position_zone_at(&probe, mid) < 0)
+	return -1;
+      *(same(probe, *zone) ? &inside : &outside) = mid;
+    }
+  bound(zone) = inside;
   
-  free(str_time);
-  free(str_diff);
+  /* The new timezone is used from the change to the end of the extension. */
+  if ((t - inside) * direction > 0)
+    {
+      *(direction < 0 ? &(next.until) : &(next.from)) = outside;
+      bound(&next) = far;
+      *zone = next;
+    }
+
+#undef bound
+#undef same
+
+  return 0;
 }
 
 
 /**
- * Get the time a entry was added to its queue
+ * Convert a time to a broken-down time
  * 
- * @param   this   The queue entry
- * @param   time   Output parameter for when the entry was added to the queue
- * @param   local  Whether to return in local time rather than UTC
- * @return         Zero on success, -1 on error
+ * @param  time  Output parameter for the time
+ * @param  s     The whole seconds since the epoch
+ * @param  ms    The milliseconds
+ * @param  zone  The local timezone at the time, `NULL` for UTC
  */
-int libqwaitclient_qwait_position_parse_time(const _this_, _time_, int local)
+static void libqwaitclient_qwait_position_convert_time(_time_, time_t s, int ms,
+							const libqwaitclient_qwait_position_zone_t* restrict zone)
 {
   /* We assume that the server is correct and that the time is positive,
    * and that the year is at least 2001. */
   
-  time_t s = this->enter_time_seconds;
   int is_leap;
+  long tz;
   
   time->is_difference = 0;
   
@@ -216,22 +420,15 @@ int libqwaitclient_qwait_position_parse_time(const _this_, _time_, int local)
   time->timezone_h = 0;
   time->timezone_m = 0;
   
-  if (!local)
+  if (zone == NULL)
     sprintf(time->timezone, "UTC");
   else
     {
-      time_t universal_time = s;
-      struct tm local_time;
-      long tz;
-      
-      /* Get timezone. */
-      localtime_r(&universal_time, &local_time);
-      
       /* Copy timezone acronym. */
-      sprintf(time->timezone, "%s", local_time.tm_zone);
+      strcpy(time->timezone, zone->timezone);
       
       /* Timezone offset */
-      tz = local_time.tm_gmtoff / 60;
+      tz = zone->gmtoff / 60;
       tz *= time->sign = tz < 0 ? -1 : tz > 0 ? 1 : 0;
       time->timezone_h = (unsigned)tz / 60;
       time->timezone_m = (unsigned)tz % 60;
@@ -242,7 +439,7 @@ int libqwaitclient_qwait_position_parse_time(const _this_, _time_, int local)
     }
   
   /* The time of the day. */
-  time->msec = (unsigned)(this->enter_time_mseconds);
+  time->msec = (unsigned)(ms);
   time->sec  = (unsigned)(s % 60), s /= 60;
   time->min  = (unsigned)(s % 60), s /= 60;
   time->hour = (unsigned)(s % 24), s /= 24;
@@ -286,35 +483,90 @@ int libqwaitclient_qwait_position_parse_time(const _this_, _time_, int local)
   else if (s < M(11))  time->month = 11, time->day = (unsigned)(s - M(10) + 1);
   else                 time->month = 12, time->day = (unsigned)(s - M(11) + 1);
 #undef M
+}
+
+
+/**
+ * Get the time a entry was added to its queue
+ * 
+ * @param   this   The queue entry
+ * @param   time   Output parameter for when the entry was added to the queue
+ * @param   local  Whether to return in local time rather than UTC
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_position_parse_time(const _this_, _time_, int local)
+{
+  libqwaitclient_qwait_position_zone_t zone;
+  
+  if (local && (libqwaitclient_qwait_position_zone_at(&zone, this->enter_time_seconds) < 0))
+    return -1;
   
+  libqwaitclient_qwait_position_convert_time(time, this->enter_time_seconds,
+					     this->enter_time_mseconds, local ? &zone : NULL);
   return 0;
 }
 
 
 /**
- * Calculate how long ago a entry was added to its queue
+ * Get the time a set of entries were added to their queue
  * 
- * @param   this  The queue entry
- * @param   time  Output parameter for how long ago the entry was added to the queue
- * @param   now   Please set to `&t` where `t` is set by `clock_gettime(CLOCK_REALTIME, &t)`
- * @return        Zero on success, -1 on error
+ * The local timezone is only resolved once, and then checked
+ * once per week that the entries span, rather than resolved
+ * once per entry; the timezone is assumed to change at most
+ * once a week, if it changes more often than that, and back,
+ * entries in between may be given the wrong timezone
+ * 
+ * @param   positions  The queue entries
+ * @param   count      The number of elements in `positions`
+ * @param   times      Output parameter for when the entries were added to the queue,
+ *                     must have room for `count` elements
+ * @param   local      Whether to return in local time rather than UTC
+ * @return             Zero on success, -1 on error
  */
-int libqwaitclient_qwait_position_diff_time(const _this_, _time_, const struct timespec* restrict now)
+int libqwaitclient_qwait_position_parse_times(const libqwaitclient_qwait_position_t* restrict positions, size_t count,
+					      libqwaitclient_qwait_position_time_t* restrict times, int local)
 {
-  struct timespec now_;
+  libqwaitclient_qwait_position_zone_t zone;
+  size_t i;
   time_t s;
-  int ms;
+  int have_zone = 0, r;
   
-  if (now == NULL)
+  for (i = 0; i < count; i++)
     {
-      if (clock_gettime(CLOCK_REALTIME, &now_) < 0)
-	return -1;
-      now = &now_;
+      s = positions[i].enter_time_seconds;
+      
+      /* Extend the cached interval to the entry, if it is close,
+	 otherwise resolve the timezone from scratch at the entry. */
+      if (local && !(have_zone && (zone.from <= s) && (s <= zone.until)))
+	{
+	  if (have_zone && (s > zone.until) && (s - zone.until <= ZONE_SPAN))
+	    r = libqwaitclient_qwait_position_zone_extend(&zone, s, +1);
+	  else if (have_zone && (s < zone.from) && (zone.from - s <= ZONE_SPAN))
+	    r = libqwaitclient_qwait_position_zone_extend(&zone, s, -1);
+	  else
+	    r = libqwaitclient_qwait_position_zone_at(&zone, s), zone.from = zone.until = s;
+	  if (r < 0)
+	    return -1;
+	  have_zone = 1;
+	}
+      
+      libqwaitclient_qwait_position_convert_time(times + i, s, positions[i].enter_time_mseconds,
+						 local ? &zone : NULL);
     }
   
-  s = now->tv_sec - this->enter_time_seconds;
-  ms = (int)((now->tv_nsec + 500000L) / 1000000L) - this->enter_time_mseconds;
-  
+  return 0;
+}
+
+
+/**
+ * Convert a time difference to a broken-down time difference
+ * 
+ * @param  time  Output parameter for the time difference
+ * @param  s     The difference in whole seconds
+ * @param  ms    The difference in milliseconds, added to `s`
+ */
+static void libqwaitclient_qwait_position_convert_difference(_time_, time_t s, int ms)
+{
   time->is_difference = 1,  time->sign =  s < 0 ? -1 :  s > 0 ? 1 : 0;
   if (time->sign == 0)      time->sign = ms < 0 ? -1 : ms > 0 ? 1 : 0;
   if (time->sign < 0)
@@ -328,49 +580,103 @@ int libqwaitclient_qwait_position_diff_time(const _this_, _time_, const struct t
   time->min  = (unsigned)(s % 60), s /= 60;
   time->hour = (unsigned)(s % 24), s /= 24;
   time->day  = (unsigned)s;
+}
+
+
+/**
+ * Calculate how long ago a entry was added to its queue
+ * 
+ * @param   this  The queue entry
+ * @param   time  Output parameter for how long ago the entry was added to the queue
+ * @param   now   Please set to `&t` where `t` is set by `clock_gettime(CLOCK_REALTIME, &t)`
+ * @return        Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_position_diff_time(const _this_, _time_, const struct timespec* restrict now)
+{
+  return libqwaitclient_qwait_position_diff_times(this, 1, time, now);
+}
+
+
+/**
+ * Calculate how long ago a set of entries were added to their queue
+ * 
+ * The current time is read and rounded once, rather than
+ * once per entry, no timezone is involved in the differences
+ * 
+ * @param   positions  The queue entries
+ * @param   count      The number of elements in `positions`
+ * @param   times      Output parameter for how long ago the entries were added to the queue,
+ *                     must have room for `count` elements
+ * @param   now        Please set to `&t` where `t` is set by `clock_gettime(CLOCK_REALTIME, &t)`
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_position_diff_times(const libqwaitclient_qwait_position_t* restrict positions, size_t count,
+					     libqwaitclient_qwait_position_time_t* restrict times,
+					     const struct timespec* restrict now)
+{
+  struct timespec now_;
+  size_t i;
+  time_t now_s;
+  int now_ms;
+  
+  if (now == NULL)
+    {
+      if (clock_gettime(CLOCK_REALTIME, &now_) < 0)
+	return -1;
+      now = &now_;
+    }
+  now_s = now->tv_sec;
+  now_ms = (int)((now->tv_nsec + 500000L) / 1000000L);
+  
+  for (i = 0; i < count; i++)
+    libqwaitclient_qwait_position_convert_difference(times + i, now_s - positions[i].enter_time_seconds,
+						     now_ms - positions[i].enter_time_mseconds);
   
   return 0;
 }
 
 
+/**
+ * Append formatted text to a time string that is being built
+ * 
+ * @param  format:const char*  The format string
+ * @param  ...                 The format arguments
+ */
+#define p(...)  \
+  (n += (size_t)snprintf(buffer + n, LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE - n, __VA_ARGS__))
+
+
 /**
  * Make a coarse human-readable string of the time created by
  * `libqwaitclient_qwait_position_parse_time` or `libqwaitclient_qwait_position_diff_time`
  * 
- * @param   time  The time the entry was added to the queue or how long ago that was
- * @return        The time information as a free:able string, `NULL` on error
+ * @param   time    The time the entry was added to the queue or how long ago that was
+ * @param   buffer  Output buffer for the string, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE` bytes large
+ * @return          The length of the string
  */
-static char* libqwaitclient_qwait_position_coarse_string_time(const _time_)
+static size_t libqwaitclient_qwait_position_coarse_format_time(const _time_, char* restrict buffer)
 {
-  char* buf;
-  if (xmalloc(buf, 16 + 3 * sizeof(unsigned), char)) /* a bit excessive */
-    return NULL;
+  size_t n = 0;
   
   if (time->is_difference == 0)
-    {
-      sprintf(buf, "%u %s %02u:%02u", time->day, months[time->month - 1], time->hour, time->min);
-      return buf;
-    }
-  else if (time->day  == 1)  sprintf(buf,  "1 day");
-  else if (time->day  >= 2)  sprintf(buf, "%u days", time->day);
-  else if (time->hour == 1)  sprintf(buf,  "1 hour");
-  else if (time->hour >= 2)  sprintf(buf, "%u hours", time->hour);
-  else if (time->min  == 1)  sprintf(buf,  "1 minute");
-  else if (time->min  >= 2)  sprintf(buf, "%u minutes", time->min);
-  else if (time->sec  >= 5)  sprintf(buf, "%u seconds", time->sec);
-  else
-    {
-      sprintf(buf, "Now");
-      return buf;
-    }
+    return p("%u %s %02u:%02u", time->day, months[time->month - 1], time->hour, time->min);
+  
+  if ((time->day | time->hour | time->min) == 0 && (time->sec < 5))
+    return p("Now");
   
   if (time->sign < 0)
-    {
-      memmove(buf + 3, buf, (strlen(buf) + 1) * sizeof(char));
-      memcpy(buf, "In ", strlen("In ") * sizeof(char));
-    }
+    p("In ");
   
-  return buf;
+  if      (time->day  == 1)  p( "1 day");
+  else if (time->day  >= 2)  p("%u days", time->day);
+  else if (time->hour == 1)  p( "1 hour");
+  else if (time->hour >= 2)  p("%u hours", time->hour);
+  else if (time->min  == 1)  p( "1 minute");
+  else if (time->min  >= 2)  p("%u minutes", time->min);
+  else                       p("%u seconds", time->sec);
+  
+  return n;
 }
 
 
@@ -378,56 +684,74 @@ static char* libqwaitclient_qwait_position_coarse_string_time(const _time_)
  * Make a detailed human-readable string of the time created by
  * `libqwaitclient_qwait_position_parse_time` or `libqwaitclient_qwait_position_diff_time`
  * 
- * @param   time  The time the entry was added to the queue or how long ago that was
- * @return        The time information as a free:able string, `NULL` on error
+ * @param   time    The time the entry was added to the queue or how long ago that was
+ * @param   buffer  Output buffer for the string, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE` bytes large
+ * @return          The length of the string
  */
-static char* libqwaitclient_qwait_position_detailed_string_time(const _time_)
+static size_t libqwaitclient_qwait_position_detailed_format_time(const _time_, char* restrict buffer)
 {
-  char* buf;
-  if (xmalloc(buf, 60 + 3 * sizeof(unsigned), char)) /* a bit excessive */
-    return NULL;
+  size_t n = 0;
   
   if (time->is_difference == 0)
-    {
-      sprintf(buf, "%i-(%02u)%s-%02u %02u:%02u:%02u.%03u %s (UTC%s%02u%02u), %s",
-	      time->year, time->month, months[time->month - 1], time->day,
-	      time->hour, time->min, time->sec, time->msec, time->timezone,
-	      time->sign < 0 ? "-" : "+", time->timezone_h, time->timezone_m,
-	      wdays[time->wday]);
-      return buf;
-    }
+    return p("%i-(%02u)%s-%02u %02u:%02u:%02u.%03u %s (UTC%s%02u%02u), %s",
+	     time->year, time->month, months[time->month - 1], time->day,
+	     time->hour, time->min, time->sec, time->msec, time->timezone,
+	     time->sign < 0 ? "-" : "+", time->timezone_h, time->timezone_m,
+	     wdays[time->wday]);
   
   if (time->sign == 0)
-    return sprintf(buf, "Now"), buf;
-  
-  *buf = 0;
+    return p("Now");
   
   if (time->sign < 0)
-    sprintf(buf + strlen(buf), "In ");
+    p("In ");
   
-  if (time->day == 1)  sprintf(buf + strlen(buf),  "1 day, ");
-  if (time->day >= 2)  sprintf(buf + strlen(buf), "%u days, ", time->day);
+  if (time->day == 1)  p( "1 day, ");
+  if (time->day >= 2)  p("%u days, ", time->day);
   
 #define z(x)  (time->x == 0)
 #define o(x)  (time->x == 1)
   
   if (time->day || time->hour)
-    sprintf(buf,  "%u:%02u:%02u.%03u %s",
-	    time->hour, time->min, time->sec, time->msec,
-	    (o(hour) && z(min) && z(sec) && z(msec)) ? "hour" : "hours");
+    p("%u:%02u:%02u.%03u %s",
+      time->hour, time->min, time->sec, time->msec,
+      (o(hour) && z(min) && z(sec) && z(msec)) ? "hour" : "hours");
   else if (time->min)
-    sprintf(buf,  "%u:%02u.%03u %s",
-	    time->min, time->sec, time->msec,
-	    (o(min) && z(sec) && z(msec)) ? "minute" : "minutes");
+    p("%u:%02u.%03u %s",
+      time->min, time->sec, time->msec,
+      (o(min) && z(sec) && z(msec)) ? "minute" : "minutes");
   else
-    sprintf(buf,  "%u.%03u %s",
-	    time->sec, time->msec,
-	    (o(sec) && z(msec)) ? "second" : "seconds");
+    p("%u.%03u %s",
+      time->sec, time->msec,
+      (o(sec) && z(msec)) ? "second" : "seconds");
   
 #undef z
 #undef o
   
-  return buf;
+  return n;
+}
+
+
+#undef p
+
+
+/**
+ * Make a human-readable string of the time created by
+ * `libqwaitclient_qwait_position_parse_time` or `libqwaitclient_qwait_position_diff_time`,
+ * without any allocation
+ * 
+ * @param   time      The time the entry was added to the queue or how long ago that was
+ * @param   detailed  Whether to result should be detailed
+ * @param   buffer    Output buffer for the string, must be at least
+ *                    `LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE` bytes large
+ * @return            The length of the string
+ */
+size_t libqwaitclient_qwait_position_format_time(const _time_, int detailed, char* restrict buffer)
+{
+  if (detailed)
+    return libqwaitclient_qwait_position_detailed_format_time(time, buffer);
+  else
+    return libqwaitclient_qwait_position_coarse_format_time(time, buffer);
 }
 
 
@@ -441,10 +765,11 @@ static char* libqwaitclient_qwait_position_detailed_string_time(const _time_)
  */
 char* libqwaitclient_qwait_position_string_time(const _time_, int detailed)
 {
-  if (detailed)
-    return libqwaitclient_qwait_position_detailed_string_time(time);
-  else
-    return libqwaitclient_qwait_position_coarse_string_time(time);
+  char* buf;
+  if (xmalloc(buf, LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE, char))
+    return NULL;
+  libqwaitclient_qwait_position_format_time(time, detailed, buf);
+  return buf;
 }
 
 
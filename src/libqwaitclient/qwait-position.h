@@ -20,12 +20,42 @@
 
 
 #include "json.h"
+#include "qwait-user-id.h"
+#include "matcher.h"
 
 #define _GNU_SOURCE
+#include <stddef.h>
 #include <time.h>
 #include <stdio.h>
 
 
+/**
+ * Flag for queue entries whose comment
+ * says that they are requests for help
+ */
+#define LIBQWAITCLIENT_QWAIT_POSITION_HELP  1
+
+/**
+ * Flag for queue entries whose comment says
+ * that they are requests for presentation
+ */
+#define LIBQWAITCLIENT_QWAIT_POSITION_PRESENTATION  2
+
+/**
+ * The maximum length of a string made by
+ * `libqwaitclient_qwait_position_format_time`, the
+ * year and the number of days in a time difference
+ * are the only members that are not bounded
+ */
+#define LIBQWAITCLIENT_QWAIT_POSITION_TIME_MAX  (51 + 3 * sizeof(unsigned))
+
+/**
+ * The size of a buffer that can hold any string made by
+ * `libqwaitclient_qwait_position_format_time`, including
+ * the NUL-termination
+ */
+#define LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE  (LIBQWAITCLIENT_QWAIT_POSITION_TIME_MAX + 1)
+
 /**
  * An entry in a queue
  */
@@ -36,6 +66,12 @@ typedef struct libqwaitclient_qwait_position
    */
   char* location;
   
+  /**
+   * The computer room for `location`, `LIBQWAITCLIENT_COMPUTERS_UKNOWN`
+   * unless set by `libqwaitclient_computers_get_rooms`
+   */
+  int room;
+  
   /**
    * Comment left by the student, such as presentation
    * or request for help and which exercise it entry
@@ -43,11 +79,24 @@ typedef struct libqwaitclient_qwait_position
    */
   char* comment;
   
+  /**
+   * `LIBQWAITCLIENT_QWAIT_POSITION_*` flags for the first keyword
+   * in `comment`, set by `libqwaitclient_qwait_position_classify`
+   */
+  int flags;
+  
+  /**
+   * The first number in `comment`, which usually is the number of the
+   * exercise, -1 if none, set by `libqwaitclient_qwait_position_classify`
+   */
+  int exercise;
+  
   /**
    * The user ID, that unreadable 8-character [0-9a-z]
-   * string starting with "u1"
+   * string starting with "u1", in packed form,
+   * `LIBQWAITCLIENT_QWAIT_USER_ID_NONE` if unknown
    */
-  char* user_id;
+  libqwaitclient_qwait_user_id_t user_id;
   
   /**
    * The student's real name
@@ -189,10 +238,20 @@ void libqwaitclient_qwait_position_destroy(_this_);
  * Contextually parses parsed JSON data into a queue entry
  * 
  * @param   this  The queue entry to fill in
- * @param   data  The data to parse
+ * @param   data  The data to parse, strings are taken out of it
  * @return        Zero on success, -1 on error
  */
-int libqwaitclient_qwait_position_parse(_this_, const libqwaitclient_json_t* restrict data);
+int libqwaitclient_qwait_position_parse(_this_, libqwaitclient_json_t* restrict data);
+
+/**
+ * Get the user ID of a queue entry as a string
+ * 
+ * @param   this    The queue entry
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, `NULL` if the user ID is unknown
+ */
+char* libqwaitclient_qwait_position_get_user_id(const _this_, char* restrict buffer);
 
 /**
  * Compares the time of entry for two queue entries
@@ -203,6 +262,45 @@ int libqwaitclient_qwait_position_parse(_this_, const libqwaitclient_json_t* res
  */
 int libqwaitclient_qwait_position_compare_by_time(const void* a, const void* b) __attribute__((pure));
 
+/**
+ * Classify a queue entry by its comment, this is done
+ * when the entry is parsed, with the default keywords
+ * 
+ * The keyword that occurs first in the comment decides the
+ * flags, so "Redovisa, behöver hjälp" is a presentation
+ * 
+ * The default keywords are "help", "hjälp" and "hjalp" for
+ * `LIBQWAITCLIENT_QWAIT_POSITION_HELP`, and "present" and
+ * "redovis" for `LIBQWAITCLIENT_QWAIT_POSITION_PRESENTATION`,
+ * runs of repeated letters are squeezed, so "heeelp" matches
+ * 
+ * @param  this      The queue entry
+ * @param  keywords  Matcher with `LIBQWAITCLIENT_QWAIT_POSITION_*` flags as the
+ *                   values of the keywords, `NULL` for the default keywords
+ */
+void libqwaitclient_qwait_position_classify(_this_, const libqwaitclient_matcher_t* restrict keywords);
+
+/**
+ * Classify a set of queue entries by their comments
+ * 
+ * @param  positions  The queue entries
+ * @param  count      The number of elements in `positions`
+ * @param  keywords   Matcher with `LIBQWAITCLIENT_QWAIT_POSITION_*` flags as the
+ *                    values of the keywords, `NULL` for the default keywords
+ */
+void libqwaitclient_qwait_position_classify_all(libqwaitclient_qwait_position_t* restrict positions, size_t count,
+						const libqwaitclient_matcher_t* restrict keywords);
+
+/**
+ * Check whether a queue entry is a request for help,
+ * rather than for presentation, by looking at the
+ * flags it was classified with
+ * 
+ * @param   this  The queue entry
+ * @return        1 if the entry is a request for help, 0 otherwise
+ */
+int libqwaitclient_qwait_position_is_help(const _this_) __attribute__((pure));
+
 /**
  * Print a queue entry to a file for debugging
  * 
@@ -221,6 +319,25 @@ void libqwaitclient_qwait_position_dump(const _this_, FILE* output);
  */
 int libqwaitclient_qwait_position_parse_time(const _this_, _time_, int local);
 
+/**
+ * Get the time a set of entries were added to their queue
+ * 
+ * The local timezone is only resolved once, and then checked
+ * once per week that the entries span, rather than resolved
+ * once per entry; the timezone is assumed to change at most
+ * once a week, if it changes more often than that, and back,
+ * entries in between may be given the wrong timezone
+ * 
+ * @param   positions  The queue entries
+ * @param   count      The number of elements in `positions`
+ * @param   times      Output parameter for when the entries were added to the queue,
+ *                     must have room for `count` elements
+ * @param   local      Whether to return in local time rather than UTC
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_position_parse_times(const libqwaitclient_qwait_position_t* restrict positions, size_t count,
+					      libqwaitclient_qwait_position_time_t* restrict times, int local);
+
 /**
  * Calculate how long ago a entry was added to its queue
  * 
@@ -231,6 +348,36 @@ int libqwaitclient_qwait_position_parse_time(const _this_, _time_, int local);
  */
 int libqwaitclient_qwait_position_diff_time(const _this_, _time_, const struct timespec* restrict now);
 
+/**
+ * Calculate how long ago a set of entries were added to their queue
+ * 
+ * The current time is read and rounded once, rather than
+ * once per entry, no timezone is involved in the differences
+ * 
+ * @param   positions  The queue entries
+ * @param   count      The number of elements in `positions`
+ * @param   times      Output parameter for how long ago the entries were added to the queue,
+ *                     must have room for `count` elements
+ * @param   now        Please set to `&t` where `t` is set by `clock_gettime(CLOCK_REALTIME, &t)`
+ * @return             Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_position_diff_times(const libqwaitclient_qwait_position_t* restrict positions, size_t count,
+					     libqwaitclient_qwait_position_time_t* restrict times,
+					     const struct timespec* restrict now);
+
+/**
+ * Make a human-readable string of the time created by
+ * `libqwaitclient_qwait_position_parse_time` or `libqwaitclient_qwait_position_diff_time`,
+ * without any allocation
+ * 
+ * @param   time      The time the entry was added to the queue or how long ago that was
+ * @param   detailed  Whether to result should be detailed
+ * @param   buffer    Output buffer for the string, must be at least
+ *                    `LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE` bytes large
+ * @return            The length of the string
+ */
+size_t libqwaitclient_qwait_position_format_time(const _time_, int detailed, char* restrict buffer);
+
 /**
  * Make a human-readable string of the time created by
  * `libqwaitclient_qwait_position_parse_time` or `libqwaitclient_qwait_position_diff_time`
@@ -19,6 +19,7 @@
 
 #include "macros.h"
 #include "json.h"
+#include "json-tape.h"
 
 #include <errno.h>
 #include <string.h>
@@ -236,6 +237,54 @@ libqwaitclient_qwait_queue_t* libqwaitclient_qwait_get_queues(_sock_, size_t* re
 }
 
 
+/**
+ * Get summarised information on all queues, the entries
+ * in the queues are counted but not retrieved, making
+ * this much cheaper than `libqwaitclient_qwait_get_queues`
+ * 
+ * @param   sock         The socket used to remote communication
+ * @param   queue_count  Output parameter for the number of returned queues
+ * @return               Information for all queues, `NULL` on error
+ */
+libqwaitclient_qwait_queue_t* libqwaitclient_qwait_get_queue_summaries(_sock_, size_t* restrict queue_count)
+{
+  libqwaitclient_qwait_queue_t* restrict rc = NULL;
+  libqwaitclient_http_message_t mesg;
+  libqwaitclient_json_tape_t tape;
+  size_t i, n = 0, queue;
+  
+  initialise(&mesg, NULL);
+  libqwaitclient_json_tape_initialise(&tape);
+  
+  t (mkstr(mesg.top, "GET /api/queues HTTP/1.1"));
+  t (protocol_query(sock, &mesg, NULL, NULL));
+  
+  /* Only index the response, the queues' members are decoded
+     when they are read, and their entries are never decoded.
+     Only the queues are indexed, anything nested in a queue is
+     skipped over without building entries for its contents. */
+  t (libqwaitclient_json_tape_build_shallow(&tape, sock->message.content, sock->message.content_size, 2));
+  if (tape.entries->type != LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+    {
+      errno = EBADMSG;
+      goto fail;
+    }
+  n = tape.entries->count;
+  t (xcalloc(rc, max(n, 1), libqwaitclient_qwait_queue_t)); /* `max(n, 1)`: do not return `NULL`. */
+  for (i = 0, queue = 1; i < n; i++, queue = tape.entries[queue].next)
+    t (libqwaitclient_qwait_queue_parse_summary(rc + i, &tape, queue));
+  
+  return libqwaitclient_json_tape_destroy(&tape), destroy(&mesg, NULL), *queue_count = n, rc;
+ fail:
+  libqwaitclient_json_tape_destroy(&tape);
+  if (rc != NULL)
+    for (i = 0; i < n; i++)
+      libqwaitclient_qwait_queue_destroy(rc + i);
+  free(rc);
+  return protocol_failure(sock, &mesg, NULL), *queue_count = 0, NULL;
+}
+
+
 /**
  * Get complete information on a queue
  * 
@@ -45,6 +45,17 @@
  */
 libqwaitclient_qwait_queue_t* libqwaitclient_qwait_get_queues(_sock_, size_t* restrict queue_count);
 
+/**
+ * Get summarised information on all queues, the entries
+ * in the queues are counted but not retrieved, making
+ * this much cheaper than `libqwaitclient_qwait_get_queues`
+ * 
+ * @param   sock         The socket used to remote communication
+ * @param   queue_count  Output parameter for the number of returned queues
+ * @return               Information for all queues, `NULL` on error
+ */
+libqwaitclient_qwait_queue_t* libqwaitclient_qwait_get_queue_summaries(_sock_, size_t* restrict queue_count);
+
 /**
  * Get complete information on a queue
  * 
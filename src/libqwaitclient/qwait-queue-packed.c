@@ -0,0 +1,547 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qwait-queue-packed.h"
+
+#include "macros.h"
+#include "computers.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_qwait_queue_packed_t* restrict this
+
+
+
+/**
+ * Get an address in a packed queue
+ * 
+ * @param   this:const libqwaitclient_qwait_queue_packed_t*  The packed queue
+ * @param   offset:uint32_t                                   The offset from the start of the queue
+ * @return  :const void*                                      The address
+ */
+#define at(this, offset)  \
+  ((const void*)((const char*)(this) + (offset)))
+
+
+/**
+ * Check whether a user ID is stored out of line
+ * 
+ * @param   id:libqwaitclient_qwait_user_id_t  The user ID
+ * @return  :int                               Whether the user ID is stored out of line
+ */
+#define overflown(id)  \
+  (((id) >> 56) == LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW)
+
+/**
+ * Get the offset of the string of a user ID that is stored out of line
+ * 
+ * @param   id:libqwaitclient_qwait_user_id_t  The user ID, as stored in the packed queue
+ * @return  :uint64_t                          The offset of the user ID's string
+ */
+#define overflow_offset(id)  \
+  ((id) & ((UINT64_C(1) << 56) - 1))
+
+
+
+/**
+ * Copy a string into a packed queue that is being built
+ * 
+ * @param   data    The packed queue
+ * @param   offset  The offset where the string shall be stored, will be moved past it
+ * @param   string  The string, may be `NULL`
+ * @return          The offset of the string, `LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL` if `NULL`
+ */
+static uint32_t libqwaitclient_qwait_queue_packed_put(char* restrict data, size_t* restrict offset,
+						      const char* restrict string)
+{
+  size_t rc = *offset;
+  if (string == NULL)
+    return LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL;
+  *offset = (size_t)(stpcpy(data + rc, string) + 1 - data);
+  return (uint32_t)rc;
+}
+
+
+/**
+ * Copy a user ID into a packed queue that is being built
+ * 
+ * @param   data    The packed queue
+ * @param   offset  The offset where the string of the user ID shall be stored
+ *                  if it is stored out of line, will be moved past it
+ * @param   id      The user ID
+ * @return          The user ID as stored in the packed queue
+ */
+static libqwaitclient_qwait_user_id_t libqwaitclient_qwait_queue_packed_put_id(char* restrict data, size_t* restrict offset,
+									   libqwaitclient_qwait_user_id_t id)
+{
+  char buffer[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  const char* string;
+  if (!overflown(id))
+    return id;
+  string = libqwaitclient_qwait_user_id_format(id, buffer);
+  return ((libqwaitclient_qwait_user_id_t)LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW << 56) |
+	 libqwaitclient_qwait_queue_packed_put(data, offset, string);
+}
+
+
+/**
+ * Get the space a user ID needs in the string area of a packed queue
+ * 
+ * @param   id  The user ID
+ * @return      The size of its string if it is stored out of line, otherwise zero
+ */
+static size_t libqwaitclient_qwait_queue_packed_id_size(libqwaitclient_qwait_user_id_t id)
+{
+  char buffer[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  return overflown(id) ? strlen(libqwaitclient_qwait_user_id_format(id, buffer)) + 1 : 0;
+}
+
+
+/**
+ * Sort a list of user ID:s, if it is not already sorted
+ * 
+ * @param  ids    The user ID:s
+ * @param  count  The number of elements in `ids`
+ */
+static void libqwaitclient_qwait_queue_packed_sort_ids(libqwaitclient_qwait_user_id_t* restrict ids, size_t count)
+{
+  size_t i;
+  for (i = 1; i < count; i++)
+    if (ids[i - 1] > ids[i])
+      {
+	qsort(ids, count, sizeof(libqwaitclient_qwait_user_id_t), libqwaitclient_qwait_user_id_compare);
+	return;
+      }
+}
+
+
+/**
+ * Pack a queue into a single allocation
+ * 
+ * The collation key of the title is not packed
+ * 
+ * @param   queue  The queue
+ * @return         The packed queue, `NULL` on error, free with `free`
+ */
+libqwaitclient_qwait_queue_packed_t* libqwaitclient_qwait_queue_packed_pack(const libqwaitclient_qwait_queue_t* restrict queue)
+{
+  libqwaitclient_qwait_queue_packed_t* restrict this = NULL;
+  libqwaitclient_qwait_queue_packed_position_t* restrict packed;
+  libqwaitclient_qwait_user_id_t* restrict owners;
+  libqwaitclient_qwait_user_id_t* restrict moderators;
+  const libqwaitclient_qwait_position_t* restrict pos;
+  size_t i, n = queue->positions == NULL ? 0 : queue->position_count;
+  size_t size, offset;
+  char* data;
+
+#define len(string)  ((string) == NULL ? 0 : strlen(string) + 1)
+#define put(string)  libqwaitclient_qwait_queue_packed_put(data, &offset, string)
+#define put_id(id)   libqwaitclient_qwait_queue_packed_put_id(data, &offset, id)
+
+  /* Measure the block so that it is allocated once, the arrays are
+     placed first, all their elements are multiples of 8 bytes large,
+     so they, and the block itself, stay aligned. */
+  if ((queue->owner_count | queue->moderator_count | queue->position_count) > UINT32_MAX)
+    return errno = EOVERFLOW, NULL;
+  size  = sizeof(libqwaitclient_qwait_queue_packed_t);
+  size += (queue->owner_count + queue->moderator_count) * sizeof(libqwaitclient_qwait_user_id_t);
+  size += n * sizeof(libqwaitclient_qwait_queue_packed_position_t);
+  size += len(queue->name) + len(queue->title);
+  for (i = 0; i < queue->owner_count; i++)
+    size += libqwaitclient_qwait_queue_packed_id_size(queue->owners[i]);
+  for (i = 0; i < queue->moderator_count; i++)
+    size += libqwaitclient_qwait_queue_packed_id_size(queue->moderators[i]);
+  for (i = 0; i < n; i++)
+    {
+      pos = queue->positions + i;
+      size += len(pos->real_name) + len(pos->location) + len(pos->comment);
+      size += libqwaitclient_qwait_queue_packed_id_size(pos->user_id);
+    }
+  if (size >= UINT32_MAX)
+    return errno = EOVERFLOW, NULL;
+  
+  /* Zero the block so that the padding is deterministic. */
+  if (xcalloc(data, size, char))
+    return NULL;
+  this = (libqwaitclient_qwait_queue_packed_t*)(void*)data;
+  
+  this->magic           = LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_MAGIC;
+  this->size            = (uint32_t)size;
+  this->flags           = (queue->hidden ? LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_HIDDEN : 0) |
+			  (queue->locked ? LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_LOCKED : 0);
+  this->owner_count     = (uint32_t)(queue->owner_count);
+  this->moderator_count = (uint32_t)(queue->moderator_count);
+  this->position_count  = (uint32_t)(queue->position_count);
+  
+  /* Lay out the arrays. */
+  offset = sizeof(libqwaitclient_qwait_queue_packed_t);
+  this->owners = (uint32_t)offset;
+  owners = (libqwaitclient_qwait_user_id_t*)(void*)(data + offset);
+  offset += queue->owner_count * sizeof(libqwaitclient_qwait_user_id_t);
+  this->moderators = (uint32_t)offset;
+  moderators = (libqwaitclient_qwait_user_id_t*)(void*)(data + offset);
+  offset += queue->moderator_count * sizeof(libqwaitclient_qwait_user_id_t);
+  this->positions = queue->positions == NULL ? LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL : (uint32_t)offset;
+  packed = (libqwaitclient_qwait_queue_packed_position_t*)(void*)(data + offset);
+  offset += n * sizeof(libqwaitclient_qwait_queue_packed_position_t);
+  
+  /* Copy the admins, user ID:s that are stored out of line get
+     other values, so they are sorted again to stay verifiable. */
+  for (i = 0; i < queue->owner_count; i++)
+    owners[i] = put_id(queue->owners[i]);
+  for (i = 0; i < queue->moderator_count; i++)
+    moderators[i] = put_id(queue->moderators[i]);
+  libqwaitclient_qwait_queue_packed_sort_ids(owners, queue->owner_count);
+  libqwaitclient_qwait_queue_packed_sort_ids(moderators, queue->moderator_count);
+  
+  /* Copy the strings. */
+  this->name  = put(queue->name);
+  this->title = put(queue->title);
+  for (i = 0; i < n; i++)
+    {
+      pos = queue->positions + i;
+      packed[i].enter_time_seconds  = (int64_t)(pos->enter_time_seconds);
+      packed[i].enter_time_mseconds = (int32_t)(pos->enter_time_mseconds);
+      packed[i].user_id             = put_id(pos->user_id);
+      packed[i].real_name           = put(pos->real_name);
+      packed[i].location            = put(pos->location);
+      packed[i].comment             = put(pos->comment);
+    }
+
+#undef put_id
+#undef put
+#undef len
+
+  return this;
+}
+
+
+/**
+ * Check that a string in a packed queue is within the queue
+ * 
+ * @param   data      The packed queue
+ * @param   size      The size of the packed queue
+ * @param   offset    The offset of the string
+ * @param   nullable  Whether the string may be `NULL`
+ * @return            Whether the string is well-formed
+ */
+static int __attribute__((pure)) libqwaitclient_qwait_queue_packed_verify_string(const char* restrict data, size_t size,
+										  uint32_t offset, int nullable)
+{
+  if (offset == LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL)
+    return nullable;
+  return (offset < size) && (memchr(data + offset, '\0', size - offset) != NULL);
+}
+
+
+/**
+ * Check that an array in a packed queue is within the queue
+ * 
+ * @param   size       The size of the packed queue
+ * @param   offset     The offset of the array
+ * @param   count      The number of elements in the array
+ * @param   elem_size  The size of each element in the array
+ * @return             Whether the array is well-formed
+ */
+static int __attribute__((const)) libqwaitclient_qwait_queue_packed_verify_array(size_t size, uint32_t offset,
+										  uint32_t count, size_t elem_size)
+{
+  if ((offset % 8) || (offset < sizeof(libqwaitclient_qwait_queue_packed_t)) || (offset > size))
+    return 0;
+  return (size_t)count <= (size - offset) / elem_size;
+}
+
+
+/**
+ * Check that a list of user ID:s in a packed queue is sorted, and
+ * that user ID:s that are stored out of line refer to strings
+ * 
+ * @param   data   The packed queue
+ * @param   size   The size of the packed queue
+ * @param   ids    The user ID:s
+ * @param   count  The number of elements in `ids`
+ * @return         Whether the list is well-formed
+ */
+static int __attribute__((pure)) libqwaitclient_qwait_queue_packed_verify_ids(const char* restrict data, size_t size,
+									       const libqwaitclient_qwait_user_id_t* restrict ids,
+									       size_t count)
+{
+  size_t i;
+  for (i = 0; i < count; i++)
+    {
+      if (i && (ids[i - 1] > ids[i]))
+	return 0;
+      if (overflown(ids[i]) && ((overflow_offset(ids[i]) >= size) ||
+				!libqwaitclient_qwait_queue_packed_verify_string(data, size, (uint32_t)overflow_offset(ids[i]), 0)))
+	return 0;
+    }
+  return 1;
+}
+
+
+/**
+ * Check that a block of memory, for example one that was read
+ * from a file, is a well-formed packed queue, so that it can
+ * be used without any further bounds checking, this includes
+ * checking that the owners and moderators are sorted
+ * 
+ * @param   data  The block, must be aligned for `int64_t`
+ * @param   size  The size of the block
+ * @return        Zero if well-formed, -1 with `errno` set to `EINVAL` otherwise
+ */
+int libqwaitclient_qwait_queue_packed_verify(const void* restrict data, size_t size)
+{
+  const libqwaitclient_qwait_queue_packed_t* restrict this = data;
+  const libqwaitclient_qwait_queue_packed_position_t* restrict pos;
+  const char* restrict chars = data;
+  size_t i, n;
+
+#define string(offset, nullable)  \
+  libqwaitclient_qwait_queue_packed_verify_string(chars, size, offset, nullable)
+#define array(offset, count, type)  \
+  libqwaitclient_qwait_queue_packed_verify_array(size, offset, count, sizeof(type))
+#define ids(offset, count)  \
+  libqwaitclient_qwait_queue_packed_verify_ids(chars, size, at(this, offset), count)
+  
+  if (size < sizeof(libqwaitclient_qwait_queue_packed_t))      goto einval;
+  if (this->magic != LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_MAGIC)  goto einval;
+  if ((this->size != size) || this->reserved)                  goto einval;
+  if (this->flags & ~(uint32_t)(LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_HIDDEN |
+				LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_LOCKED))
+    goto einval;
+  
+  if (!string(this->name, 0) || !string(this->title, 0))                         goto einval;
+  if (!array(this->owners, this->owner_count, libqwaitclient_qwait_user_id_t))          goto einval;
+  if (!array(this->moderators, this->moderator_count, libqwaitclient_qwait_user_id_t))  goto einval;
+  if (!ids(this->owners, this->owner_count))                                            goto einval;
+  if (!ids(this->moderators, this->moderator_count))                                    goto einval;
+  
+  if (this->positions == LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL)
+    goto done;
+  if (!array(this->positions, this->position_count, libqwaitclient_qwait_queue_packed_position_t))
+    goto einval;
+  pos = at(this, this->positions);
+  for (i = 0, n = this->position_count; i < n; i++, pos++)
+    if (!string(pos->real_name, 1) || !string(pos->location, 1) || !string(pos->comment, 1) ||
+	!libqwaitclient_qwait_queue_packed_verify_ids(chars, size, &(pos->user_id), 1) ||
+	(pos->enter_time_mseconds < 0) || (pos->enter_time_mseconds > 999))
+      goto einval;
+
+#undef ids
+#undef array
+#undef string
+
+ done:
+  return 0;
+ einval:
+  return errno = EINVAL, -1;
+}
+
+
+/**
+ * Duplicate a string from a packed queue
+ * 
+ * @param   this    The packed queue
+ * @param   offset  The offset of the string
+ * @param   string  Output parameter for the string, `NULL` for `LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL`
+ * @return          Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_queue_packed_strdup(const _this_, uint32_t offset, char** restrict string)
+{
+  if (offset == LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL)
+    return *string = NULL, 0;
+  return (*string = strdup(at(this, offset))) == NULL ? -1 : 0;
+}
+
+
+/**
+ * Unpack a list of user ID:s from a packed queue
+ * 
+ * @param   this   The packed queue
+ * @param   ids    The user ID:s, as stored in the packed queue, will be unpacked in place
+ * @param   count  The number of elements in `ids`
+ * @return         Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_queue_packed_unpack_ids(const _this_, libqwaitclient_qwait_user_id_t* restrict ids,
+							size_t count)
+{
+  const char* string;
+  size_t i;
+  for (i = 0; i < count; i++)
+    if (overflown(ids[i]))
+      {
+	string = at(this, overflow_offset(ids[i]));
+	if (libqwaitclient_qwait_user_id_parse(ids + i, string, strlen(string)) < 0)
+	  return -1;
+      }
+  return 0;
+}
+
+
+/**
+ * Unpack a packed queue
+ * 
+ * The entries are classified and their computer rooms are looked up
+ * 
+ * @param   this   The packed queue
+ * @param   queue  The queue to fill in, the queue owns all its strings
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_queue_packed_unpack(const _this_, libqwaitclient_qwait_queue_t* restrict queue)
+{
+  const libqwaitclient_qwait_queue_packed_position_t* restrict packed;
+  libqwaitclient_qwait_position_t* restrict pos;
+  size_t i, n;
+  int saved_errno;
+  
+  libqwaitclient_qwait_queue_initialise(queue);
+  queue->hidden          = (this->flags & LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_HIDDEN) ? 1 : 0;
+  queue->locked          = (this->flags & LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_LOCKED) ? 1 : 0;
+  queue->position_count  = this->position_count;
+  
+  if (libqwaitclient_qwait_queue_packed_strdup(this, this->name,  &(queue->name)))   goto fail;
+  if (libqwaitclient_qwait_queue_packed_strdup(this, this->title, &(queue->title)))  goto fail;
+  
+  if ((n = this->owner_count))
+    {
+      if (xmalloc(queue->owners, n, libqwaitclient_qwait_user_id_t))
+	goto fail;
+      memcpy(queue->owners, at(this, this->owners), n * sizeof(libqwaitclient_qwait_user_id_t));
+      queue->owner_count = n;
+      if (libqwaitclient_qwait_queue_packed_unpack_ids(this, queue->owners, n))
+	goto fail;
+      libqwaitclient_qwait_queue_packed_sort_ids(queue->owners, n);
+    }
+  
+  if ((n = this->moderator_count))
+    {
+      if (xmalloc(queue->moderators, n, libqwaitclient_qwait_user_id_t))
+	goto fail;
+      memcpy(queue->moderators, at(this, this->moderators), n * sizeof(libqwaitclient_qwait_user_id_t));
+      queue->moderator_count = n;
+      if (libqwaitclient_qwait_queue_packed_unpack_ids(this, queue->moderators, n))
+	goto fail;
+      libqwaitclient_qwait_queue_packed_sort_ids(queue->moderators, n);
+    }
+  
+  if (this->positions == LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL)
+    return 0;
+  
+  /* Zeroed, so that a partially unpacked queue can be destroyed. */
+  if (xcalloc(queue->positions, (n = this->position_count) ? n : 1, libqwaitclient_qwait_position_t))
+    goto fail;
+  packed = at(this, this->positions);
+  for (i = 0; i < n; i++)
+    {
+      pos = queue->positions + i;
+      pos->enter_time_seconds  = (time_t)(packed[i].enter_time_seconds);
+      pos->enter_time_mseconds = (int)(packed[i].enter_time_mseconds);
+      pos->user_id             = packed[i].user_id;
+      if (libqwaitclient_qwait_queue_packed_unpack_ids(this, &(pos->user_id), 1))                  goto fail;
+      if (libqwaitclient_qwait_queue_packed_strdup(this, packed[i].real_name, &(pos->real_name)))  goto fail;
+      if (libqwaitclient_qwait_queue_packed_strdup(this, packed[i].location,  &(pos->location)))   goto fail;
+      if (libqwaitclient_qwait_queue_packed_strdup(this, packed[i].comment,   &(pos->comment)))    goto fail;
+      libqwaitclient_qwait_position_classify(pos, NULL);
+      pos->room = libqwaitclient_computers_get_room(pos->location);
+    }
+  
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  libqwaitclient_qwait_queue_destroy(queue);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Get a string from a packed queue
+ * 
+ * @param   this    The packed queue
+ * @param   offset  The offset of the string
+ * @return          The string, `NULL` if `offset` is `LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL`
+ */
+const char* libqwaitclient_qwait_queue_packed_string(const _this_, uint32_t offset)
+{
+  return offset == LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL ? NULL : at(this, offset);
+}
+
+
+/**
+ * Get the list of queue owners in a packed queue
+ * 
+ * @param   this  The packed queue
+ * @return        The list of queue owners, sorted in ascending order
+ *                of their packed values
+ */
+const libqwaitclient_qwait_user_id_t* libqwaitclient_qwait_queue_packed_owners(const _this_)
+{
+  return at(this, this->owners);
+}
+
+
+/**
+ * Get the list of queue moderators in a packed queue
+ * 
+ * @param   this  The packed queue
+ * @return        The list of queue moderators, sorted in ascending order
+ *                of their packed values
+ */
+const libqwaitclient_qwait_user_id_t* libqwaitclient_qwait_queue_packed_moderators(const _this_)
+{
+  return at(this, this->moderators);
+}
+
+
+/**
+ * Get the entries in a packed queue
+ * 
+ * @param   this  The packed queue
+ * @return        The entries in the queue, `NULL` if the queue was parsed as a summary
+ */
+const libqwaitclient_qwait_queue_packed_position_t* libqwaitclient_qwait_queue_packed_positions(const _this_)
+{
+  return this->positions == LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL ? NULL : at(this, this->positions);
+}
+
+
+/**
+ * Get a user ID from a packed queue as a string
+ * 
+ * @param   this    The packed queue
+ * @param   id      The user ID, as stored in the packed queue
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, or the string in the packed queue if the user ID is
+ *                  stored out of line, `NULL` if `id` is `LIBQWAITCLIENT_QWAIT_USER_ID_NONE`
+ */
+const char* libqwaitclient_qwait_queue_packed_user_id(const _this_, libqwaitclient_qwait_user_id_t id, char* restrict buffer)
+{
+  if (overflown(id))
+    return at(this, overflow_offset(id));
+  return libqwaitclient_qwait_user_id_format(id, buffer);
+}
+
+
+#undef overflow_offset
+#undef overflown
+#undef at
+#undef _this_
+
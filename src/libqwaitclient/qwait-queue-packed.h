@@ -0,0 +1,265 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_H
+#define LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_H
+
+
+#include "qwait-queue.h"
+#include "qwait-user-id.h"
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * The value of `magic` in a packed queue
+ */
+#define LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_MAGIC  UINT32_C(0x51574b31)
+
+/**
+ * The offset used for strings and arrays that are `NULL`
+ */
+#define LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL  UINT32_MAX
+
+/**
+ * Flag for hidden queues
+ */
+#define LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_HIDDEN  1
+
+/**
+ * Flag for locked queues
+ */
+#define LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_LOCKED  2
+
+
+
+/**
+ * A queue entry in a packed queue, strings are
+ * stored as offsets from the start of the queue
+ */
+typedef struct libqwaitclient_qwait_queue_packed_position
+{
+  /**
+   * The wall-clock time the entry was added to the
+   * queue, the whole seconds since the epoch
+   */
+  int64_t enter_time_seconds;
+  
+  /**
+   * The user's ID
+   */
+  libqwaitclient_qwait_user_id_t user_id;
+  
+  /**
+   * The offset of the user's real name
+   */
+  uint32_t real_name;
+  
+  /**
+   * The offset of the user's location
+   */
+  uint32_t location;
+  
+  /**
+   * The offset of the user's comment
+   */
+  uint32_t comment;
+  
+  /**
+   * The milliseconds of the wall-clock time
+   * the entry was added to the queue
+   */
+  int32_t enter_time_mseconds;
+  
+} libqwaitclient_qwait_queue_packed_position_t;
+
+
+/**
+ * A queue, with all its arrays and strings, in a single
+ * contiguous block that starts with this structure
+ * 
+ * Everything is referenced by its offset from the start
+ * of the block rather than by a pointer, so the block can
+ * be copied with `memcpy`, written to a file or put in
+ * shared memory, and it is freed with a single `free`.
+ * Numbers are stored in host byte order.
+ * 
+ * User ID:s that are stored out of line, see
+ * `LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW`, are stored as
+ * that byte followed by the offset of the user ID's string,
+ * use `libqwaitclient_qwait_queue_packed_user_id` to get
+ * any user ID as a string.
+ */
+typedef struct libqwaitclient_qwait_queue_packed
+{
+  /**
+   * `LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_MAGIC`
+   */
+  uint32_t magic;
+  
+  /**
+   * The size of the entire block
+   */
+  uint32_t size;
+  
+  /**
+   * `LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_*` flags for the queue
+   */
+  uint32_t flags;
+  
+  /**
+   * The offset of the queue's ID
+   */
+  uint32_t name;
+  
+  /**
+   * The offset of the queue's name
+   */
+  uint32_t title;
+  
+  /**
+   * The offset of the list of queue owners
+   */
+  uint32_t owners;
+  
+  /**
+   * The number of queue owners
+   */
+  uint32_t owner_count;
+  
+  /**
+   * The offset of the list of queue moderators
+   */
+  uint32_t moderators;
+  
+  /**
+   * The number of queue moderators
+   */
+  uint32_t moderator_count;
+  
+  /**
+   * The offset of the entries in the queue,
+   * `LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL`
+   * if the queue was parsed as a summary
+   */
+  uint32_t positions;
+  
+  /**
+   * The number of entries in the queue
+   */
+  uint32_t position_count;
+  
+  /**
+   * Always zero
+   */
+  uint32_t reserved;
+  
+} libqwaitclient_qwait_queue_packed_t;
+
+
+
+#define _this_  libqwaitclient_qwait_queue_packed_t* restrict this
+
+
+/**
+ * Pack a queue into a single allocation
+ * 
+ * The collation key of the title is not packed
+ * 
+ * @param   queue  The queue
+ * @return         The packed queue, `NULL` on error, free with `free`
+ */
+libqwaitclient_qwait_queue_packed_t* libqwaitclient_qwait_queue_packed_pack(const libqwaitclient_qwait_queue_t* restrict queue);
+
+/**
+ * Check that a block of memory, for example one that was read
+ * from a file, is a well-formed packed queue, so that it can
+ * be used without any further bounds checking, this includes
+ * checking that the owners and moderators are sorted
+ * 
+ * @param   data  The block, must be aligned for `int64_t`
+ * @param   size  The size of the block
+ * @return        Zero if well-formed, -1 with `errno` set to `EINVAL` otherwise
+ */
+int libqwaitclient_qwait_queue_packed_verify(const void* restrict data, size_t size);
+
+/**
+ * Unpack a packed queue
+ * 
+ * The entries are classified and their computer rooms are looked up
+ * 
+ * @param   this   The packed queue
+ * @param   queue  The queue to fill in, the queue owns all its strings
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_queue_packed_unpack(const _this_, libqwaitclient_qwait_queue_t* restrict queue);
+
+/**
+ * Get a string from a packed queue
+ * 
+ * @param   this    The packed queue
+ * @param   offset  The offset of the string
+ * @return          The string, `NULL` if `offset` is `LIBQWAITCLIENT_QWAIT_QUEUE_PACKED_NULL`
+ */
+const char* libqwaitclient_qwait_queue_packed_string(const _this_, uint32_t offset) __attribute__((const));
+
+/**
+ * Get the list of queue owners in a packed queue
+ * 
+ * @param   this  The packed queue
+ * @return        The list of queue owners, sorted in ascending order
+ *                of their packed values
+ */
+const libqwaitclient_qwait_user_id_t* libqwaitclient_qwait_queue_packed_owners(const _this_) __attribute__((pure));
+
+/**
+ * Get the list of queue moderators in a packed queue
+ * 
+ * @param   this  The packed queue
+ * @return        The list of queue moderators, sorted in ascending order
+ *                of their packed values
+ */
+const libqwaitclient_qwait_user_id_t* libqwaitclient_qwait_queue_packed_moderators(const _this_) __attribute__((pure));
+
+/**
+ * Get the entries in a packed queue
+ * 
+ * @param   this  The packed queue
+ * @return        The entries in the queue, `NULL` if the queue was parsed as a summary
+ */
+const libqwaitclient_qwait_queue_packed_position_t* libqwaitclient_qwait_queue_packed_positions(const _this_) __attribute__((pure));
+
+/**
+ * Get a user ID from a packed queue as a string
+ * 
+ * @param   this    The packed queue
+ * @param   id      The user ID, as stored in the packed queue
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, or the string in the packed queue if the user ID is
+ *                  stored out of line, `NULL` if `id` is `LIBQWAITCLIENT_QWAIT_USER_ID_NONE`
+ */
+const char* libqwaitclient_qwait_queue_packed_user_id(const _this_, libqwaitclient_qwait_user_id_t id, char* restrict buffer);
+
+
+#undef _this_
+
+
+#endif
+
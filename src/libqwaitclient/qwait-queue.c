@@ -18,16 +18,221 @@
 #include "qwait-queue.h"
 
 #include "macros.h"
+#include "json-schema.h"
 
+#include <stddef.h>
 #include <string.h>
 #include <strings.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 
 
 #define _this_  libqwaitclient_qwait_queue_t* restrict this
 
 
+/**
+ * Index of `positions` in the deferred members
+ */
+#define POSITIONS  0
+
+
+#define F(name, type, member, aux)					\
+  LIBQWAITCLIENT_JSON_FIELD(name, LIBQWAITCLIENT_JSON_FIELD_##type, 1,	\
+			    offsetof(libqwaitclient_qwait_queue_t, member),	\
+			    offsetof(libqwaitclient_qwait_queue_t, aux))
+
+/**
+ * The members of a queue
+ */
+static const libqwaitclient_json_field_t fields[] =
+  {
+    F("name",       STRING,  name,       name),
+    F("title",      STRING,  title,      title),
+    F("hidden",     BOOLEAN, hidden,     hidden),
+    F("locked",     BOOLEAN, locked,     locked),
+    F("owners",     USER_IDS, owners,     owner_count),
+    F("moderators", USER_IDS, moderators, moderator_count),
+    LIBQWAITCLIENT_JSON_FIELD("positions", LIBQWAITCLIENT_JSON_FIELD_DEFERRED, 1, POSITIONS, 0),
+  };
+
+#undef F
+
+
+/**
+ * Collation key bytes for the Latin-1 letters, that is,
+ * U+00C0 to U+00FF, which are encoded as 0xC3 followed
+ * by 0x80 to 0xBF in UTF-8; 'å', 'ä' and 'ö' (and 'æ'
+ * and 'ø') are placed after 'z', letters with other
+ * diacritics are sorted as the letter without them,
+ * and zero is used for characters that are kept as is
+ */
+static const char latin1_keys[64] =
+  {
+    'a',    'a',    'a',    'a',    '\x81', '\x80', '\x81', 'c',
+    'e',    'e',    'e',    'e',    'i',    'i',    'i',    'i',
+    'd',    'n',    'o',    'o',    'o',    'o',    '\x82', 0,
+    '\x82', 'u',    'u',    'u',    'y',    'y',    0,      0,
+    'a',    'a',    'a',    'a',    '\x81', '\x80', '\x81', 'c',
+    'e',    'e',    'e',    'e',    'i',    'i',    'i',    'i',
+    'd',    'n',    'o',    'o',    'o',    'o',    '\x82', 0,
+    '\x82', 'u',    'u',    'u',    'y',    'y',    0,      'y',
+  };
+
+
+/**
+ * The sort key of a queue entry, and the
+ * index of the entry in the queue
+ */
+typedef struct libqwaitclient_qwait_queue_sort_key
+{
+  /**
+   * The time the entry was added to the queue, in
+   * milliseconds, with the sign bit flipped so that
+   * it can be sorted as an unsigned integer
+   */
+  uint64_t key;
+  
+  /**
+   * The index of the entry in `positions`
+   */
+  size_t index;
+  
+} libqwaitclient_qwait_queue_sort_key_t;
+
+
+/**
+ * Get the sort key of a queue entry
+ * 
+ * @param   pos  The queue entry
+ * @return       The time the entry was added to the queue, in milliseconds,
+ *               with the sign bit flipped so that it sorts as an unsigned integer
+ */
+static uint64_t __attribute__((pure)) libqwaitclient_qwait_queue_sort_key(const libqwaitclient_qwait_position_t* restrict pos)
+{
+  uint64_t key = (uint64_t)((int64_t)(pos->enter_time_seconds) * 1000 + pos->enter_time_mseconds);
+  return key ^ ((uint64_t)1 << 63);
+}
+
+
+/**
+ * Sort the entries in a queue by time, entries
+ * with the same time are kept in their order
+ * 
+ * @param   this  The queue
+ * @return        Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_queue_sort_positions(_this_)
+{
+  libqwaitclient_qwait_queue_sort_key_t* restrict keys = NULL;
+  libqwaitclient_qwait_queue_sort_key_t* restrict temp = NULL;
+  libqwaitclient_qwait_queue_sort_key_t* restrict swap;
+  libqwaitclient_qwait_position_t* restrict sorted = NULL;
+  size_t counts[8][256];
+  size_t i, byte, sum, count, n = this->position_count;
+  uint64_t key, last = 0;
+  int saved_errno;
+  
+  /* The server almost always sends the entries in order,
+     so that is checked first, without allocating anything. */
+  for (i = 0; i < n; i++)
+    {
+      key = libqwaitclient_qwait_queue_sort_key(this->positions + i);
+      if (key < last)
+	break;
+      last = key;
+    }
+  if (i == n)
+    return 0;
+  
+  if (xmalloc(keys, n, libqwaitclient_qwait_queue_sort_key_t))  goto fail;
+  
+  /* Make the keys, and count the bytes for each pass at the same time. */
+  memset(counts, 0, sizeof(counts));
+  for (i = 0; i < n; i++)
+    {
+      keys[i].key = key = libqwaitclient_qwait_queue_sort_key(this->positions + i);
+      keys[i].index = i;
+      for (byte = 0; byte < 8; byte++)
+	counts[byte][(key >> (8 * byte)) & 255]++;
+    }
+  
+  /* Least significant digit radix sort, one byte at a time,
+     bytes that are the same in every key are skipped. */
+  if (xmalloc(temp, n, libqwaitclient_qwait_queue_sort_key_t))  goto fail;
+  for (byte = 0; byte < 8; byte++)
+    {
+      if (counts[byte][(keys[0].key >> (8 * byte)) & 255] == n)
+	continue;
+      for (i = sum = 0; i < 256; i++)
+	count = counts[byte][i], counts[byte][i] = sum, sum += count;
+      for (i = 0; i < n; i++)
+	temp[counts[byte][(keys[i].key >> (8 * byte)) & 255]++] = keys[i];
+      swap = keys, keys = temp, temp = swap;
+    }
+  
+  /* Move the entries into their places. */
+  if (xmalloc(sorted, n, libqwaitclient_qwait_position_t))  goto fail;
+  for (i = 0; i < n; i++)
+    sorted[i] = this->positions[keys[i].index];
+  free(this->positions);
+  this->positions = sorted;
+  
+  free(keys);
+  free(temp);
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  free(keys);
+  free(temp);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Sort the owners and the moderators of a queue, so
+ * that they can be looked up with a binary search
+ * 
+ * @param  this  The queue
+ */
+static void libqwaitclient_qwait_queue_sort_admins(_this_)
+{
+  if (this->owner_count > 1)
+    qsort(this->owners, this->owner_count, sizeof(libqwaitclient_qwait_user_id_t),
+	  libqwaitclient_qwait_user_id_compare);
+  if (this->moderator_count > 1)
+    qsort(this->moderators, this->moderator_count, sizeof(libqwaitclient_qwait_user_id_t),
+	  libqwaitclient_qwait_user_id_compare);
+}
+
+
+/**
+ * Check whether a user is in a sorted list of users
+ * 
+ * @param   users    The users
+ * @param   count    The number of elements in `users`
+ * @param   user_id  The user
+ * @return           1 if the user is in the list, 0 otherwise
+ */
+static int __attribute__((pure)) libqwaitclient_qwait_queue_search(const libqwaitclient_qwait_user_id_t* restrict users,
+								   size_t count, libqwaitclient_qwait_user_id_t user_id)
+{
+  size_t low = 0, high = count, mid;
+  
+  while (low < high)
+    {
+      mid = low + (high - low) / 2;
+      if (users[mid] < user_id)
+	low = mid + 1;
+      else
+	high = mid;
+    }
+  
+  return (low < count) && (users[low] == user_id);
+}
+
+
 /**
  * Initialises a queue
  * 
@@ -47,12 +252,13 @@ void libqwaitclient_qwait_queue_initialise(_this_)
 void libqwaitclient_qwait_queue_destroy(_this_)
 {
   size_t i, n;
-  free(this->name);
   free(this->title);
-  for (i = 0, n = this->owner_count;     i < n; i++)  free(this->owners[i]);
-  for (i = 0, n = this->moderator_count; i < n; i++)  free(this->moderators[i]);
-  for (i = 0, n = this->position_count;  i < n; i++)
-    libqwaitclient_qwait_position_destroy(this->positions + i);
+  free(this->title_key);
+  if (this->interned == NULL)
+    free(this->name);
+  if (this->positions != NULL)
+    for (i = 0, n = this->position_count; i < n; i++)
+      libqwaitclient_qwait_position_destroy(this->positions + i);
   free(this->owners);
   free(this->moderators);
   free(this->positions);
@@ -64,66 +270,23 @@ void libqwaitclient_qwait_queue_destroy(_this_)
  * Contextually parses parsed JSON data into a queue
  * 
  * @param   this  The queue to fill in
- * @param   data  The data to parse
+ * @param   data  The data to parse, strings are taken out of it
  * @return        Zero on success, -1 on error
  */
-int libqwaitclient_qwait_queue_parse(_this_, const libqwaitclient_json_t* restrict data)
+int libqwaitclient_qwait_queue_parse(_this_, libqwaitclient_json_t* restrict data)
 {
-  const libqwaitclient_json_t* restrict data_name       = NULL;
-  const libqwaitclient_json_t* restrict data_title      = NULL;
-  const libqwaitclient_json_t* restrict data_hidden     = NULL;
-  const libqwaitclient_json_t* restrict data_locked     = NULL;
-  const libqwaitclient_json_t* restrict data_owners     = NULL;
-  const libqwaitclient_json_t* restrict data_moderators = NULL;
-  const libqwaitclient_json_t* restrict data_positions  = NULL;
-  size_t i, n = data->length;
+  libqwaitclient_json_t* deferred[1];
+  libqwaitclient_json_t* restrict data_positions;
+  size_t i, n;
   int saved_errno;
   
-  if (data->type != LIBQWAITCLIENT_JSON_TYPE_OBJECT)
-    return errno = EINVAL, -1;
-  
-#define test(want)  ((strlen(want) == len) && !memcmp(name, want, len * sizeof(char)))
+  /* Read and evaluate information. */
+  if (libqwaitclient_json_schema_decode(this, fields, sizeof(fields) / sizeof(*fields), data, deferred) < 0)
+    goto fail;
+  libqwaitclient_qwait_queue_sort_admins(this);
   
-  /* Read information. */
-  for (i = 0; i < n; i++)
-    {
-      const libqwaitclient_json_t* restrict value = &(data->data.object[i].value);
-      char* name = data->data.object[i].name;
-      size_t len = data->data.object[i].name_length;
-      
-      if      (test("name"))        data_name       = value;
-      else if (test("title"))       data_title      = value;
-      else if (test("hidden"))      data_hidden     = value;
-      else if (test("locked"))      data_locked     = value;
-      else if (test("owners"))      data_owners     = value;
-      else if (test("moderators"))  data_moderators = value;
-      else if (test("positions"))   data_positions  = value;
-      else
-	goto einval;
-    }
-  
-  /* Check that everything was found. */
-  if (data_name       == NULL)  goto einval;
-  if (data_title      == NULL)  goto einval;
-  if (data_hidden     == NULL)  goto einval;
-  if (data_locked     == NULL)  goto einval;
-  if (data_owners     == NULL)  goto einval;
-  if (data_moderators == NULL)  goto einval;
-  if (data_positions  == NULL)  goto einval;
-  
-  /* Evaluate data. */
-  if ((this->name       = libqwaitclient_json_to_zstr(data_name))    == NULL)  goto fail;
-  if ((this->title      = libqwaitclient_json_to_zstr(data_title))   == NULL)  goto fail;
-  if ((this->hidden     = libqwaitclient_json_to_bool(data_hidden))  < 0)      goto fail;
-  if ((this->locked     = libqwaitclient_json_to_bool(data_locked))  < 0)      goto fail;
-  if ((this->owners     = libqwaitclient_json_to_zstrs(data_owners)) == NULL)
-    if (errno)
-      goto fail;
-  this->owner_count = data_owners->length;
-  if ((this->moderators = libqwaitclient_json_to_zstrs(data_moderators)) == NULL)
-    if (errno)
-      goto fail;
-  this->moderator_count = data_moderators->length;
+  /* Evaluate positions. */
+  data_positions = deferred[POSITIONS];
   if (data_positions->type != LIBQWAITCLIENT_JSON_TYPE_ARRAY)
     goto einval;
   n = data_positions->length;
@@ -133,9 +296,8 @@ int libqwaitclient_qwait_queue_parse(_this_, const libqwaitclient_json_t* restri
       goto fail;
   
   /* Order positions by time. */
-  qsort(this->positions, this->position_count,
-	sizeof(libqwaitclient_qwait_position_t),
-	libqwaitclient_qwait_position_compare_by_time);
+  if (libqwaitclient_qwait_queue_sort_positions(this) < 0)
+    goto fail;
   
   return 0;
   
@@ -145,8 +307,129 @@ int libqwaitclient_qwait_queue_parse(_this_, const libqwaitclient_json_t* restri
   saved_errno = errno;
   libqwaitclient_qwait_queue_destroy(this);
   return errno = saved_errno, -1;
+}
+
+
+/**
+ * Contextually parses indexed JSON data into a queue summary,
+ * the entries in the queue are counted but not decoded
+ * 
+ * @param   this   The queue to fill in
+ * @param   tape   The structural index of the data
+ * @param   index  The index of the queue in `tape`
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_queue_parse_summary(_this_, const libqwaitclient_json_tape_t* restrict tape, size_t index)
+{
+  size_t deferred[1];
+  int saved_errno;
   
-#undef test
+  /* Read and evaluate information. */
+  if (libqwaitclient_json_schema_decode_tape(this, fields, sizeof(fields) / sizeof(*fields),
+					     tape, index, deferred) < 0)
+    goto fail;
+  libqwaitclient_qwait_queue_sort_admins(this);
+  
+  /* Count positions. */
+  if (tape->entries[deferred[POSITIONS]].type != LIBQWAITCLIENT_JSON_TYPE_ARRAY)
+    goto einval;
+  this->positions = NULL;
+  this->position_count = tape->entries[deferred[POSITIONS]].count;
+  
+  return 0;
+  
+ einval:
+  errno = EINVAL;
+ fail:
+  saved_errno = errno;
+  libqwaitclient_qwait_queue_destroy(this);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Intern the queue's ID, so that it can be compared by pointer
+ * with other strings interned in the same table, and is not
+ * stored more than once
+ * 
+ * @param   this   The queue
+ * @param   table  The table of interned strings, it must not
+ *                 be destroyed before the queue
+ * @return         Zero on success, -1 on error, in which
+ *                 case the queue is left unmodified
+ */
+int libqwaitclient_qwait_queue_intern(_this_, libqwaitclient_intern_t* restrict table)
+{
+  char* name;
+  
+  if (this->interned != NULL)
+    return this->interned == table ? 0 : (errno = EINVAL, -1);
+  
+  if (this->name != NULL)
+    {
+      if ((name = libqwaitclient_intern_adopt(table, this->name)) == NULL)
+	return -1;
+      this->name = name;
+    }
+  
+  this->interned = table;
+  return 0;
+}
+
+
+/**
+ * Check whether a user owns a queue
+ * 
+ * @param   this     The queue
+ * @param   user_id  The user
+ * @return           1 if the user owns the queue, 0 otherwise
+ */
+int libqwaitclient_qwait_queue_is_owner(const _this_, libqwaitclient_qwait_user_id_t user_id)
+{
+  return libqwaitclient_qwait_queue_search(this->owners, this->owner_count, user_id);
+}
+
+
+/**
+ * Check whether a user moderates a queue
+ * 
+ * @param   this     The queue
+ * @param   user_id  The user
+ * @return           1 if the user moderates the queue, 0 otherwise
+ */
+int libqwaitclient_qwait_queue_is_moderator(const _this_, libqwaitclient_qwait_user_id_t user_id)
+{
+  return libqwaitclient_qwait_queue_search(this->moderators, this->moderator_count, user_id);
+}
+
+
+/**
+ * Get the user ID of an owner of a queue as a string
+ * 
+ * @param   this    The queue
+ * @param   index   The index of the owner in `owners`
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`
+ */
+char* libqwaitclient_qwait_queue_get_owner(const _this_, size_t index, char* restrict buffer)
+{
+  return libqwaitclient_qwait_user_id_format(this->owners[index], buffer);
+}
+
+
+/**
+ * Get the user ID of a moderator of a queue as a string
+ * 
+ * @param   this    The queue
+ * @param   index   The index of the moderator in `moderators`
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`
+ */
+char* libqwaitclient_qwait_queue_get_moderator(const _this_, size_t index, char* restrict buffer)
+{
+  return libqwaitclient_qwait_user_id_format(this->moderators[index], buffer);
 }
 
 
@@ -165,6 +448,93 @@ int libqwaitclient_qwait_queue_compare_by_title(const void* a, const void* b)
 }
 
 
+/**
+ * Make the collation key for the title of a queue, unless it
+ * has already been made; the key is folded to lower case and
+ * orders Swedish titles correctly when compared with `memcmp`,
+ * for example, 'å', 'ä' and 'ö' come after 'z', and 'é' is
+ * sorted as 'e'
+ * 
+ * @param   this  The queue
+ * @return        Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_queue_title_key(_this_)
+{
+  const unsigned char* restrict title = (const unsigned char*)(this->title);
+  char* restrict key;
+  size_t i, n;
+  
+  if (this->title_key != NULL)
+    return 0;
+  
+  /* The key is never longer than the title. */
+  n = strlen(this->title);
+  if (xmalloc(this->title_key, n + 1, char))
+    return -1;
+  key = this->title_key;
+  
+  for (i = 0; i < n; i++)
+    if (('A' <= title[i]) && (title[i] <= 'Z'))
+      *key++ = (char)(title[i] | 0x20);
+    else if ((title[i] == 0xC3) && ((title[i + 1] & 0xC0) == 0x80) && latin1_keys[title[i + 1] & 0x3F])
+      *key++ = latin1_keys[title[++i] & 0x3F];
+    else
+      *key++ = (char)(title[i]);
+  
+  this->title_key_length = (size_t)(key - this->title_key);
+  return 0;
+}
+
+
+/**
+ * Compares the collation keys of the title of queues, the
+ * keys must have been made with `libqwaitclient_qwait_queue_title_key`
+ * 
+ * @param   a  -1 is returned if this queue is an alphabetically lower title than `b`
+ * @param   b  1 is returned if this queue is an alphabetically lower title than `a`
+ * @return     See `a` and `b`, and refer to `qsort(3)`, `strcmp(3)`, et cetera; ascending order
+ */
+int libqwaitclient_qwait_queue_compare_by_title_key(const void* a, const void* b)
+{
+  const libqwaitclient_qwait_queue_t* a_ = a;
+  const libqwaitclient_qwait_queue_t* b_ = b;
+  size_t n = a_->title_key_length < b_->title_key_length ? a_->title_key_length : b_->title_key_length;
+  int r = memcmp(a_->title_key, b_->title_key, n * sizeof(char));
+  
+  if (r)
+    return r;
+  if (a_->title_key_length != b_->title_key_length)
+    return a_->title_key_length < b_->title_key_length ? -1 : 1;
+  
+  /* Titles that only differ in case or diacritics are
+     ordered by their bytes, so the order is stable. */
+  return strcmp(a_->title, b_->title);
+}
+
+
+/**
+ * Sort queues by title, the collation keys
+ * of the titles are made if missing
+ * 
+ * @param   queues  The queues
+ * @param   count   The number of elements in `queues`
+ * @return          Zero on success, -1 on error, in
+ *                  which case the queues are not sorted
+ */
+int libqwaitclient_qwait_queue_sort_by_title(libqwaitclient_qwait_queue_t* restrict queues, size_t count)
+{
+  size_t i;
+  
+  for (i = 0; i < count; i++)
+    if (libqwaitclient_qwait_queue_title_key(queues + i) < 0)
+      return -1;
+  
+  qsort(queues, count, sizeof(libqwaitclient_qwait_queue_t),
+	libqwaitclient_qwait_queue_compare_by_title_key);
+  return 0;
+}
+
+
 /**
  * Print a queue to a file for debugging
  * 
@@ -173,17 +543,24 @@ int libqwaitclient_qwait_queue_compare_by_title(const void* a, const void* b)
  */
 void libqwaitclient_qwait_queue_dump(const _this_, FILE* output)
 {
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
   size_t i, n;
   
   fprintf(output, "queue \"%s\" (%s)", this->title, this->name);
   
   fprintf(output, this->owner_count ? "\n  owners" : "\n  no owners");
   for (i = 0, n = this->owner_count; i < n; i++)
-    fprintf(output, "%s%s", i ? ", " : ": ", this->owners[i]);
+    fprintf(output, "%s%s", i ? ", " : ": ", libqwaitclient_qwait_queue_get_owner(this, i, user_id));
   
   fprintf(output, this->moderator_count ? "\n  moderators" : "\n  no moderators");
   for (i = 0, n = this->moderator_count; i < n; i++)
-    fprintf(output, "%s%s", i ? ", " : ": ", this->moderators[i]);
+    fprintf(output, "%s%s", i ? ", " : ": ", libqwaitclient_qwait_queue_get_moderator(this, i, user_id));
+  
+  if (this->positions == NULL)
+    {
+      fprintf(output, "\n  %zu entries\n", this->position_count);
+      return;
+    }
   
   fprintf(output, this->position_count ? "\n  entries\n" : "\n  no entries\n");
   for (i = 0, n = this->position_count; i < n; i++)
@@ -20,7 +20,10 @@
 
 
 #include "json.h"
+#include "json-tape.h"
 #include "qwait-position.h"
+#include "qwait-user-id.h"
+#include "intern.h"
 
 #define _GNU_SOURCE
 #include <stddef.h>
@@ -41,6 +44,17 @@ typedef struct libqwaitclient_qwait_queue
    */
   char* title;
   
+  /**
+   * The collation key for `title`, not NUL-terminated,
+   * `NULL` until made by `libqwaitclient_qwait_queue_title_key`
+   */
+  char* title_key;
+  
+  /**
+   * The length of `title_key`
+   */
+  size_t title_key_length;
+  
   /**
    * Whether the queue is hidden
    */
@@ -52,9 +66,10 @@ typedef struct libqwaitclient_qwait_queue
   int locked;
   
   /**
-   * List of queue owners (user ID:s)
+   * List of queue owners (packed user ID:s),
+   * sorted in ascending order
    */
-  char** owners;
+  libqwaitclient_qwait_user_id_t* owners;
   
   /**
    * The number of elements in `owners`
@@ -62,9 +77,10 @@ typedef struct libqwaitclient_qwait_queue
   size_t owner_count;
   
   /**
-   * List of queue moderators (user ID:s)
+   * List of queue moderators (packed user ID:s),
+   * sorted in ascending order
    */
-  char** moderators;
+  libqwaitclient_qwait_user_id_t* moderators;
   
   /**
    * The number of elements in `moderators`
@@ -73,14 +89,25 @@ typedef struct libqwaitclient_qwait_queue
   
   /**
    * Entries in the queue
+   * 
+   * `NULL` if the queue was parsed as a summary,
+   * in which case only `position_count` is set
    */
   libqwaitclient_qwait_position_t* positions;
   
   /**
-   * The number of elements in `positions`
+   * The number of elements in `positions`, or
+   * the number of entries in the queue if the
+   * queue was parsed as a summary
    */
   size_t position_count;
   
+  /**
+   * The table of interned strings that owns `name`,
+   * `NULL` if it is owned by the queue
+   */
+  libqwaitclient_intern_t* interned;
+  
 } libqwaitclient_qwait_queue_t;
 
 
@@ -106,10 +133,74 @@ void libqwaitclient_qwait_queue_destroy(_this_);
  * Contextually parses parsed JSON data into a queue
  * 
  * @param   this  The queue to fill in
- * @param   data  The data to parse
+ * @param   data  The data to parse, strings are taken out of it
  * @return        Zero on success, -1 on error
  */
-int libqwaitclient_qwait_queue_parse(_this_, const libqwaitclient_json_t* restrict data);
+int libqwaitclient_qwait_queue_parse(_this_, libqwaitclient_json_t* restrict data);
+
+/**
+ * Contextually parses indexed JSON data into a queue summary,
+ * the entries in the queue are counted but not decoded
+ * 
+ * @param   this   The queue to fill in
+ * @param   tape   The structural index of the data
+ * @param   index  The index of the queue in `tape`
+ * @return         Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_queue_parse_summary(_this_, const libqwaitclient_json_tape_t* restrict tape, size_t index);
+
+/**
+ * Intern the queue's ID, so that it can be compared by pointer
+ * with other strings interned in the same table, and is not
+ * stored more than once
+ * 
+ * @param   this   The queue
+ * @param   table  The table of interned strings, it must not
+ *                 be destroyed before the queue
+ * @return         Zero on success, -1 on error, in which
+ *                 case the queue is left unmodified
+ */
+int libqwaitclient_qwait_queue_intern(_this_, libqwaitclient_intern_t* restrict table);
+
+/**
+ * Check whether a user owns a queue
+ * 
+ * @param   this     The queue
+ * @param   user_id  The user
+ * @return           1 if the user owns the queue, 0 otherwise
+ */
+int libqwaitclient_qwait_queue_is_owner(const _this_, libqwaitclient_qwait_user_id_t user_id) __attribute__((pure));
+
+/**
+ * Check whether a user moderates a queue
+ * 
+ * @param   this     The queue
+ * @param   user_id  The user
+ * @return           1 if the user moderates the queue, 0 otherwise
+ */
+int libqwaitclient_qwait_queue_is_moderator(const _this_, libqwaitclient_qwait_user_id_t user_id) __attribute__((pure));
+
+/**
+ * Get the user ID of an owner of a queue as a string
+ * 
+ * @param   this    The queue
+ * @param   index   The index of the owner in `owners`
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`
+ */
+char* libqwaitclient_qwait_queue_get_owner(const _this_, size_t index, char* restrict buffer);
+
+/**
+ * Get the user ID of a moderator of a queue as a string
+ * 
+ * @param   this    The queue
+ * @param   index   The index of the moderator in `moderators`
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`
+ */
+char* libqwaitclient_qwait_queue_get_moderator(const _this_, size_t index, char* restrict buffer);
 
 /**
  * Compares the title of queues
@@ -120,6 +211,39 @@ int libqwaitclient_qwait_queue_parse(_this_, const libqwaitclient_json_t* restri
  */
 int libqwaitclient_qwait_queue_compare_by_title(const void* a, const void* b) __attribute__((pure));
 
+/**
+ * Make the collation key for the title of a queue, unless it
+ * has already been made; the key is folded to lower case and
+ * orders Swedish titles correctly when compared with `memcmp`,
+ * for example, 'å', 'ä' and 'ö' come after 'z', and 'é' is
+ * sorted as 'e'
+ * 
+ * @param   this  The queue
+ * @return        Zero on success, -1 on error
+ */
+int libqwaitclient_qwait_queue_title_key(_this_);
+
+/**
+ * Compares the collation keys of the title of queues, the
+ * keys must have been made with `libqwaitclient_qwait_queue_title_key`
+ * 
+ * @param   a  -1 is returned if this queue is an alphabetically lower title than `b`
+ * @param   b  1 is returned if this queue is an alphabetically lower title than `a`
+ * @return     See `a` and `b`, and refer to `qsort(3)`, `strcmp(3)`, et cetera; ascending order
+ */
+int libqwaitclient_qwait_queue_compare_by_title_key(const void* a, const void* b) __attribute__((pure));
+
+/**
+ * Sort queues by title, the collation keys
+ * of the titles are made if missing
+ * 
+ * @param   queues  The queues
+ * @param   count   The number of elements in `queues`
+ * @return          Zero on success, -1 on error, in
+ *                  which case the queues are not sorted
+ */
+int libqwaitclient_qwait_queue_sort_by_title(libqwaitclient_qwait_queue_t* restrict queues, size_t count);
+
 /**
  * Print a queue to a file for debugging
  * 
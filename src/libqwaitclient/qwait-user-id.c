@@ -0,0 +1,174 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qwait-user-id.h"
+
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+
+
+/**
+ * User ID:s that are too long to be packed
+ */
+static libqwaitclient_intern_t overflow_ids;
+
+/**
+ * Lock for `overflow_ids`
+ */
+static pthread_mutex_t overflow_ids_lock = PTHREAD_MUTEX_INITIALIZER;
+
+
+
+/**
+ * Store a user ID that cannot be packed out of line
+ * 
+ * @param   id      Output parameter for the user ID
+ * @param   string  The user ID, not NUL-terminated and without NUL bytes
+ * @param   length  The length of `string`
+ * @return          Zero on success, -1 on error
+ */
+static int overflow(libqwaitclient_qwait_user_id_t* restrict id, const char* restrict string, size_t length)
+{
+  char* copy;
+  char* interned;
+  uintptr_t address;
+  
+  if ((copy = strndup(string, length)) == NULL)
+    return -1;
+  
+  pthread_mutex_lock(&overflow_ids_lock);
+  interned = libqwaitclient_intern_adopt(&overflow_ids, copy);
+  pthread_mutex_unlock(&overflow_ids_lock);
+  if (interned == NULL)
+    return free(copy), -1;
+  
+  /* User space addresses are narrower than 56 bits on every supported architecture. */
+  address = (uintptr_t)interned;
+  if ((uint64_t)address >> 56)
+    return errno = EINVAL, -1;
+  
+  *id = ((libqwaitclient_qwait_user_id_t)LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW << 56) | (uint64_t)address;
+  return 0;
+}
+
+
+
+/**
+ * Pack a user ID
+ * 
+ * User ID:s longer than `LIBQWAITCLIENT_QWAIT_USER_ID_MAX` are interned in
+ * a process-wide table, that is never freed, instead of being rejected
+ * 
+ * @param   id      Output parameter for the packed user ID
+ * @param   string  The user ID, not NUL-terminated
+ * @param   length  The length of `string`
+ * @return          Zero on success, -1 on error, `errno` is set to `EINVAL`
+ *                  if `string` is empty or contains a NUL byte
+ */
+int libqwaitclient_qwait_user_id_parse(libqwaitclient_qwait_user_id_t* restrict id,
+				       const char* restrict string, size_t length)
+{
+  libqwaitclient_qwait_user_id_t packed = 0;
+  size_t i;
+  
+  if ((length == 0) || memchr(string, '\0', length))
+    return errno = EINVAL, -1;
+  
+  if ((length > LIBQWAITCLIENT_QWAIT_USER_ID_MAX) ||
+      ((unsigned char)(string[0]) == LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW))
+    return overflow(id, string, length);
+  
+  for (i = 0; i < LIBQWAITCLIENT_QWAIT_USER_ID_MAX; i++)
+    {
+      packed <<= 8;
+      if (i < length)
+	packed |= (libqwaitclient_qwait_user_id_t)(unsigned char)(string[i]);
+    }
+  
+  *id = packed;
+  return 0;
+}
+
+
+/**
+ * Unpack a user ID
+ * 
+ * @param   id      The packed user ID
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, `NULL` if `id` is `LIBQWAITCLIENT_QWAIT_USER_ID_NONE`,
+ *                  or the interned string if the user ID is stored out of line,
+ *                  which must not be modified
+ */
+char* libqwaitclient_qwait_user_id_format(libqwaitclient_qwait_user_id_t id, char* restrict buffer)
+{
+  size_t i;
+  
+  if (id == LIBQWAITCLIENT_QWAIT_USER_ID_NONE)
+    return NULL;
+  
+  if ((id >> 56) == LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW)
+    return (char*)(uintptr_t)(id & ((UINT64_C(1) << 56) - 1));
+  
+  for (i = 0; i < LIBQWAITCLIENT_QWAIT_USER_ID_MAX; i++)
+    buffer[i] = (char)(unsigned char)(id >> (8 * (LIBQWAITCLIENT_QWAIT_USER_ID_MAX - 1 - i)));
+  buffer[LIBQWAITCLIENT_QWAIT_USER_ID_MAX] = '\0';
+  
+  return buffer;
+}
+
+
+/**
+ * Calculate a hash of a user ID, suitable for hash tables
+ * indexed by the lowest bits of the hash
+ * 
+ * @param   id  The packed user ID
+ * @return      The hash of the user ID
+ */
+size_t libqwaitclient_qwait_user_id_hash(libqwaitclient_qwait_user_id_t id)
+{
+  /* All user ID:s start with "u1" and the rest is [0-9a-z], so
+     the low bits alone are poorly distributed, mix all bits
+     into them with the 64-bit finaliser from MurmurHash3. */
+  id ^= id >> 33;
+  id *= UINT64_C(0xFF51AFD7ED558CCD);
+  id ^= id >> 33;
+  id *= UINT64_C(0xC4CEB9FE1A85EC53);
+  id ^= id >> 33;
+  return (size_t)id;
+}
+
+
+/**
+ * Compares two user ID:s
+ * 
+ * @param   a  Pointer to a `libqwaitclient_qwait_user_id_t`, -1 is returned if it is lower than `b`
+ * @param   b  Pointer to a `libqwaitclient_qwait_user_id_t`, 1 is returned if it is lower than `a`
+ * @return     See `a` and `b`, and refer to `qsort(3)`, `strcmp(3)`, et cetera; ascending order
+ */
+int libqwaitclient_qwait_user_id_compare(const void* a, const void* b)
+{
+  libqwaitclient_qwait_user_id_t a_ = *(const libqwaitclient_qwait_user_id_t*)a;
+  libqwaitclient_qwait_user_id_t b_ = *(const libqwaitclient_qwait_user_id_t*)b;
+  return a_ < b_ ? -1 : a_ > b_ ? 1 : 0;
+}
+
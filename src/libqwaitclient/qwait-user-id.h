@@ -0,0 +1,119 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_QWAIT_USER_ID_H
+#define LIBQWAITCLIENT_QWAIT_USER_ID_H
+
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * The longest user ID that can be packed into a
+ * `libqwaitclient_qwait_user_id_t`, user ID:s are
+ * 8-character [0-9a-z] strings starting with "u1",
+ * longer user ID:s are stored out of line
+ */
+#define LIBQWAITCLIENT_QWAIT_USER_ID_MAX  8
+
+/**
+ * The size of a buffer that is large enough for
+ * any user ID, including its NUL-termination
+ */
+#define LIBQWAITCLIENT_QWAIT_USER_ID_SIZE  (LIBQWAITCLIENT_QWAIT_USER_ID_MAX + 1)
+
+/**
+ * The absence of a user ID
+ */
+#define LIBQWAITCLIENT_QWAIT_USER_ID_NONE  ((libqwaitclient_qwait_user_id_t)0)
+
+/**
+ * The most significant byte of user ID:s that are stored out of
+ * line, because they do not fit or start with the byte itself,
+ * which is not valid in UTF-8; the other bytes are the address
+ * of the user ID's string
+ */
+#define LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW  0xFF
+
+
+
+/**
+ * A user ID packed into an integer, the first character
+ * is stored in the most significant byte, and unused
+ * bytes are zero, so `==` compares user ID:s and `<`
+ * orders them in the same way as `strcmp` orders
+ * their strings; zero is used for no user ID
+ * 
+ * User ID:s that do not fit are stored out of line, see
+ * `LIBQWAITCLIENT_QWAIT_USER_ID_OVERFLOW`, `==` still
+ * compares them, but they are ordered after all other
+ * user ID:s and by address rather than by content
+ */
+typedef uint64_t libqwaitclient_qwait_user_id_t;
+
+
+
+/**
+ * Pack a user ID
+ * 
+ * User ID:s longer than `LIBQWAITCLIENT_QWAIT_USER_ID_MAX` are interned in
+ * a process-wide table, that is never freed, instead of being rejected
+ * 
+ * @param   id      Output parameter for the packed user ID
+ * @param   string  The user ID, not NUL-terminated
+ * @param   length  The length of `string`
+ * @return          Zero on success, -1 on error, `errno` is set to `EINVAL`
+ *                  if `string` is empty or contains a NUL byte
+ */
+int libqwaitclient_qwait_user_id_parse(libqwaitclient_qwait_user_id_t* restrict id,
+				       const char* restrict string, size_t length);
+
+/**
+ * Unpack a user ID
+ * 
+ * @param   id      The packed user ID
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, `NULL` if `id` is `LIBQWAITCLIENT_QWAIT_USER_ID_NONE`,
+ *                  or the interned string if the user ID is stored out of line,
+ *                  which must not be modified
+ */
+char* libqwaitclient_qwait_user_id_format(libqwaitclient_qwait_user_id_t id, char* restrict buffer);
+
+/**
+ * Calculate a hash of a user ID, suitable for hash tables
+ * indexed by the lowest bits of the hash
+ * 
+ * @param   id  The packed user ID
+ * @return      The hash of the user ID
+ */
+size_t libqwaitclient_qwait_user_id_hash(libqwaitclient_qwait_user_id_t id) __attribute__((const));
+
+/**
+ * Compares two user ID:s
+ * 
+ * @param   a  Pointer to a `libqwaitclient_qwait_user_id_t`, -1 is returned if it is lower than `b`
+ * @param   b  Pointer to a `libqwaitclient_qwait_user_id_t`, 1 is returned if it is lower than `a`
+ * @return     See `a` and `b`, and refer to `qsort(3)`, `strcmp(3)`, et cetera; ascending order
+ */
+int libqwaitclient_qwait_user_id_compare(const void* a, const void* b) __attribute__((pure));
+
+
+#endif
+
@@ -0,0 +1,433 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "qwait-user-index.h"
+
+#include "macros.h"
+#include "intern.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+
+#define _this_  libqwaitclient_qwait_user_index_t* restrict this
+#define _entry_  libqwaitclient_qwait_user_index_entry_t
+
+
+/**
+ * Index of a user in the hash table
+ */
+#define SLOT(user_id)  (libqwaitclient_qwait_user_id_hash(user_id) & (this->capacity - 1))
+
+/**
+ * The slot after a slot in the hash table
+ */
+#define NEXT(slot)  (((slot) + 1) & (this->capacity - 1))
+
+/**
+ * Whether a slot in the hash table is unused
+ */
+#define UNUSED(slot)  (this->table[slot].user_id == LIBQWAITCLIENT_QWAIT_USER_ID_NONE)
+
+
+
+/**
+ * Resize the hash table of an index of users
+ * 
+ * @param   this      The index
+ * @param   capacity  The new number of slots, a power of two
+ * @return            Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_user_index_rehash(_this_, size_t capacity)
+{
+  _entry_* restrict old = this->table;
+  size_t i, k, n = this->capacity;
+  
+  if (xcalloc(this->table, capacity, _entry_))
+    return this->table = old, -1;
+  this->capacity = capacity;
+  
+  for (i = 0; i < n; i++)
+    if (old[i].user_id != LIBQWAITCLIENT_QWAIT_USER_ID_NONE)
+      {
+	for (k = SLOT(old[i].user_id); !UNUSED(k); k = NEXT(k));
+	this->table[k] = old[i];
+      }
+  
+  free(old);
+  return 0;
+}
+
+
+/**
+ * Add an entry to the hash table of an index of users
+ * 
+ * @param   this      The index
+ * @param   user_id   The user
+ * @param   queue     The index of the queue
+ * @param   position  The index of the user's entry in the queue
+ * @return            Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_user_index_insert(_this_, libqwaitclient_qwait_user_id_t user_id,
+						  size_t queue, size_t position)
+{
+  size_t k;
+  
+  /* Keep the table at most half full, so the probe sequences stay short. */
+  if (2 * (this->count + 1) > this->capacity)
+    if (libqwaitclient_qwait_user_index_rehash(this, this->capacity ? this->capacity << 1 : 64) < 0)
+      return -1;
+  
+  for (k = SLOT(user_id); !UNUSED(k); k = NEXT(k));
+  this->table[k].user_id = user_id;
+  this->table[k].queue = queue;
+  this->table[k].position = position;
+  this->count++;
+  return 0;
+}
+
+
+/**
+ * Remove an entry from the hash table of an index of users
+ * 
+ * @param  this     The index
+ * @param  user_id  The user
+ * @param  queue    The index of the queue
+ */
+static void libqwaitclient_qwait_user_index_erase(_this_, libqwaitclient_qwait_user_id_t user_id, size_t queue)
+{
+  size_t i, j, k;
+  
+  for (i = SLOT(user_id); !UNUSED(i); i = NEXT(i))
+    if ((this->table[i].user_id == user_id) && (this->table[i].queue == queue))
+      break;
+  if (UNUSED(i))
+    return;
+  
+  /* Move back the following entries that would not be found
+     if the slot was left empty, so that no tombstones are needed. */
+  for (j = NEXT(i); !UNUSED(j); j = NEXT(j))
+    {
+      k = SLOT(this->table[j].user_id);
+      if ((i <= j) ? ((i < k) && (k <= j)) : ((i < k) || (k <= j)))
+	continue;
+      this->table[i] = this->table[j];
+      i = j;
+    }
+  
+  this->table[i].user_id = LIBQWAITCLIENT_QWAIT_USER_ID_NONE;
+  this->count--;
+}
+
+
+/**
+ * Index the users in a queue
+ * 
+ * @param   this   The index, the queue must not already be indexed
+ * @param   index  The index of the queue
+ * @param   queue  The queue
+ * @return         Zero on success, -1 on error
+ */
+static int libqwaitclient_qwait_user_index_add_queue(_this_, size_t index,
+						     const libqwaitclient_qwait_queue_t* restrict queue)
+{
+  libqwaitclient_qwait_user_id_t user_id;
+  size_t i, n = queue->positions == NULL ? 0 : queue->position_count;
+  
+  this->members[index] = NULL;
+  this->member_counts[index] = 0;
+  if (n && xmalloc(this->members[index], n, libqwaitclient_qwait_user_id_t))
+    return -1;
+  
+  for (i = 0; i < n; i++)
+    if ((user_id = queue->positions[i].user_id) != LIBQWAITCLIENT_QWAIT_USER_ID_NONE)
+      {
+	if (libqwaitclient_qwait_user_index_insert(this, user_id, index, i) < 0)
+	  return -1;
+	this->members[index][this->member_counts[index]++] = user_id;
+      }
+  
+  return 0;
+}
+
+
+/**
+ * Remove the users in a queue from the index
+ * 
+ * @param  this   The index
+ * @param  index  The index of the queue
+ */
+static void libqwaitclient_qwait_user_index_remove_queue(_this_, size_t index)
+{
+  size_t i, n = this->member_counts[index];
+  for (i = 0; i < n; i++)
+    libqwaitclient_qwait_user_index_erase(this, this->members[index][i], index);
+  free(this->members[index]);
+  this->members[index] = NULL;
+  this->member_counts[index] = 0;
+}
+
+
+/**
+ * Initialise an index of users
+ * 
+ * @param  this  The index
+ */
+void libqwaitclient_qwait_user_index_initialise(_this_)
+{
+  memset(this, 0, sizeof(libqwaitclient_qwait_user_index_t));
+}
+
+
+/**
+ * Release all resources in an index of users, but not the index itself
+ * 
+ * @param  this  The index
+ */
+void libqwaitclient_qwait_user_index_destroy(_this_)
+{
+  size_t i, n = this->queue_count;
+  for (i = 0; i < n; i++)
+    {
+      free(this->queue_names[i]);
+      free(this->members[i]);
+    }
+  free(this->queue_names);
+  free(this->members);
+  free(this->member_counts);
+  free(this->table);
+  memset(this, 0, sizeof(libqwaitclient_qwait_user_index_t));
+}
+
+
+/**
+ * Index the users in a list of queues, entries without a user ID
+ * are not indexed, and neither are the queues parsed as summaries
+ * 
+ * @param   this    The index, it should be initialised or destroyed
+ * @param   queues  The list of queues
+ * @param   count   The number of elements in `queues`
+ * @return          Zero on success, -1 on error, in which
+ *                  case the index is left empty
+ */
+int libqwaitclient_qwait_user_index_build(_this_, const libqwaitclient_qwait_queue_t* restrict queues, size_t count)
+{
+  size_t i, n = count ? count : 1;
+  int saved_errno;
+  
+  libqwaitclient_qwait_user_index_initialise(this);
+  
+  if (xcalloc(this->queue_names,   n, char*))                            goto fail;
+  if (xcalloc(this->members,       n, libqwaitclient_qwait_user_id_t*))  goto fail;
+  if (xcalloc(this->member_counts, n, size_t))                           goto fail;
+  this->queue_count = count;
+  
+  for (i = 0; i < count; i++)
+    {
+      if ((this->queue_names[i] = strdup(queues[i].name)) == NULL)
+	goto fail;
+      if (libqwaitclient_qwait_user_index_add_queue(this, i, queues + i) < 0)
+	goto fail;
+    }
+  
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  libqwaitclient_qwait_user_index_destroy(this);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Update an index of users to a new snapshot of the list of queues,
+ * only the queues with new, left or moved entries are reindexed
+ * 
+ * @param   this     The index, built for the old snapshot
+ * @param   changes  The changes from the old snapshot to the new snapshot,
+ *                   from `libqwaitclient_qwait_changes_diff_queues`
+ * @param   queues   The new snapshot of the list of queues
+ * @param   count    The number of elements in `queues`
+ * @return           Zero on success, -1 on error, in which
+ *                   case the index is left empty
+ */
+int libqwaitclient_qwait_user_index_update(_this_, const libqwaitclient_qwait_changes_t* restrict changes,
+					   const libqwaitclient_qwait_queue_t* restrict queues, size_t count)
+{
+  size_t* restrict map = NULL;
+  size_t* restrict slots = NULL;
+  char* restrict reindex = NULL;
+  char** names = NULL;
+  libqwaitclient_qwait_user_id_t** members = NULL;
+  size_t* member_counts = NULL;
+  size_t i, j, k, mask, n = count ? count : 1, old_count = this->queue_count;
+  int saved_errno;
+  
+  if (xcalloc(reindex, n, char))
+    goto fail;
+  
+  /* Queues are usually listed in the same order every time, in which
+     case the queues keep their index, otherwise the queues are matched
+     by ID, and the index is moved over to the new order. */
+  for (i = 0; (old_count == count) && (i < count); i++)
+    if (strcmp(this->queue_names[i], queues[i].name))
+      break;
+  if ((old_count != count) || (i < count))
+    {
+      /* Find the new index of each old queue. */
+      mask = 8;
+      while (mask < 2 * count)
+	mask <<= 1;
+      mask -= 1;
+      if (xcalloc(slots, mask + 1, size_t))                  goto fail;
+      if (xmalloc(map, old_count ? old_count : 1, size_t))  goto fail;
+      for (j = 0; j < count; j++)
+	{
+	  for (k = libqwaitclient_intern_hash(queues[j].name) & mask; slots[k]; k = (k + 1) & mask);
+	  slots[k] = j + 1;
+	}
+      for (i = 0; i < old_count; i++)
+	{
+	  for (k = libqwaitclient_intern_hash(this->queue_names[i]) & mask; slots[k]; k = (k + 1) & mask)
+	    if (!strcmp(queues[slots[k] - 1].name, this->queue_names[i]))
+	      break;
+	  map[i] = slots[k] ? slots[k] - 1 : LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX;
+	}
+      
+      /* Make the lists for the new order. */
+      if (xcalloc(names,         n, char*))                            goto fail;
+      if (xcalloc(members,       n, libqwaitclient_qwait_user_id_t*))  goto fail;
+      if (xcalloc(member_counts, n, size_t))                           goto fail;
+      for (j = 0; j < count; j++)
+	if ((names[j] = strdup(queues[j].name)) == NULL)
+	  goto fail;
+      
+      /* Nothing can fail from here on. Forget the removed queues, move
+	 the others to their new index, and index all new queues. */
+      for (j = 0; j < count; j++)
+	reindex[j] = 1;
+      for (i = 0; i < old_count; i++)
+	if (map[i] == LIBQWAITCLIENT_QWAIT_CHANGE_NO_INDEX)
+	  libqwaitclient_qwait_user_index_remove_queue(this, i);
+	else
+	  {
+	    members[map[i]] = this->members[i];
+	    member_counts[map[i]] = this->member_counts[i];
+	    reindex[map[i]] = 0;
+	    this->members[i] = NULL;
+	  }
+      for (k = 0; k < this->capacity; k++)
+	if (!UNUSED(k))
+	  this->table[k].queue = map[this->table[k].queue];
+      for (i = 0; i < old_count; i++)
+	free(this->queue_names[i]);
+      free(this->queue_names);
+      free(this->members);
+      free(this->member_counts);
+      this->queue_names = names;
+      this->members = members;
+      this->member_counts = member_counts;
+      this->queue_count = count;
+      names = NULL;
+      members = NULL;
+      member_counts = NULL;
+    }
+  
+  /* Find the queues whose entries have changed. */
+  for (i = 0; i < changes->count; i++)
+    switch (changes->changes[i].type)
+      {
+      case LIBQWAITCLIENT_QWAIT_CHANGE_JOINED:
+      case LIBQWAITCLIENT_QWAIT_CHANGE_LEFT:
+      case LIBQWAITCLIENT_QWAIT_CHANGE_MOVED:
+      case LIBQWAITCLIENT_QWAIT_CHANGE_QUEUE_ADDED:
+	if (changes->changes[i].new_queue < count)
+	  reindex[changes->changes[i].new_queue] = 1;
+	break;
+      default:
+	break;
+      }
+  
+  /* Reindex them, the other entries ahead or behind
+     someone that joined or left have moved too. */
+  for (j = 0; j < count; j++)
+    if (reindex[j])
+      {
+	libqwaitclient_qwait_user_index_remove_queue(this, j);
+	if (libqwaitclient_qwait_user_index_add_queue(this, j, queues + j) < 0)
+	  goto fail;
+      }
+  
+  free(reindex);
+  free(slots);
+  free(map);
+  return 0;
+  
+ fail:
+  saved_errno = errno;
+  if (names != NULL)
+    for (j = 0; j < count; j++)
+      free(names[j]);
+  free(names);
+  free(members);
+  free(member_counts);
+  free(reindex);
+  free(slots);
+  free(map);
+  libqwaitclient_qwait_user_index_destroy(this);
+  return errno = saved_errno, -1;
+}
+
+
+/**
+ * Find where a user is in the queues
+ * 
+ * @param   this     The index
+ * @param   user_id  The user
+ * @param   found    Output array for where the user is, may be `NULL` if `max` is zero
+ * @param   max      The number of elements in `found`
+ * @return           The number of queues the user is in, this
+ *                   can be more than `max`, in which case only
+ *                   `max` of them are stored in `found`
+ */
+size_t libqwaitclient_qwait_user_index_lookup(const _this_, libqwaitclient_qwait_user_id_t user_id,
+					      libqwaitclient_qwait_user_index_entry_t* restrict found, size_t max)
+{
+  size_t k, n = 0;
+  
+  if ((this->capacity == 0) || (user_id == LIBQWAITCLIENT_QWAIT_USER_ID_NONE))
+    return 0;
+  
+  for (k = SLOT(user_id); !UNUSED(k); k = NEXT(k))
+    if (this->table[k].user_id == user_id)
+      {
+	if (n < max)
+	  found[n] = this->table[k];
+	n++;
+      }
+  
+  return n;
+}
+
+
+#undef UNUSED
+#undef NEXT
+#undef SLOT
+#undef _entry_
+#undef _this_
+
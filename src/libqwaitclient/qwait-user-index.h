@@ -0,0 +1,165 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_QWAIT_USER_INDEX_H
+#define LIBQWAITCLIENT_QWAIT_USER_INDEX_H
+
+
+#include "qwait-queue.h"
+#include "qwait-changes.h"
+#include "qwait-user-id.h"
+
+#define _GNU_SOURCE
+#include <stddef.h>
+
+
+
+/**
+ * Where a user is in a queue
+ */
+typedef struct libqwaitclient_qwait_user_index_entry
+{
+  /**
+   * The user, `LIBQWAITCLIENT_QWAIT_USER_ID_NONE` for unused slots
+   */
+  libqwaitclient_qwait_user_id_t user_id;
+  
+  /**
+   * The index of the queue in the list of queues
+   */
+  size_t queue;
+  
+  /**
+   * The index of the entry in the queue, the entries are
+   * sorted by time, so this is also the number of entries
+   * ahead of the user, that is, the user's rank in the queue
+   */
+  size_t position;
+  
+} libqwaitclient_qwait_user_index_entry_t;
+
+
+/**
+ * An index from users to where they are in
+ * the queues in a list of queues
+ */
+typedef struct libqwaitclient_qwait_user_index
+{
+  /**
+   * Hash table of the entries, a user that is in
+   * multiple queues has one entry per queue
+   */
+  libqwaitclient_qwait_user_index_entry_t* table;
+  
+  /**
+   * The number of slots in `table`, zero or a power of two
+   */
+  size_t capacity;
+  
+  /**
+   * The number of used slots in `table`
+   */
+  size_t count;
+  
+  /**
+   * The ID of each queue in the list of queues
+   */
+  char** queue_names;
+  
+  /**
+   * The users in each queue in the list of queues
+   */
+  libqwaitclient_qwait_user_id_t** members;
+  
+  /**
+   * The number of users in each element of `members`
+   */
+  size_t* member_counts;
+  
+  /**
+   * The number of queues in the list of queues
+   */
+  size_t queue_count;
+  
+} libqwaitclient_qwait_user_index_t;
+
+
+
+#define _this_  libqwaitclient_qwait_user_index_t* restrict this
+
+
+/**
+ * Initialise an index of users
+ * 
+ * @param  this  The index
+ */
+void libqwaitclient_qwait_user_index_initialise(_this_);
+
+/**
+ * Release all resources in an index of users, but not the index itself
+ * 
+ * @param  this  The index
+ */
+void libqwaitclient_qwait_user_index_destroy(_this_);
+
+/**
+ * Index the users in a list of queues, entries without a user ID
+ * are not indexed, and neither are the queues parsed as summaries
+ * 
+ * @param   this    The index, it should be initialised or destroyed
+ * @param   queues  The list of queues
+ * @param   count   The number of elements in `queues`
+ * @return          Zero on success, -1 on error, in which
+ *                  case the index is left empty
+ */
+int libqwaitclient_qwait_user_index_build(_this_, const libqwaitclient_qwait_queue_t* restrict queues, size_t count);
+
+/**
+ * Update an index of users to a new snapshot of the list of queues,
+ * only the queues with new, left or moved entries are reindexed
+ * 
+ * @param   this     The index, built for the old snapshot
+ * @param   changes  The changes from the old snapshot to the new snapshot,
+ *                   from `libqwaitclient_qwait_changes_diff_queues`
+ * @param   queues   The new snapshot of the list of queues
+ * @param   count    The number of elements in `queues`
+ * @return           Zero on success, -1 on error, in which
+ *                   case the index is left empty
+ */
+int libqwaitclient_qwait_user_index_update(_this_, const libqwaitclient_qwait_changes_t* restrict changes,
+					   const libqwaitclient_qwait_queue_t* restrict queues, size_t count);
+
+/**
+ * Find where a user is in the queues
+ * 
+ * @param   this     The index
+ * @param   user_id  The user
+ * @param   found    Output array for where the user is, may be `NULL` if `max` is zero
+ * @param   max      The number of elements in `found`
+ * @return           The number of queues the user is in, this
+ *                   can be more than `max`, in which case only
+ *                   `max` of them are stored in `found`
+ */
+size_t libqwaitclient_qwait_user_index_lookup(const _this_, libqwaitclient_qwait_user_id_t user_id,
+					      libqwaitclient_qwait_user_index_entry_t* restrict found, size_t max);
+
+
+#undef _this_
+
+
+#endif
+
@@ -18,7 +18,9 @@
 #include "qwait-user.h"
 
 #include "macros.h"
+#include "json-schema.h"
 
+#include <stddef.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdint.h>
@@ -29,6 +31,59 @@
 #define _this_  libqwaitclient_qwait_user_t* restrict this
 
 
+/**
+ * Index of `queuePositions` in the deferred members of a user
+ */
+#define QUEUE_POSITIONS  0
+
+/**
+ * Index of `queueName` in the deferred members of a queue entry
+ */
+#define QUEUE_NAME  0
+
+
+#define F(name, type, member, aux)					\
+  LIBQWAITCLIENT_JSON_FIELD(name, LIBQWAITCLIENT_JSON_FIELD_##type, 1,	\
+			    offsetof(libqwaitclient_qwait_user_t, member),	\
+			    offsetof(libqwaitclient_qwait_user_t, aux))
+
+/**
+ * The members of a user
+ */
+static const libqwaitclient_json_field_t user_fields[] =
+  {
+    F("name",            USER_ID,         user_id,          user_id),
+    F("readableName",    NULLABLE_STRING, real_name,        real_name),
+    F("admin",           BOOLEAN,         admin,            admin),
+    F("anonymous",       BOOLEAN,         anonymous,        anonymous),
+    F("roles",           STRINGS,         roles,            role_count),
+    F("ownedQueues",     STRINGS,         owned_queues,     owned_queue_count),
+    F("moderatedQueues", STRINGS,         moderated_queues, moderated_queue_count),
+    LIBQWAITCLIENT_JSON_FIELD("queuePositions", LIBQWAITCLIENT_JSON_FIELD_DEFERRED, 1, QUEUE_POSITIONS, 0),
+  };
+
+#undef F
+
+
+#define F(name, type, member, aux)						\
+  LIBQWAITCLIENT_JSON_FIELD(name, LIBQWAITCLIENT_JSON_FIELD_##type, 1,		\
+			    offsetof(libqwaitclient_qwait_position_t, member),	\
+			    offsetof(libqwaitclient_qwait_position_t, aux))
+
+/**
+ * The members of a user's queue entry
+ */
+static const libqwaitclient_json_field_t position_fields[] =
+  {
+    F("location",  NULLABLE_STRING, location,           location),
+    F("comment",   NULLABLE_STRING, comment,            comment),
+    F("startTime", MILLISECONDS,    enter_time_seconds, enter_time_mseconds),
+    LIBQWAITCLIENT_JSON_FIELD("queueName", LIBQWAITCLIENT_JSON_FIELD_DEFERRED, 1, QUEUE_NAME, 0),
+  };
+
+#undef F
+
+
 /**
  * Initialises a user
  * 
@@ -48,24 +103,27 @@ void libqwaitclient_qwait_user_initialise(_this_)
 void libqwaitclient_qwait_user_destroy(_this_)
 {
   size_t i, n;
-  free(this->user_id);
   free(this->real_name);
   for (i = 0, n = this->role_count; i < n; i++)
     free(this->roles[i]);
   free(this->roles);
-  for (i = 0, n = this->owned_queue_count; i < n; i++)
-    free(this->owned_queues[i]);
+  if (this->interned == NULL)
+    {
+      for (i = 0, n = this->owned_queue_count; i < n; i++)
+	free(this->owned_queues[i]);
+      for (i = 0, n = this->moderated_queue_count; i < n; i++)
+	free(this->moderated_queues[i]);
+    }
   free(this->owned_queues);
-  for (i = 0, n = this->moderated_queue_count; i < n; i++)
-    free(this->moderated_queues[i]);
   free(this->moderated_queues);
   for (i = 0, n = this->queue_count; i < n; i++)
     {
       free(this->positions[i].location);
       free(this->positions[i].comment);
-      /* `user_id` and `real_name` are duplicates of the
-	 `libqwaitclient_qwait_user_t` corresponding members. */
-      free(this->queues[i]);
+      /* `real_name` is a duplicate of the
+	 `libqwaitclient_qwait_user_t` corresponding member. */
+      if (this->interned == NULL)
+	free(this->queues[i]);
     }
   free(this->positions);
   free(this->queues);
@@ -77,75 +135,27 @@ void libqwaitclient_qwait_user_destroy(_this_)
  * Contextually parses parsed JSON data into a user
  * 
  * @param   this  The user to fill in
- * @param   data  The data to parse
+ * @param   data  The data to parse, strings are taken out of it
  * @return        Zero on success, -1 on error
  */
-int libqwaitclient_qwait_user_parse(_this_, const libqwaitclient_json_t* restrict data)
+int libqwaitclient_qwait_user_parse(_this_, libqwaitclient_json_t* restrict data)
 {
-  const libqwaitclient_json_t* restrict data_user_id    = NULL;
-  const libqwaitclient_json_t* restrict data_real_name  = NULL;
-  const libqwaitclient_json_t* restrict data_admin      = NULL;
-  const libqwaitclient_json_t* restrict data_anonymous  = NULL;
-  const libqwaitclient_json_t* restrict data_roles      = NULL;
-  const libqwaitclient_json_t* restrict data_queues     = NULL;
-  const libqwaitclient_json_t* restrict data_owned      = NULL;
-  const libqwaitclient_json_t* restrict data_moderated  = NULL;
-  size_t i, n = data->length;
+  libqwaitclient_json_t* deferred[1];
+  libqwaitclient_json_t* restrict data_queues;
+  size_t i, n;
   int saved_errno;
   
-  if (data->type != LIBQWAITCLIENT_JSON_TYPE_OBJECT)
-    return errno = EINVAL, -1;
+#define str(var, have)  ((have->type == LIBQWAITCLIENT_JSON_TYPE_NULL) ?	\
+			  (var = NULL, 0) :					\
+			  (var = libqwaitclient_json_steal_zstr(have), var == NULL))
   
-#define test(want)        ((strlen(want) == len) && !memcmp(name, want, len * sizeof(char)))
-#define str(var, have)    ((have->type == LIBQWAITCLIENT_JSON_TYPE_NULL) ?	\
-			    (var = NULL, 0) :					\
-			    (var = libqwaitclient_json_to_zstr(have), var == NULL))
-#define bool(var, have)   ((have->type != LIBQWAITCLIENT_JSON_TYPE_BOOLEAN) ?	\
-			   (var = 0, errno = EINVAL, 1) :			\
-			   (var = have->data.boolean, 0))
-#define strs(var_, have)  ((this->var_##_count = have->length,					\
-			    (this->var_##s = libqwaitclient_json_to_zstrs(have)) == NULL)	\
-			   ? (errno ? (this->var_##_count = 0, 1) : 0) : 0)
-  
-  /* Read information. */
-  for (i = 0; i < n; i++)
-    {
-      const libqwaitclient_json_t* restrict value = &(data->data.object[i].value);
-      char* name = data->data.object[i].name;
-      size_t len = data->data.object[i].name_length;
-      
-      if      (test("name"))             data_user_id   = value;
-      else if (test("readableName"))     data_real_name = value;
-      else if (test("admin"))            data_admin     = value;
-      else if (test("anonymous"))        data_anonymous = value;
-      else if (test("roles"))            data_roles     = value;
-      else if (test("queuePositions"))   data_queues    = value;
-      else if (test("ownedQueues"))      data_owned     = value;
-      else if (test("moderatedQueues"))  data_moderated = value;
-      else
-	goto einval;
-    }
-  
-  /* Check that everything was found. */
-  if (data_user_id   == NULL)  goto einval;
-  if (data_real_name == NULL)  goto einval;
-  if (data_admin     == NULL)  goto einval;
-  if (data_anonymous == NULL)  goto einval;
-  if (data_roles     == NULL)  goto einval;
-  if (data_queues    == NULL)  goto einval;
-  if (data_owned     == NULL)  goto einval;
-  if (data_moderated == NULL)  goto einval;
-  
-  /* Evaluate data. */
-  if ( str(this->user_id,         data_user_id))    goto fail;
-  if ( str(this->real_name,       data_real_name))  goto fail;
-  if (bool(this->admin,           data_admin))      goto fail;
-  if (bool(this->anonymous,       data_anonymous))  goto fail;
-  if (strs(      role,            data_roles))      goto fail;
-  if (strs(      owned_queue,     data_owned))      goto fail;
-  if (strs(      moderated_queue, data_moderated))  goto fail;
+  /* Read and evaluate information. */
+  if (libqwaitclient_json_schema_decode(this, user_fields, sizeof(user_fields) / sizeof(*user_fields),
+					data, deferred) < 0)
+    goto fail;
   
   /* Evaluate data for queue positions. */
+  data_queues = deferred[QUEUE_POSITIONS];
   if (data_queues->type != LIBQWAITCLIENT_JSON_TYPE_ARRAY)
     goto einval;
   if (xcalloc(this->positions, data_queues->length, libqwaitclient_qwait_position_t))  goto fail;
@@ -153,57 +163,22 @@ int libqwaitclient_qwait_user_parse(_this_, const libqwaitclient_json_t* restric
   this->queue_count = n = data_queues->length;
   for (i = 0; i < n; i++)
     {
-      const libqwaitclient_json_t* restrict data_location = NULL;
-      const libqwaitclient_json_t* restrict data_comment  = NULL;
-      const libqwaitclient_json_t* restrict data_queue    = NULL;
-      const libqwaitclient_json_t* restrict data_time     = NULL;
       libqwaitclient_qwait_position_t* restrict pos = this->positions + i;
-      libqwaitclient_json_association_t* restrict pos_data;
-      size_t j, m;
-      
-      if (data_queues->data.array[i].type != LIBQWAITCLIENT_JSON_TYPE_OBJECT)
-	goto einval;
-      pos_data = data_queues->data.array[i].data.object;
-      m        = data_queues->data.array[i].length;
       
       pos->user_id   = this->user_id;
       pos->real_name = this->real_name;
       
-      /* Read information. */
-      for (j = 0; j < m; j++)
-	{
-	  const libqwaitclient_json_t* restrict value = &(pos_data[j].value);
-	  char* name = pos_data[j].name;
-	  size_t len = pos_data[j].name_length;
-	  
-	  if      (test("location"))   data_location = value;
-	  else if (test("comment"))    data_comment  = value;
-	  else if (test("queueName"))  data_queue    = value;
-	  else if (test("startTime"))  data_time     = value;
-	  else
-	    goto einval;
-	}
-      
-      /* Check that everything was found. */
-      if (data_location == NULL)  goto einval;
-      if (data_comment  == NULL)  goto einval;
-      if (data_queue    == NULL)  goto einval;
-      if (data_time     == NULL)  goto einval;
-      
-      /* Evaluate data. */
-      if (str(pos->location,   data_location)) goto fail;
-      if (str(pos->comment,    data_comment))  goto fail;
-      if (str(this->queues[i], data_queue))    goto fail;
-      if (data_time->type != LIBQWAITCLIENT_JSON_TYPE_INTEGER)
-	goto einval;
-      pos->enter_time_seconds = (time_t)(data_time->data.integer / 1000);
-      pos->enter_time_mseconds   = (int)(data_time->data.integer % 1000);
+      /* Read and evaluate information. */
+      if (libqwaitclient_json_schema_decode(pos, position_fields,
+					    sizeof(position_fields) / sizeof(*position_fields),
+					    data_queues->data.array + i, deferred) < 0)
+	goto fail;
+      libqwaitclient_qwait_position_classify(pos, NULL);
+      if (str(this->queues[i], deferred[QUEUE_NAME]))
+	goto fail;
     }
   
-#undef strs
-#undef bool
 #undef str
-#undef test
   
   return 0;
   
@@ -216,6 +191,56 @@ int libqwaitclient_qwait_user_parse(_this_, const libqwaitclient_json_t* restric
 }
 
 
+/**
+ * Intern the queue ID:s in a user, so that they can be
+ * compared by pointer with other strings interned in
+ * the same table, and are not stored more than once
+ * 
+ * @param   this   The user
+ * @param   table  The table of interned strings, it must not
+ *                 be destroyed before the user
+ * @return         Zero on success, -1 on error, in which
+ *                 case the user is left unmodified
+ */
+int libqwaitclient_qwait_user_intern(_this_, libqwaitclient_intern_t* restrict table)
+{
+  size_t i;
+  
+  if (this->interned != NULL)
+    return this->interned == table ? 0 : (errno = EINVAL, -1);
+  
+  /* Make room for everything first, so that nothing can fail half-way. */
+  if (libqwaitclient_intern_reserve(table, this->owned_queue_count +
+				    this->moderated_queue_count + this->queue_count) < 0)
+    return -1;
+  
+  for (i = 0; i < this->owned_queue_count; i++)
+    this->owned_queues[i] = libqwaitclient_intern_adopt(table, this->owned_queues[i]);
+  for (i = 0; i < this->moderated_queue_count; i++)
+    this->moderated_queues[i] = libqwaitclient_intern_adopt(table, this->moderated_queues[i]);
+  for (i = 0; i < this->queue_count; i++)
+    if (this->queues[i] != NULL)
+      this->queues[i] = libqwaitclient_intern_adopt(table, this->queues[i]);
+  
+  this->interned = table;
+  return 0;
+}
+
+
+/**
+ * Get the user's ID as a string
+ * 
+ * @param   this    The user
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, `NULL` if the user ID is unknown
+ */
+char* libqwaitclient_qwait_user_get_user_id(const _this_, char* restrict buffer)
+{
+  return libqwaitclient_qwait_user_id_format(this->user_id, buffer);
+}
+
+
 /**
  * Print a user to a file for debugging
  * 
@@ -224,9 +249,11 @@ int libqwaitclient_qwait_user_parse(_this_, const libqwaitclient_json_t* restric
  */
 void libqwaitclient_qwait_user_dump(const _this_, FILE* output)
 {
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  const char* str_id = libqwaitclient_qwait_user_get_user_id(this, user_id);
   size_t i, n;
   
-  fprintf(output, "%s (%s)\n", this->real_name, this->user_id);
+  fprintf(output, "%s (%s)\n", this->real_name, str_id ? str_id : "(none)");
   fprintf(output, "  admin: %s\n",   this->admin     ? "yes" : "no");
   fprintf(output, "  anonymous: %s", this->anonymous ? "yes" : "no");
   
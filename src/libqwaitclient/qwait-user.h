@@ -21,6 +21,8 @@
 
 #include "json.h"
 #include "qwait-position.h"
+#include "qwait-user-id.h"
+#include "intern.h"
 
 #define _GNU_SOURCE
 #include <stddef.h>
@@ -32,9 +34,10 @@
 typedef struct libqwaitclient_qwait_user
 {
   /**
-   * The user's ID
+   * The user's ID, in packed form,
+   * `LIBQWAITCLIENT_QWAIT_USER_ID_NONE` if unknown
    */
-  char* user_id;
+  libqwaitclient_qwait_user_id_t user_id;
   
   /**
    * The user's name
@@ -106,6 +109,13 @@ typedef struct libqwaitclient_qwait_user
    */
   size_t queue_count;
   
+  /**
+   * The table of interned strings that owns the elements
+   * of `owned_queues`, `moderated_queues` and `queues`,
+   * `NULL` if they are owned by the user
+   */
+  libqwaitclient_intern_t* interned;
+  
 } libqwaitclient_qwait_user_t;
 
 
@@ -131,10 +141,33 @@ void libqwaitclient_qwait_user_destroy(_this_);
  * Contextually parses parsed JSON data into a user
  * 
  * @param   this  The user to fill in
- * @param   data  The data to parse
+ * @param   data  The data to parse, strings are taken out of it
  * @return        Zero on success, -1 on error
  */
-int libqwaitclient_qwait_user_parse(_this_, const libqwaitclient_json_t* restrict data);
+int libqwaitclient_qwait_user_parse(_this_, libqwaitclient_json_t* restrict data);
+
+/**
+ * Intern the queue ID:s in a user, so that they can be
+ * compared by pointer with other strings interned in
+ * the same table, and are not stored more than once
+ * 
+ * @param   this   The user
+ * @param   table  The table of interned strings, it must not
+ *                 be destroyed before the user
+ * @return         Zero on success, -1 on error, in which
+ *                 case the user is left unmodified
+ */
+int libqwaitclient_qwait_user_intern(_this_, libqwaitclient_intern_t* restrict table);
+
+/**
+ * Get the user's ID as a string
+ * 
+ * @param   this    The user
+ * @param   buffer  Output buffer for the user ID, must be at least
+ *                  `LIBQWAITCLIENT_QWAIT_USER_ID_SIZE` bytes large
+ * @return          `buffer`, `NULL` if the user ID is unknown
+ */
+char* libqwaitclient_qwait_user_get_user_id(const _this_, char* restrict buffer);
 
 /**
  * Print a user to a file for debugging
@@ -0,0 +1,323 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "timer-wheel.h"
+
+#include "macros.h"
+
+
+#define _this_  libqwaitclient_timer_wheel_t* restrict this
+
+#define LEVELS  LIBQWAITCLIENT_TIMER_WHEEL_LEVELS
+#define BITS    LIBQWAITCLIENT_TIMER_WHEEL_BITS
+#define SLOTS   LIBQWAITCLIENT_TIMER_WHEEL_SLOTS
+
+
+
+/**
+ * Insert a timer at the head of a list
+ * 
+ * @param  list   The list
+ * @param  timer  The timer
+ */
+static void link_timer(libqwaitclient_timer_t** restrict list, libqwaitclient_timer_t* restrict timer)
+{
+  timer->next = *list;
+  if (timer->next != NULL)
+    timer->next->pprev = &(timer->next);
+  *list = timer;
+  timer->pprev = list;
+}
+
+
+/**
+ * Remove a timer from the list it is in
+ * 
+ * @param  timer  The timer
+ */
+static void unlink_timer(libqwaitclient_timer_t* restrict timer)
+{
+  *(timer->pprev) = timer->next;
+  if (timer->next != NULL)
+    timer->next->pprev = timer->pprev;
+  timer->next = NULL;
+  timer->pprev = NULL;
+}
+
+
+/**
+ * Insert a timer in the slot for its expiry
+ * 
+ * @param  this   The timer wheel
+ * @param  timer  The timer, which must not be in any list
+ */
+static void insert(_this_, libqwaitclient_timer_t* restrict timer)
+{
+  uint64_t expires = timer->expires, delta;
+  size_t level;
+  
+  if (expires <= this->now)
+    {
+      link_timer(&(this->expired), timer);
+      return;
+    }
+  
+  /* Find the first level whose slots, combined, cover the expiry. */
+  delta = expires - this->now;
+  for (level = 0; level + 1 < LEVELS; level++)
+    if ((delta >> ((level + 1) * BITS)) == 0)
+      break;
+  
+  /* Timers beyond the last level wait in its farthest slot,
+     and are put back in the right place when it is reached. */
+  if ((delta >> (LEVELS * BITS)) != 0)
+    expires = this->now + ((uint64_t)1 << (LEVELS * BITS)) - 1;
+  
+  link_timer(&(this->slots[level][(expires >> (level * BITS)) & (SLOTS - 1)]), timer);
+}
+
+
+/**
+ * Get the number of ticks until the wheel reaches
+ * a slot that is not empty
+ * 
+ * @param   this  The timer wheel
+ * @return        The number of ticks, `UINT64_MAX` if all slots are empty
+ */
+static uint64_t __attribute__((pure)) next_event(const _this_)
+{
+  uint64_t best = UINT64_MAX, block, when;
+  size_t level, d;
+  
+  for (level = 0; level < LEVELS; level++)
+    {
+      /* Slots on higher levels are reached even later. */
+      block = this->now >> (level * BITS);
+      if (((block + 1) << (level * BITS)) - this->now >= best)
+	break;
+      
+      for (d = 1; d <= SLOTS; d++)
+	if (this->slots[level][(block + d) & (SLOTS - 1)] != NULL)
+	  {
+	    when = ((block + d) << (level * BITS)) - this->now;
+	    best = min(best, when);
+	    break;
+	  }
+    }
+  
+  return best;
+}
+
+
+/**
+ * Advance a timer wheel by one tick
+ * 
+ * @param  this  The timer wheel
+ */
+static void tick(_this_)
+{
+  libqwaitclient_timer_t** slot;
+  libqwaitclient_timer_t* timer;
+  size_t level;
+  
+  this->now++;
+  
+  /* Move timers down from the slots that are reached on higher levels, and then
+     move the timers in the slot for this tick, on the first level, to the expired. */
+  for (level = LEVELS; level--;)
+    if ((this->now & (((uint64_t)1 << (level * BITS)) - 1)) == 0)
+      {
+	slot = &(this->slots[level][(this->now >> (level * BITS)) & (SLOTS - 1)]);
+	while ((timer = *slot) != NULL)
+	  {
+	    unlink_timer(timer);
+	    insert(this, timer);
+	  }
+      }
+}
+
+
+
+/**
+ * Initialise a timer
+ * 
+ * @param  timer  The timer
+ * @param  data   Arbitrary data for the user of the timer
+ */
+void libqwaitclient_timer_initialise(libqwaitclient_timer_t* restrict timer, void* data)
+{
+  timer->next = NULL;
+  timer->pprev = NULL;
+  timer->expires = 0;
+  timer->data = data;
+}
+
+
+/**
+ * Check whether a timer is scheduled, or has expired
+ * but not been taken out of its wheel
+ * 
+ * @param   timer  The timer
+ * @return         1 if the timer is pending, 0 otherwise
+ */
+int libqwaitclient_timer_is_pending(const libqwaitclient_timer_t* restrict timer)
+{
+  return timer->pprev != NULL;
+}
+
+
+/**
+ * Cancel a timer, nothing is done if it is not pending
+ * 
+ * @param  this   The wheel the timer was scheduled in
+ * @param  timer  The timer
+ */
+void libqwaitclient_timer_wheel_cancel(_this_, libqwaitclient_timer_t* restrict timer)
+{
+  if (timer->pprev == NULL)
+    return;
+  unlink_timer(timer);
+  this->count--;
+}
+
+
+/**
+ * Initialise a timer wheel
+ * 
+ * @param  this  The timer wheel
+ * @param  now   The current tick
+ */
+void libqwaitclient_timer_wheel_initialise(_this_, uint64_t now)
+{
+  size_t level, i;
+  
+  this->now = now;
+  this->count = 0;
+  this->expired = NULL;
+  for (level = 0; level < LEVELS; level++)
+    for (i = 0; i < SLOTS; i++)
+      this->slots[level][i] = NULL;
+}
+
+
+/**
+ * Release all resources in a timer wheel, all
+ * timers in the wheel are cancelled
+ * 
+ * @param  this  The timer wheel
+ */
+void libqwaitclient_timer_wheel_destroy(_this_)
+{
+  size_t level, i;
+  
+  while (this->expired != NULL)
+    unlink_timer(this->expired);
+  for (level = 0; level < LEVELS; level++)
+    for (i = 0; i < SLOTS; i++)
+      while (this->slots[level][i] != NULL)
+	unlink_timer(this->slots[level][i]);
+  this->count = 0;
+}
+
+
+/**
+ * Schedule a timer, it is rescheduled if it is already pending
+ * 
+ * @param  this     The timer wheel
+ * @param  timer    The timer
+ * @param  expires  The tick at which the timer expires, if it is not
+ *                  after the current tick, the timer expires at once
+ */
+void libqwaitclient_timer_wheel_schedule(_this_, libqwaitclient_timer_t* restrict timer, uint64_t expires)
+{
+  if (timer->pprev == NULL)
+    this->count++;
+  else
+    unlink_timer(timer);
+  timer->expires = expires;
+  insert(this, timer);
+}
+
+
+/**
+ * Get the number of ticks until the wheel must be advanced,
+ * this is never later than when the next timer expires,
+ * but can be earlier if timers must be moved between levels
+ * 
+ * @param   this  The timer wheel
+ * @return        The number of ticks, zero if timers have expired,
+ *                `UINT64_MAX` if no timer is scheduled
+ */
+uint64_t libqwaitclient_timer_wheel_until_next(const _this_)
+{
+  return this->expired != NULL ? 0 : next_event(this);
+}
+
+
+/**
+ * Advance a timer wheel, timers that expire are
+ * made available to `libqwaitclient_timer_wheel_pop`
+ * 
+ * @param  this  The timer wheel
+ * @param  now   The current tick, nothing is done if it is
+ *               not after the tick the wheel is at
+ */
+void libqwaitclient_timer_wheel_advance(_this_, uint64_t now)
+{
+  uint64_t skip;
+  
+  while (this->now < now)
+    {
+      /* Jump over ticks where nothing happens. */
+      skip = next_event(this);
+      if (skip > now - this->now)
+	{
+	  this->now = now;
+	  break;
+	}
+      this->now += skip - 1;
+      tick(this);
+    }
+}
+
+
+/**
+ * Take out an expired timer from a timer wheel
+ * 
+ * @param   this  The timer wheel
+ * @return        An expired timer, which is no longer pending,
+ *                `NULL` if no more timers have expired
+ */
+libqwaitclient_timer_t* libqwaitclient_timer_wheel_pop(_this_)
+{
+  libqwaitclient_timer_t* timer = this->expired;
+  
+  if (timer != NULL)
+    {
+      unlink_timer(timer);
+      this->count--;
+    }
+  return timer;
+}
+
+
+
+#undef SLOTS
+#undef BITS
+#undef LEVELS
+#undef _this_
+
@@ -0,0 +1,200 @@
+/**
+ * qwait-clients — Non-web clients for QWait
+ * Copyright © 2014  Mattias Andrée (maandree@member.fsf.org)
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * 
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBQWAITCLIENT_TIMER_WHEEL_H
+#define LIBQWAITCLIENT_TIMER_WHEEL_H
+
+
+#define _GNU_SOURCE
+#include <stddef.h>
+#include <stdint.h>
+
+
+/**
+ * The number of levels in a timer wheel
+ */
+#define LIBQWAITCLIENT_TIMER_WHEEL_LEVELS  4
+
+/**
+ * The binary logarithm of the number of slots per level in a timer wheel
+ */
+#define LIBQWAITCLIENT_TIMER_WHEEL_BITS  6
+
+/**
+ * The number of slots per level in a timer wheel
+ */
+#define LIBQWAITCLIENT_TIMER_WHEEL_SLOTS  (1 << LIBQWAITCLIENT_TIMER_WHEEL_BITS)
+
+
+
+/**
+ * A timer, which is meant to be embedded in the
+ * structure of whatever it is a timer for
+ */
+typedef struct libqwaitclient_timer
+{
+  /**
+   * The next timer in the same slot (internal data)
+   */
+  struct libqwaitclient_timer* next;
+  
+  /**
+   * The pointer that points to this timer, `NULL` if
+   * the timer is not scheduled (internal data)
+   */
+  struct libqwaitclient_timer** pprev;
+  
+  /**
+   * The tick at which the timer expires
+   */
+  uint64_t expires;
+  
+  /**
+   * Arbitrary data for the user of the timer
+   */
+  void* data;
+  
+} libqwaitclient_timer_t;
+
+
+/**
+ * A hierarchical timer wheel, the time is measured in ticks,
+ * whose length is up to the user, typically milliseconds
+ * 
+ * Timers that expire within `LIBQWAITCLIENT_TIMER_WHEEL_SLOTS` ticks
+ * are stored in the slot for their tick on the first level, those that
+ * expire later are stored on the level with coarse enough slots, and
+ * are moved down a level when the wheel reaches their slot; thus
+ * scheduling and cancelling timers are constant-time operations
+ */
+typedef struct libqwaitclient_timer_wheel
+{
+  /**
+   * The current tick
+   */
+  uint64_t now;
+  
+  /**
+   * The number of scheduled timers
+   */
+  size_t count;
+  
+  /**
+   * Timers that have expired but have not
+   * been taken out of the wheel (internal data)
+   */
+  libqwaitclient_timer_t* expired;
+  
+  /**
+   * The slots of each level (internal data)
+   */
+  libqwaitclient_timer_t* slots[LIBQWAITCLIENT_TIMER_WHEEL_LEVELS][LIBQWAITCLIENT_TIMER_WHEEL_SLOTS];
+  
+} libqwaitclient_timer_wheel_t;
+
+
+
+#define _this_  libqwaitclient_timer_wheel_t* restrict this
+
+
+/**
+ * Initialise a timer
+ * 
+ * @param  timer  The timer
+ * @param  data   Arbitrary data for the user of the timer
+ */
+void libqwaitclient_timer_initialise(libqwaitclient_timer_t* restrict timer, void* data);
+
+/**
+ * Check whether a timer is scheduled, or has expired
+ * but not been taken out of its wheel
+ * 
+ * @param   timer  The timer
+ * @return         1 if the timer is pending, 0 otherwise
+ */
+int libqwaitclient_timer_is_pending(const libqwaitclient_timer_t* restrict timer) __attribute__((pure));
+
+/**
+ * Cancel a timer, nothing is done if it is not pending
+ * 
+ * @param  this   The wheel the timer was scheduled in
+ * @param  timer  The timer
+ */
+void libqwaitclient_timer_wheel_cancel(_this_, libqwaitclient_timer_t* restrict timer);
+
+/**
+ * Initialise a timer wheel
+ * 
+ * @param  this  The timer wheel
+ * @param  now   The current tick
+ */
+void libqwaitclient_timer_wheel_initialise(_this_, uint64_t now);
+
+/**
+ * Release all resources in a timer wheel, all
+ * timers in the wheel are cancelled
+ * 
+ * @param  this  The timer wheel
+ */
+void libqwaitclient_timer_wheel_destroy(_this_);
+
+/**
+ * Schedule a timer, it is rescheduled if it is already pending
+ * 
+ * @param  this     The timer wheel
+ * @param  timer    The timer
+ * @param  expires  The tick at which the timer expires, if it is not
+ *                  after the current tick, the timer expires at once
+ */
+void libqwaitclient_timer_wheel_schedule(_this_, libqwaitclient_timer_t* restrict timer, uint64_t expires);
+
+/**
+ * Get the number of ticks until the wheel must be advanced,
+ * this is never later than when the next timer expires,
+ * but can be earlier if timers must be moved between levels
+ * 
+ * @param   this  The timer wheel
+ * @return        The number of ticks, zero if timers have expired,
+ *                `UINT64_MAX` if no timer is scheduled
+ */
+uint64_t libqwaitclient_timer_wheel_until_next(const _this_) __attribute__((pure));
+
+/**
+ * Advance a timer wheel, timers that expire are
+ * made available to `libqwaitclient_timer_wheel_pop`
+ * 
+ * @param  this  The timer wheel
+ * @param  now   The current tick, nothing is done if it is
+ *               not after the tick the wheel is at
+ */
+void libqwaitclient_timer_wheel_advance(_this_, uint64_t now);
+
+/**
+ * Take out an expired timer from a timer wheel
+ * 
+ * @param   this  The timer wheel
+ * @return        An expired timer, which is no longer pending,
+ *                `NULL` if no more timers have expired
+ */
+libqwaitclient_timer_t* libqwaitclient_timer_wheel_pop(_this_);
+
+
+#undef _this_
+
+
+#endif
+
@@ -24,7 +24,6 @@
 #include <errno.h>
 #include <stdint.h>
 #include <sys/socket.h>
-#include <time.h>
 
 
 #define _this_ libqwaitclient_webmessage_t* restrict this
@@ -61,6 +60,15 @@ void libqwaitclient_webmessage_destroy(_this_)
 }
 
 
+/**
+ * Payloads of data frames that have at least this many bytes
+ * left are received directly into the content of the message,
+ * rather than through the read buffer
+ */
+#define DIRECT_RECEIVE_THRESHOLD  4096
+
+
+
 /**
  * Extend the read buffer by way of doubling
  * 
@@ -70,10 +78,114 @@ void libqwaitclient_webmessage_destroy(_this_)
 static int libqwaitclient_webmessage_extend_buffer(_this_)
 {
   char* new_buf = this->buffer;
-  if (xrealloc(new_buf, this->buffer_size << 1, char))
+  size_t new_size = this->buffer_size ? (this->buffer_size << 1) : 128;
+  if (xrealloc(new_buf, new_size, char))
       return -1;
   this->buffer = new_buf;
-  this->buffer_size <<= 1;
+  this->buffer_size = new_size;
+  return 0;
+}
+
+
+/**
+ * Make room in the content for the payload of a data frame,
+ * the allocation is grown geometrically
+ * 
+ * @param   this  The message
+ * @param   size  The size of the payload
+ * @return        Zero on success, -1 on error
+ */
+static int extend_content(_this_, size_t size)
+{
+  char* new_content = this->content;
+  size_t new_alloc = this->content_alloc;
+  
+  if (size > SIZE_MAX - this->content_size)
+    return errno = ENOMEM, -1;
+  if (this->content_size + size <= this->content_alloc)
+    return 0;
+  
+  new_alloc = max(new_alloc << 1, this->content_size + size);
+  if (xrealloc(new_content, new_alloc, char))
+    return -1;
+  this->content = new_content;
+  this->content_alloc = new_alloc;
+  return 0;
+}
+
+
+/**
+ * XOR data with a masking key, 32 bytes at a time, with the key
+ * broadcasted to a 64-bit word, before the remainder is masked
+ * byte by byte; the words are accessed with `memcpy`, so the data
+ * need not be aligned, and the compiler is free to vectorise
+ * 
+ * @param  output  Output buffer for the masked data, may be `input`
+ * @param  input   The data to mask
+ * @param  length  The length of `input`
+ * @param  mask    The masking key
+ * @param  offset  The position of `input` in its payload
+ */
+static void mask_data(char* output, const char* input, size_t length,
+		      const unsigned char mask[4], size_t offset)
+{
+  unsigned char key[8];
+  uint64_t k, w[4];
+  size_t i, j;
+  
+  /* Rotate the key to the offset, and broadcast it. */
+  for (i = 0; i < 8; i++)
+    key[i] = mask[(offset + i) & 3];
+  memcpy(&k, key, sizeof(k));
+  
+  for (i = 0; i + 32 <= length; i += 32)
+    {
+      memcpy(w, input + i, sizeof(w));
+      for (j = 0; j < 4; j++)
+	w[j] ^= k;
+      memcpy(output + i, w, sizeof(w));
+    }
+  for (; i + 8 <= length; i += 8)
+    {
+      memcpy(w, input + i, sizeof(*w));
+      *w ^= k;
+      memcpy(output + i, w, sizeof(*w));
+    }
+  for (; i < length; i++)
+    output[i] = input[i] ^ (char)(key[i & 7]);
+}
+
+
+/**
+ * Remove the masking from received payload data
+ * 
+ * @param  this    The message
+ * @param  data    The data
+ * @param  length  The length of `data`
+ */
+static void unmask(const _this_, char* restrict data, size_t length)
+{
+  if (this->frame_masked)
+    mask_data(data, data, length, this->frame_mask, this->frame_ptr);
+}
+
+
+/**
+ * Handle the result of a `recv` call
+ * 
+ * @param   got  The return value of `recv`, `errno` must have
+ *               been set to zero before `recv` was called
+ * @return       Zero on success, -1 on error
+ */
+static int check_received(ssize_t got)
+{
+  if (errno)
+    return -1;
+  if (got == 0)
+    {
+      errno = ECONNRESET;
+      return -1;
+    }
   return 0;
 }
 
@@ -91,6 +203,15 @@ static int continue_read(_this_, int fd)
   ssize_t got;
   int r;
   
+  /* Drop what has already been parsed. Payloads are consumed as soon as
+     they are available, so at most a partial frame header is moved here. */
+  if (this->buffer_head > 0)
+    {
+      this->buffer_ptr -= this->buffer_head;
+      memmove(this->buffer, this->buffer + this->buffer_head, this->buffer_ptr * sizeof(char));
+      this->buffer_head = 0;
+    }
+  
   /* Figure out how much space we have left in the read buffer. */
   n = this->buffer_size - this->buffer_ptr;
   
@@ -108,165 +229,247 @@ static int continue_read(_this_, int fd)
   errno = 0;
   got = recv(fd, this->buffer + this->buffer_ptr, n, 0);
   this->buffer_ptr += (size_t)(got < 0 ? 0 : got);
-  if (errno)
-    return -1;
-  if (got == 0)
+  return check_received(got);
+}
+
+
+/**
+ * Read the rest of the payload of a data frame from the socket
+ * directly into the content, the read buffer must be empty
+ * 
+ * @param   this  The message
+ * @param   fd    The file descriptor of the socket
+ * @return        The return value follows the rules of `libqwaitclient_webmessage_read`
+ */
+static int receive_directly(_this_, int fd)
+{
+  char* data = this->content + this->content_size;
+  ssize_t got;
+  
+  errno = 0;
+  got = recv(fd, data, this->frame_size - this->frame_ptr, 0);
+  if (got > 0)
     {
-      errno = ECONNRESET;
-      return -1;
+      unmask(this, data, (size_t)got);
+      this->content_size += (size_t)got;
+      this->frame_ptr += (size_t)got;
     }
-  
-  return 0;
+  return check_received(got);
 }
 
 
 /**
- * Reset the header list and the content
+ * Parse the header of a frame in the read buffer
  * 
- * @param  this  The message
+ * @param   this  The message
+ * @return        1 if the header was parsed, 0 if more data is
+ *                required, otherwise the return value follows the
+ *                rules of `libqwaitclient_webmessage_read`
  */
-static void reset_message(_this_)
+static int parse_header(_this_)
 {
-  free(this->content);
-  this->content = NULL;
-  this->content_size = 0;
-  this->content_ptr = 0;
+  const unsigned char* data = (const unsigned char*)(this->buffer + this->buffer_head);
+  size_t i, n = 2, available = this->buffer_ptr - this->buffer_head;
+  uint64_t size;
+  int opcode, final;
+  
+  /* Do we have the whole header? */
+  if (available < 2)
+    return 0;
+  if ((data[1] & 127) == 126)  n += 2;
+  if ((data[1] & 127) == 127)  n += 8;
+  if ((data[1] & 128) == 128)  n += 4;
+  if (available < n)
+    return 0;
+  
+  /* Parse the FIN-bit and the opcode. The only extension we may have
+     negotiated is permessage-deflate, which marks the first frame of
+     compressed data messages with the RSV1-bit. */
+  final  = ((data[0] & 0x80) == 0x80);
+  opcode = (data[0] & 0x0F);
+  if (data[0] & 0x70)
+    if (((data[0] & 0x70) != 0x40) || !(this->permessage_deflate) || (opcode == 0) || (opcode >= 8))
+      return -2;
+  
+  /* Parse the payload length, which is in network byte order. */
+  size = (uint64_t)(data[1] & 127);
+  if (size >= 126)
+    for (size = 0, i = 2; i < ((data[1] & 127) == 126 ? 4 : 10); i++)
+      size = (size << 8) | (uint64_t)(data[i]);
+  if ((size >> 63) || ((uint64_t)(size_t)size != size))
+    return -2;
+  
+  /* Continuation frames must continue a message, data frames
+     must not, and control frames must be small and unfragmented. */
+  switch (opcode)
+    {
+    case 0:
+      if (this->message_opcode == 0)
+	return -2;
+      break;
+    case 1:
+    case 2:
+      if (this->message_opcode != 0)
+	return -2;
+      break;
+    case 8:
+    case 9:
+    case 10:
+      if ((final == 0) || (size > LIBQWAITCLIENT_WEBMESSAGE_CONTROL_MAX))
+	return -2;
+      break;
+    default:
+      return -2;
+    }
+  
+  /* Make room for the payload, but do not trust the declared
+     length with more memory than a message is allowed to use. */
+  if ((opcode < 8) && ((size > LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE) ||
+			(this->content_size > LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE - size)))
+    return -2;
+  if ((opcode < 8) && extend_content(this, (size_t)size))
+    return -1;
+  if (opcode < 8)
+    this->message_opcode = opcode ? opcode : this->message_opcode;
+  if ((opcode == 1) || (opcode == 2))
+    this->compressed = ((data[0] & 0x40) == 0x40);
+  
+  /* Store the frame's metadata, and consume the header. */
+  this->frame_size   = (size_t)size;
+  this->frame_ptr    = 0;
+  this->frame_opcode = opcode;
+  this->frame_final  = final;
+  this->frame_masked = ((data[1] & 128) == 128);
+  if (this->frame_masked)
+    memcpy(this->frame_mask, data + n - 4, 4 * sizeof(char));
+  this->buffer_head += n;
+  
+  /* Mark end of stage, next stage is acquiring the payload. */
+  this->stage = 1;
+  return 1;
 }
 
 
 /**
- * Receive a part of the payload
+ * Consume as much of the payload of a frame
+ * as is available in the read buffer
  * 
- * @param   this  Memory slot in which to store the new fragment
- * @return        Follows the rules of `libqwaitclient_webmessage_read`
- *                with one exception, if zero is returned the message
- *                has not been completely read, if 1 is returned the
- *                message has been completely read
+ * @param   this  The message
+ * @return        1 if a message or control frame is complete,
+ *                zero otherwise
  */
-static int receive_known_length(_this_)
+static int parse_payload(_this_)
 {
-  if (this->content_size > 0)
+  size_t available = this->buffer_ptr - this->buffer_head;
+  size_t n = min(available, this->frame_size - this->frame_ptr);
+  char* data;
+  
+  /* Control frames are stored aside, so interleaved
+     control frames do not disturb a data message. */
+  if (this->frame_opcode >= 8)
+    data = this->control + this->frame_ptr;
+  else
+    data = this->content + this->content_size, this->content_size += n;
+  
+  /* Copy what we have, and unmask it. */
+  if (n > 0)
     {
-      /* How much of the content that has not yet been filled. */
-      size_t need = this->content_size - this->content_ptr;
-      /* How much we have of that what is needed. */
-      size_t move = min(this->buffer_ptr, need);
-      
-      /* Copy what we have, and remove it from the the read buffer. */
-      memcpy(this->content + this->content_ptr, this->buffer, move * sizeof(char));
-      this->buffer_ptr -= move;
-      memmove(this->buffer, this->buffer + move, this->buffer_ptr * sizeof(char));
-      
-      /* Keep track of how much we have read. */
-      this->content_ptr += move;
+      memcpy(data, this->buffer + this->buffer_head, n * sizeof(char));
+      unmask(this, data, n);
+      this->buffer_head += n;
+      this->frame_ptr += n;
+    }
+  
+  if (this->frame_ptr < this->frame_size)
+    return 0;
+  
+  /* The frame is complete, start on the next frame. */
+  this->stage = 0;
+  if (this->frame_opcode >= 8)
+    {
+      this->control_size = this->frame_size;
+      this->opcode = this->frame_opcode;
     }
-  if (this->content_ptr == this->content_size)
+  else if (this->frame_final)
     {
-      /* If we have filled the content (or there was no content),
-	 mark the end of this stage, i.e. that the message is
-	 complete, and return with success. */
-      this->stage = 3;
-      return 1;
+      this->opcode = this->message_opcode;
+      this->message_opcode = 0;
+      this->stage = 2;
+    }
+  else
+    return 0;
+  
+  this->final = 1;
+  return 1;
+}
+
+
+/**
+ * Parse as much as possible of the read buffer
+ * 
+ * @param   this  The message
+ * @return        1 if a message or control frame is complete, 0 if more data
+ *                is required, otherwise the return value follows the rules
+ *                of `libqwaitclient_webmessage_read`
+ */
+static int parse_buffer(_this_)
+{
+  int r;
+  
+  for (;;)
+    {
+      if ((this->stage == 0) && ((r = parse_header(this)) <= 0))
+	return r;
+      if ((r = parse_payload(this)) || (this->stage == 1))
+	return r;
     }
-  return 0;
 }
 
 
 /**
- * Read the next fragment from a file descriptor
+ * Read the next message, or control frame, from a file descriptor,
+ * fragmented messages are reassembled
  * 
- * @param   this  Memory slot in which to store the new fragment
+ * @param   this  Memory slot in which to store the new message
  * @param   fd    The file descriptor
  * @return        Non-zero on error or interruption, errno will be
  *                set accordingly. Destroy the message on error,
  *                be aware that the reading could have been
  *                interrupted by a signal rather than canonical error.
  *                If -2 is returned errno will not have been set,
- *                -2 indicates that the message is malformated,
+ *                -2 indicates that the message is malformated, or
+ *                larger than `LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE`,
  *                which is a state that cannot be recovered from.
  */
 int libqwaitclient_webmessage_read(_this_, int fd)
 {
   int r;
   
-  /* If we are at stage 3, we are done and it is time to start over.
+  /* If we are at stage 2, we are done and it is time to start over,
+     the content allocation is kept for the next message.
      This is important because the function could have been interrupted. */
-  if (this->stage == 3)
+  if (this->stage == 2)
     {
-      reset_message(this);
+      this->content_size = 0;
       this->stage = 0;
     }
   
-  /* Read from file descriptor until we have a full fragment. */
+  /* Read from file descriptor until we have a full message or control frame. */
   for (;;)
     {
-      /* Stage 0: Read fragment metadata. */
-      if ((this->stage == 0) && (this->buffer_ptr >= 1))
-	{
-	  /* Parse the read byte. */
-	  this->final  = ((this->buffer[0] & 0x80) == 0x80);
-	  this->opcode = (this->buffer[0] & 0x0F);
-	  
-	  /* Remove the read byte from the buffer. */
-	  memmove(this->buffer, this->buffer + 1, --(this->buffer_ptr) * sizeof(char));
-	  
-	  /* Mark end of stage, next stage is acquiring the payload length. */
-	  this->stage++;
-	}
+      if ((r = parse_buffer(this)))
+	return r < 0 ? r : 0;
       
-      
-      /* Stage 1: Acquire payload length. */
-      if ((this->stage == 1) && (this->buffer_ptr > 0))
+      /* Large payloads skip the read buffer. */
+      if ((this->stage == 1) && (this->frame_opcode < 8) && (this->buffer_head == this->buffer_ptr) &&
+	  (this->frame_size - this->frame_ptr >= DIRECT_RECEIVE_THRESHOLD))
 	{
-	  /* How any bytes do we need to determine the payload length? */
-	  size_t i, needed_bytes = 1;
-	  if (this->buffer[0] == (char)126)  needed_bytes += 2;
-	  if (this->buffer[0] == (char)127)  needed_bytes += 8;
-	  
-	  /* Do we have what it takes? */
-	  if (this->buffer_ptr < needed_bytes)
-	    goto need_more;
-	  
-	  /* How long is the payload? */
-	  if (needed_bytes == 1)
-	    this->content_size = (size_t)(this->buffer[0]);
-	  else
-	    for (this->content_size = 0, i = needed_bytes; i > 0; i--)
-	      {
-		this->content_size <<= 8;
-		this->content_size |= (size_t)(unsigned char)(this->buffer[i - 1]);
-	      }
-	  
-	  /* Allocate buffer for the payload. */
-	  if (xmalloc(this->content, this->content_size, char))
-	    return -1;
-	  
-	  /* Remove the read bytes from the buffer. */
-	  this->buffer_ptr -= needed_bytes;
-	  memmove(this->buffer, this->buffer + needed_bytes, this->buffer_ptr * sizeof(char));
-	  
-	  /* Mark end of stage, next stage is acquiring the payload. */
-	  this->stage++;
+	  this->buffer_head = this->buffer_ptr = 0;
+	  try (receive_directly(this, fd));
 	}
-      
-      
-      /* Stage 2: Acquire the payload. */
-      r = 0;
-      if (this->stage == 2)
-	r = receive_known_length(this);
-      if (r)
-	return r < 0 ? r : (r - 1);
-      
-      
-      /* If we did not enter stage 3. */
-    need_more:
-      
-      /* Continue reading from the socket into the buffer. */
-      try (continue_read(this, fd));
+      else
+	try (continue_read(this, fd));
     }
-  
-  (void) fd;
-  return 0;
 }
 
 
@@ -290,59 +493,31 @@ size_t libqwaitclient_webmessage_compose_size(const _this_)
  * Marshal a message for communication
  * 
  * @param  this  The message
+ * @param  mask  The masking key, which shall be unpredictable
  * @param  data  Output buffer for the marshalled data
  */
-void libqwaitclient_webmessage_compose(const _this_, char* restrict data)
+void libqwaitclient_webmessage_compose(const _this_, const unsigned char mask[4], char* restrict data)
 {
-  static int seeded = 0;
   int size_byte = 0;
-  uint32_t random_int = 0;
-  char* random_chars;
   size_t i;
   
-  /* Select mask. */
-  if (!seeded)
-    {
-      i = (size_t)time(NULL) ^ (size_t)(void*)data ^ (size_t)(const void*)this;
-      srandom((unsigned int)i);
-      seeded = 1;
-    }
-  random_int = (uint32_t)random(); /* returns long int, so at least 32 bits. */
-  random_chars = (char*)(&random_int);
-  
-  /* Write FIN-bit, opcode, mask-bit and payload length. */
+  /* Write FIN-bit, RSV1-bit, opcode, mask-bit and payload length. */
   if (this->content_size > 125)
     size_byte = (this->content_size >= (size_t)(1L << 16)) ? 127 : 126;
-  *data++ = (char)((this->final ? 0x80 : 0x00) | this->opcode);
+  *data++ = (char)((this->final ? 0x80 : 0x00) | (this->compressed ? 0x40 : 0x00) | this->opcode);
   *data++ = (char)((size_byte ? size_byte : (int)(this->content_size)) | 0x80);
-  if (size_byte >= 126)
-    {
-      *data++ = (char)((this->content_size >> 0) & 255);
-      *data++ = (char)((this->content_size >> 8) & 255);
-    }
-  if (size_byte == 127)
-    {
-      *data++ = (char)((this->content_size >> 16) & 255);
-      *data++ = (char)((this->content_size >> 24) & 255);
-      *data++ = (char)((this->content_size >> 32) & 255);
-      *data++ = (char)((this->content_size >> 40) & 255);
-      *data++ = (char)((this->content_size >> 48) & 255);
-      *data++ = (char)((this->content_size >> 56) & 255);
-    }
+  
+  /* The extended payload length is in network byte order. */
+  if (size_byte)
+    for (i = (size_byte == 127 ? 8 : 2); i--;)
+      *data++ = (char)(((uint64_t)(this->content_size) >> (8 * i)) & 255);
   
   /* Copy mask. */
-  *(uint32_t*)data = random_int;
+  memcpy(data, mask, 4 * sizeof(char));
   data += 4;
   
-  /* Copy payload. */
-  memcpy(data, this->content, this->content_size * sizeof(char));
-
-  /* Mask payload. */
-  for (i = 0; i < this->content_size; i += 4)
-    *(uint32_t*)data ^= random_int, data += 4;
-  if (i > this->content_size)
-    for (i -= 4; i < this->content_size; i++)
-      data[i] ^= random_chars[i];
+  /* Copy and mask payload. */
+  mask_data(data, this->content, this->content_size, mask, 0);
 }
 
 
@@ -26,6 +26,18 @@
 /* Note: This is for client-side WebSocket:s only, and its uses lax rules. */
 
 
+/**
+ * The maximum payload size of a control frame
+ */
+#define LIBQWAITCLIENT_WEBMESSAGE_CONTROL_MAX  125
+
+/**
+ * The maximum size of the content of a received message,
+ * messages that would be larger are rejected as malformated
+ */
+#define LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE  (16UL << 20)
+
+
 /**
  * Message passed between the server and the client over a websocket
  */
@@ -33,6 +45,9 @@ typedef struct libqwaitclient_webmessage
 {
   /**
    * The content of the message, `NULL` if none (of zero-length)
+   * 
+   * When a message is received, this is the reassembled content
+   * of all of its fragments, and it is reused for the next message
    */
   char* content;
   
@@ -42,9 +57,9 @@ typedef struct libqwaitclient_webmessage
   size_t content_size;
   
   /**
-   * How much of the content that has been stored (internal data)
+   * The size allocated to `content`, only used when receiving (internal data)
    */
-  size_t content_ptr;
+  size_t content_alloc;
   
   /**
    * Internal buffer for the reading function (internal data)
@@ -61,28 +76,79 @@ typedef struct libqwaitclient_webmessage
    */
   size_t buffer_ptr;
   
+  /**
+   * The number of bytes at the beginning of `buffer`
+   * that have already been parsed (internal data)
+   */
+  size_t buffer_head;
+  
+  /**
+   * The size of the payload of the current frame (internal data)
+   */
+  size_t frame_size;
+  
+  /**
+   * How much of the payload of the current frame
+   * that has been stored (internal data)
+   */
+  size_t frame_ptr;
+  
+  /**
+   * The opcode of the current frame (internal data)
+   */
+  int frame_opcode;
+  
+  /**
+   * Whether the current frame is the final
+   * fragment of its message (internal data)
+   */
+  int frame_final;
+  
+  /**
+   * Whether the current frame is masked (internal data)
+   */
+  int frame_masked;
+  
+  /**
+   * The masking key of the current frame (internal data)
+   */
+  unsigned char frame_mask[4];
+  
+  /**
+   * The opcode of the data message that is being
+   * reassembled, zero if none is (internal data)
+   */
+  int message_opcode;
+  
+  /**
+   * Whether the permessage-deflate extension has been negotiated,
+   * in which case received data messages may be compressed
+   */
+  int permessage_deflate;
+  
   /**
    * The parsring stage (internal data)
    * 
-   * - 0: Acquire the first byte of the message
-   * - 1: Acquire the length of the payload
-   * - 2: Acquire the payload
-   * - 3: Done, reset and start on next fragment
-   * 
-   * The step if acquiring the mask is omitted
-   * because we assume (since we are receiving
-   * a message from a server) that their is no
-   * mask.
+   * - 0: Acquire the header of a frame
+   * - 1: Acquire the payload of a frame
+   * - 2: Done, reset and start on next message
    */
   int stage;
   
   /**
-   * Whether this is the final fragment in a frame
+   * Whether this is the final fragment in a message,
+   * always set for received messages
    */
   int final;
   
   /**
-   * The opcode for the frame
+   * Whether the content is compressed with permessage-deflate,
+   * received messages are decompressed by the websocket
+   */
+  int compressed;
+  
+  /**
+   * The opcode for the message
    * 
    * - 0:  Continuation frame
    * - 1:  Text frame
@@ -90,9 +156,24 @@ typedef struct libqwaitclient_webmessage
    * - 8:  Close connection
    * - 9:  Ping frame (heartbeat)
    * - 10: Pong frame (heartbeat response)
+   * 
+   * If a control frame (8, 9 or 10) is received, its
+   * payload is stored in `control` rather than in
+   * `content`, so that a data message that is being
+   * reassembled is left untouched
    */
   int opcode;
   
+  /**
+   * The payload of the last received control frame
+   */
+  char control[LIBQWAITCLIENT_WEBMESSAGE_CONTROL_MAX];
+  
+  /**
+   * The size of the payload in `control`
+   */
+  size_t control_size;
+  
 } libqwaitclient_webmessage_t;
 
 
@@ -115,16 +196,18 @@ void libqwaitclient_webmessage_zero_initialise(_this_);
 void libqwaitclient_webmessage_destroy(_this_);
 
 /**
- * Read the next fragment from a file descriptor
+ * Read the next message, or control frame, from a file descriptor,
+ * fragmented messages are reassembled
  * 
- * @param   this  Memory slot in which to store the new fragment
+ * @param   this  Memory slot in which to store the new message
  * @param   fd    The file descriptor
  * @return        Non-zero on error or interruption, errno will be
  *                set accordingly. Destroy the message on error,
  *                be aware that the reading could have been
  *                interrupted by a signal rather than canonical error.
  *                If -2 is returned errno will not have been set,
- *                -2 indicates that the message is malformated,
+ *                -2 indicates that the message is malformated, or
+ *                larger than `LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE`,
  *                which is a state that cannot be recovered from.
  */
 int libqwaitclient_webmessage_read(_this_, int fd);
@@ -142,9 +225,10 @@ size_t libqwaitclient_webmessage_compose_size(const _this_) __attribute__((pure)
  * Marshal a message for communication
  * 
  * @param  this  The message
+ * @param  mask  The masking key, which shall be unpredictable
  * @param  data  Output buffer for the marshalled data
  */
-void libqwaitclient_webmessage_compose(const _this_, char* restrict data);
+void libqwaitclient_webmessage_compose(const _this_, const unsigned char mask[4], char* restrict data);
 
 
 #undef _this_
@@ -21,15 +21,280 @@
 
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/random.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
 #include <errno.h>
 
+#ifdef USE_ZLIB
+# define ZLIB_CONST
+# include <zlib.h>
+#endif
+
 
 #define _this_         libqwaitclient_websocket_t* restrict this
 #define _http_socket_  libqwaitclient_http_socket_t* restrict http_socket
 
 
 
+/**
+ * The GUID that is appended to the key in the
+ * handshake to calculate the accept value, RFC 6455
+ */
+#define WEBSOCKET_GUID  "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+/**
+ * The number of random bytes in a handshake key
+ */
+#define WEBSOCKET_KEY_SIZE  16
+
+/**
+ * The length of the base64 encoding of `WEBSOCKET_KEY_SIZE` bytes
+ */
+#define WEBSOCKET_KEY_LENGTH  24
+
+/**
+ * The length of the base64 encoding of a SHA-1 digest
+ */
+#define WEBSOCKET_ACCEPT_LENGTH  28
+
+/**
+ * Data messages smaller than this are not worth
+ * compressing with permessage-deflate
+ */
+#define DEFLATE_THRESHOLD  64
+
+
+
+/**
+ * Rotate a 32-bit integer to the left
+ * 
+ * @param   x:uint32_t  The integer
+ * @param   n:int       The number of bits to rotate by, in [1, 31]
+ * @return  :uint32_t   The rotated integer
+ */
+#define rol32(x, n)  \
+  (((x) << (n)) | ((x) >> (32 - (n))))
+
+
+/**
+ * Calculate the SHA-1 digest of a message, this is only
+ * used to verify the handshake, and is not meant to be secure
+ * 
+ * @param  message  The message
+ * @param  length   The length of `message`
+ * @param  digest   Output buffer for the digest
+ */
+static void sha1(const char* restrict message, size_t length, unsigned char digest[20])
+{
+  uint32_t h[5] = { 0x67452301UL, 0xEFCDAB89UL, 0x98BADCFEUL, 0x10325476UL, 0xC3D2E1F0UL };
+  uint32_t w[80], a, b, c, d, e, f, k, t;
+  unsigned char block[64];
+  size_t i, j, n, blocks = (length + 8) / 64 + 1;
+  uint64_t bits = (uint64_t)length * 8;
+  
+  for (n = 0; n < blocks; n++)
+    {
+      /* Fetch the block, padding it at the end of the message. */
+      for (i = 0; i < 64; i++)
+	{
+	  j = n * 64 + i;
+	  if      (j <  length)  block[i] = (unsigned char)(message[j]);
+	  else if (j == length)  block[i] = 0x80;
+	  else                   block[i] = 0;
+	}
+      if (n + 1 == blocks)
+	for (i = 0; i < 8; i++)
+	  block[63 - i] = (unsigned char)(bits >> (8 * i));
+      
+      /* Expand the block. */
+      for (i = 0; i < 16; i++)
+	w[i] = ((uint32_t)(block[4 * i + 0]) << 24) | ((uint32_t)(block[4 * i + 1]) << 16) |
+	       ((uint32_t)(block[4 * i + 2]) <<  8) | ((uint32_t)(block[4 * i + 3]) <<  0);
+      for (; i < 80; i++)
+	t = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], w[i] = rol32(t, 1);
+      
+      /* Compress the block. */
+      a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+      for (i = 0; i < 80; i++)
+	{
+	  if      (i < 20)  f = (b & c) | (~b & d),           k = 0x5A827999UL;
+	  else if (i < 40)  f = b ^ c ^ d,                    k = 0x6ED9EBA1UL;
+	  else if (i < 60)  f = (b & c) | (b & d) | (c & d),  k = 0x8F1BBCDCUL;
+	  else              f = b ^ c ^ d,                    k = 0xCA62C1D6UL;
+	  t = rol32(a, 5) + f + e + k + w[i];
+	  e = d, d = c, c = rol32(b, 30), b = a, a = t;
+	}
+      h[0] += a, h[1] += b, h[2] += c, h[3] += d, h[4] += e;
+    }
+  
+  for (i = 0; i < 20; i++)
+    digest[i] = (unsigned char)(h[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+
+/**
+ * Encode data with base64
+ * 
+ * @param  data    The data
+ * @param  length  The length of `data`
+ * @param  buffer  Output buffer for the NUL-terminated encoding,
+ *                 must be at least `(length + 2) / 3 * 4 + 1` bytes large
+ */
+static void base64(const unsigned char* restrict data, size_t length, char* restrict buffer)
+{
+  static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t i;
+  uint32_t v;
+  
+  for (i = 0; i < length; i += 3)
+    {
+      v  = (uint32_t)(data[i]) << 16;
+      v |= i + 1 < length ? (uint32_t)(data[i + 1]) << 8 : 0;
+      v |= i + 2 < length ? (uint32_t)(data[i + 2]) << 0 : 0;
+      *buffer++ = digits[(v >> 18) & 63];
+      *buffer++ = digits[(v >> 12) & 63];
+      *buffer++ = i + 1 < length ? digits[(v >> 6) & 63] : '=';
+      *buffer++ = i + 2 < length ? digits[(v >> 0) & 63] : '=';
+    }
+  *buffer = '\0';
+}
+
+
+/**
+ * Fill a buffer with random bytes
+ * 
+ * @param   buffer  The buffer
+ * @param   size    The size of `buffer`
+ * @return          Zero on success, -1 on error
+ */
+static int random_bytes(void* restrict buffer, size_t size)
+{
+  char* restrict p = buffer;
+  ssize_t got;
+  
+  while (size > 0)
+    {
+      if ((got = getrandom(p, size, 0)) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return -1;
+	}
+      p += got, size -= (size_t)got;
+    }
+  
+  return 0;
+}
+
+
+/**
+ * Find the value of a header in a message, the
+ * name of the header is compared case-insensitively
+ * 
+ * @param   message  The message
+ * @param   name     The name of the header, without the colon
+ * @return           The value of the header, `NULL` if missing
+ */
+static const char* __attribute__((pure)) get_header(const libqwaitclient_http_message_t* restrict message,
+						     const char* restrict name)
+{
+  size_t i, n = strlen(name);
+  const char* header;
+  
+  for (i = 0; i < message->header_count; i++)
+    {
+      header = message->headers[i];
+      if (strncasecmp(header, name, n) || (header[n] != ':'))
+	continue;
+      for (header += n + 1; *header == ' '; header++);
+      return header;
+    }
+  
+  return NULL;
+}
+
+
+/**
+ * Parse the value of the Sec-WebSocket-Extensions header
+ * in the server's response to the handshake
+ * 
+ * Only permessage-deflate is ever offered, with no parameters,
+ * so the server may only agree to it and limit its own window
+ * or choose to not use context takeover
+ * 
+ * @param   value                       The value of the header
+ * @param   server_no_context_takeover  Output parameter for whether the server
+ *                                      resets its context after each message
+ * @param   client_no_context_takeover  Output parameter for whether we must
+ *                                      reset our context after each message
+ * @return                              1 if permessage-deflate was negotiated, 0 if no
+ *                                      extension was, -1 if the value is unacceptable
+ */
+static int parse_extensions(const char* restrict value, int* restrict server_no_context_takeover,
+			    int* restrict client_no_context_takeover)
+{
+#ifdef USE_ZLIB
+  size_t n;
+  unsigned bits;
+  int quoted;
+#endif
+
+#define skip_spaces()  while ((*value == ' ') || (*value == '\t'))  value++
+#define token(name)    (n = strlen(name), !strncasecmp(value, name, n) && strchr(";= \t", value[n]))
+
+  *server_no_context_takeover = *client_no_context_takeover = 0;
+  
+  skip_spaces();
+  if (*value == '\0')
+    return 0;
+
+#ifdef USE_ZLIB
+  if (!token("permessage-deflate"))
+    return -1;
+  for (value += n;; )
+    {
+      skip_spaces();
+      if (*value == '\0')
+	return 1;
+      if (*value++ != ';')
+	return -1;
+      skip_spaces();
+      
+      if (token("server_no_context_takeover"))
+	*server_no_context_takeover = 1, value += n;
+      else if (token("client_no_context_takeover"))
+	*client_no_context_takeover = 1, value += n;
+      else if (token("server_max_window_bits"))
+	{
+	  /* We can inflate with any window size, but it must be valid. */
+	  value += n;
+	  skip_spaces();
+	  if (*value++ != '=')
+	    return -1;
+	  skip_spaces();
+	  quoted = (*value == '"'), value += quoted;
+	  for (bits = 0; ('0' <= *value) && (*value <= '9') && (bits < 100); value++)
+	    bits = bits * 10 + (unsigned)(*value - '0');
+	  if ((bits < 8) || (15 < bits) || (quoted && (*value++ != '"')))
+	    return -1;
+	}
+      else
+	return -1;
+    }
+#else
+  return -1;
+#endif
+
+#undef token
+#undef skip_spaces
+}
+
+
 /**
  * Perform a websocket handshake over an HTTP socket
  * so `libqwaitclient_websocket_upgrade` may be used
@@ -38,12 +303,15 @@
  * @param   this  The HTTP socket
  * @param   bus   QWait uses "/bus/client" here
  * @return        Zero on success, -1 on error with `errno` set accordingly,
- *                -2 if an malformated message received, -3 if the handshake
- *                failed for some other reason
+ *                -2 if an malformated message received, -3 if the server
+ *                did not switch protocol or did not accept the key
+ * 
+ * If libqwaitclient is built with zlib, the permessage-deflate
+ * extension is offered, and what the server agreed to is picked
+ * up by `libqwaitclient_websocket_upgrade`
  */
 int libqwaitclient_websocket_handshake(_http_socket_, const char* restrict bus)
 {
-  /* TODO libqwaitclient_websocket_handshake */
   /*
     GET /bus/client/???/????????/websocket HTTP/1.1\r\n -- /???/???????? seems random
     Upgrade: websocket\r\n
@@ -59,12 +327,85 @@ int libqwaitclient_websocket_handshake(_http_socket_, const char* restrict bus)
     HTTP/1.1 101 Switching Protocols\r\n
     Upgrade: WebSocket\r\n -- sic!
     Connection: Upgrade\r\n
-    Sec-WebSocket-Accept: ????????????????????????????\r\n -- base64, ignorable
+    Sec-WebSocket-Accept: ????????????????????????????\r\n -- base64
     \r\n
    */
-  (void) http_socket;
-  (void) bus;
+  
+  static const char session_digits[] = "abcdefghijklmnopqrstuvwxyz0123456789";
+  libqwaitclient_http_message_t mesg;
+  unsigned char random[WEBSOCKET_KEY_SIZE + 2 + 8];
+  unsigned char digest[20];
+  char key[WEBSOCKET_KEY_LENGTH + sizeof(WEBSOCKET_GUID)];
+  char accept[WEBSOCKET_ACCEPT_LENGTH + 1];
+  char session[8 + 1];
+  const char* value;
+  size_t i;
+  int r, saved_errno, server_no_context_takeover, client_no_context_takeover;
+
+#define t(expression)  if (expression)  goto fail
+#define header(...)    t (asprintf(mesg.headers + mesg.header_count++, __VA_ARGS__) < 0)
+
+  libqwaitclient_http_message_zero_initialise(&mesg);
+  
+  /* Make the key, and the server and session ID:s, which the server does not care about. */
+  t (random_bytes(random, sizeof(random)));
+  base64(random, WEBSOCKET_KEY_SIZE, key);
+  for (i = 0; i < 8; i++)
+    session[i] = session_digits[random[WEBSOCKET_KEY_SIZE + 2 + i] % (sizeof(session_digits) - 1)];
+  session[8] = '\0';
+  
+  /* Send the request. */
+  t (asprintf(&(mesg.top), "GET %s/%03u/%s/websocket HTTP/1.1", bus,
+	      ((unsigned)(random[WEBSOCKET_KEY_SIZE]) << 8 | random[WEBSOCKET_KEY_SIZE + 1]) % 1000,
+	      session) < 0);
+  t (libqwaitclient_http_message_extend_headers(&mesg, 9) < 0);
+  header("Upgrade: websocket");
+  header("Connection: Upgrade");
+  header("Host: %s", http_socket->host);
+  header("Origin: http://%s", http_socket->host);
+  header("Pragma: no-cache");
+  header("Cache-Control: no-cache");
+  header("Sec-WebSocket-Key: %s", key);
+  header("Sec-WebSocket-Version: 13");
+#ifdef USE_ZLIB
+  header("Sec-WebSocket-Extensions: permessage-deflate");
+#endif
+  t (libqwaitclient_http_socket_send(http_socket, &mesg));
+  libqwaitclient_http_message_destroy(&mesg);
+  
+  /* Receive the response. */
+  if ((r = libqwaitclient_http_socket_receive(http_socket)))
+    return r < -1 ? -2 : -1;
+
+#undef header
+#undef t
+
+  /* The server must switch protocol, to websocket. */
+  if (strncmp(http_socket->message.top, "HTTP/1.1 101", strlen("HTTP/1.1 101")))
+    return -3;
+  if ((value = get_header(&(http_socket->message), "Upgrade")) == NULL)      return -3;
+  if (strcasecmp(value, "websocket"))                                       return -3;
+  if ((value = get_header(&(http_socket->message), "Connection")) == NULL)  return -3;
+  if (strcasestr(value, "upgrade") == NULL)                                 return -3;
+  
+  /* And it must prove that it understood the request. */
+  strcat(key, WEBSOCKET_GUID);
+  sha1(key, strlen(key), digest);
+  base64(digest, sizeof(digest), accept);
+  if ((value = get_header(&(http_socket->message), "Sec-WebSocket-Accept")) == NULL)  return -3;
+  if (strcmp(value, accept))                                                         return -3;
+  
+  /* And it may only agree to extensions that we offered. */
+  if ((value = get_header(&(http_socket->message), "Sec-WebSocket-Extensions")) != NULL)
+    if (parse_extensions(value, &server_no_context_takeover, &client_no_context_takeover) < 0)
+      return -3;
+  
   return 0;
+  
+ fail:
+  saved_errno = errno;
+  libqwaitclient_http_message_destroy(&mesg);
+  return errno = saved_errno, -1;
 }
 
 
@@ -77,6 +418,9 @@ int libqwaitclient_websocket_handshake(_http_socket_, const char* restrict bus)
  */
 void libqwaitclient_websocket_upgrade(_this_, _http_socket_)
 {
+  const char* value;
+  size_t i;
+  
   /* Copy trivial data. */
   this->socket_fd         = http_socket->socket_fd;
   this->connected         = http_socket->connected;
@@ -84,16 +428,33 @@ void libqwaitclient_websocket_upgrade(_this_, _http_socket_)
   this->send_buffer_alloc = http_socket->send_buffer_alloc;
   this->send_buffer_size  = http_socket->send_buffer_size;
   this->send_buffer_ptr   = http_socket->send_buffer_ptr;
+  this->mask_pool_ptr     = LIBQWAITCLIENT_WEBSOCKET_MASK_POOL_SIZE;
+  this->inflater          = NULL;
+  this->deflater          = NULL;
+  this->zbuffer           = NULL;
+  this->zbuffer_alloc     = 0;
+  this->wheel             = NULL;
+  this->heartbeat_pinged  = 0;
+  libqwaitclient_timer_initialise(&(this->heartbeat), this);
   
-  /* Move message into new structure. */
+  /* Move the read buffer, which may already contain frames, into new structure. */
   libqwaitclient_webmessage_zero_initialise(&(this->message));
-  this->message.content      = http_socket->message.content;
-  this->message.content_size = http_socket->message.content_size;
   this->message.buffer       = http_socket->message.buffer;
   this->message.buffer_size  = http_socket->message.buffer_size;
   this->message.buffer_ptr   = http_socket->message.buffer_ptr;
   
-  /* Destroy HTTP socket without closing the connection or deleting moved data. */
+  /* Pick up the extensions the handshake negotiated. */
+  value = get_header(&(http_socket->message), "Sec-WebSocket-Extensions");
+  this->message.permessage_deflate = (value != NULL) &&
+    (parse_extensions(value, &(this->server_no_context_takeover), &(this->client_no_context_takeover)) > 0);
+  
+  /* Destroy HTTP socket without closing the connection or deleting moved data,
+     the status line, headers and content of the handshake response are not moved. */
+  free(http_socket->message.top);
+  free(http_socket->message.content);
+  for (i = 0; i < http_socket->message.header_count; i++)
+    free(http_socket->message.headers[i]);
+  free(http_socket->message.headers);
   http_socket->host = NULL;
   http_socket->socket_fd = -1;
   http_socket->connected = 0;
@@ -110,11 +471,22 @@ void libqwaitclient_websocket_upgrade(_this_, _http_socket_)
  */
 void libqwaitclient_websocket_destroy(_this_)
 {
+  libqwaitclient_websocket_set_heartbeat(this, NULL, 0, 0);
   libqwaitclient_websocket_disconnect(this);
   if (this->socket_fd >= 0)
     close(this->socket_fd), this->socket_fd = -1;
   free(this->send_buffer), this->send_buffer = NULL;
   this->send_buffer_ptr = this->send_buffer_size = this->send_buffer_alloc = 0;
+#ifdef USE_ZLIB
+  if (this->inflater != NULL)
+    inflateEnd(this->inflater);
+  if (this->deflater != NULL)
+    deflateEnd(this->deflater);
+#endif
+  free(this->inflater), this->inflater = NULL;
+  free(this->deflater), this->deflater = NULL;
+  free(this->zbuffer), this->zbuffer = NULL;
+  this->zbuffer_alloc = 0;
   libqwaitclient_webmessage_destroy(&(this->message));
 }
 
@@ -134,6 +506,178 @@ void libqwaitclient_websocket_disconnect(_this_)
 }
 
 
+#ifdef USE_ZLIB
+
+/**
+ * Create a zlib stream for raw deflate data, as used by permessage-deflate
+ * 
+ * @param   compress  Whether to create a compression stream
+ *                    rather than a decompression stream
+ * @return            The stream, `NULL` on error
+ */
+static z_stream* new_stream(int compress)
+{
+  z_stream* stream = NULL;
+  int r;
+  
+  if (xcalloc(stream, 1, z_stream))
+    return NULL;
+  if (compress)
+    r = deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  else
+    r = inflateInit2(stream, -15);
+  if (r != Z_OK)
+    return free(stream), errno = ENOMEM, NULL;
+  return stream;
+}
+
+
+/**
+ * Run a zlib stream with synchronous flushing until all input
+ * has been consumed, appending the output to `this->zbuffer`,
+ * which is grown by way of doubling
+ * 
+ * @param   this      The websocket
+ * @param   stream    The stream
+ * @param   function  `inflate` or `deflate`
+ * @param   input     The input data
+ * @param   length    The length of `input`
+ * @param   produced  The number of bytes in `this->zbuffer` that are used,
+ *                    will be updated with the output
+ * @param   limit     The maximum value of `*produced`
+ * @return            Zero on success, 1 if the end of the stream was reached, -1
+ *                    on error with `errno` set, -2 if the input is corrupt or
+ *                    the output would exceed `limit`
+ */
+static int run_stream(_this_, z_stream* restrict stream, int (*function)(z_streamp, int),
+		      const char* input, size_t length, size_t* restrict produced, size_t limit)
+{
+  size_t chunk, alloc;
+  char* new_buffer;
+  int r;
+  
+  do
+    {
+      /* Grow the output buffer, if it is full. */
+      if (*produced == this->zbuffer_alloc)
+	{
+	  new_buffer = this->zbuffer;
+	  alloc = this->zbuffer_alloc ? (this->zbuffer_alloc << 1) : 1024;
+	  if (alloc > limit)
+	    alloc = limit + 1;
+	  if (xrealloc(new_buffer, alloc, char))
+	    return -1;
+	  this->zbuffer = new_buffer;
+	  this->zbuffer_alloc = alloc;
+	}
+      
+      chunk = min(length, (size_t)UINT_MAX);
+      stream->next_in = (const Bytef*)input;
+      stream->avail_in = (uInt)chunk;
+      stream->next_out = (Bytef*)(this->zbuffer + *produced);
+      stream->avail_out = (uInt)min(this->zbuffer_alloc - *produced, (size_t)UINT_MAX);
+      
+      r = function(stream, Z_SYNC_FLUSH);
+      input += chunk - stream->avail_in;
+      length -= chunk - stream->avail_in;
+      *produced = (size_t)((char*)(stream->next_out) - this->zbuffer);
+      
+      /* A single byte past the limit is room enough to detect that it has been exceeded. */
+      if (*produced > limit)
+	return -2;
+      if (r == Z_STREAM_END)  return 1;
+      if (r == Z_MEM_ERROR)   return errno = ENOMEM, -1;
+      if ((r != Z_OK) && (r != Z_BUF_ERROR))
+	return -2;
+    }
+  while ((length > 0) || (stream->avail_out == 0));
+  
+  return 0;
+}
+
+
+/**
+ * Decompress a received message, the decompressed content
+ * is swapped in, so the compressed content's allocation
+ * becomes the output buffer for the next message
+ * 
+ * @param   this  The websocket
+ * @return        Zero on success, -1 on error with `errno`
+ *                set, -2 if the message is corrupt or would
+ *                decompress to more than
+ *                `LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE` bytes
+ */
+static int inflate_message(_this_)
+{
+  static const char trailer[] = { 0x00, 0x00, (char)0xFF, (char)0xFF };
+  libqwaitclient_webmessage_t* restrict message = &(this->message);
+  z_stream* stream = this->inflater;
+  size_t produced = 0, alloc;
+  char* content;
+  int r;
+  
+  if ((stream == NULL) && ((this->inflater = stream = new_stream(0)) == NULL))
+    return -1;
+  
+  /* The sender removed the trailer of the flush, so we put it back. */
+  r = run_stream(this, stream, inflate, message->content, message->content_size,
+		 &produced, LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE);
+  if (r == 0)
+    r = run_stream(this, stream, inflate, trailer, sizeof(trailer),
+		   &produced, LIBQWAITCLIENT_WEBMESSAGE_MAX_SIZE);
+  if (r < 0)
+    return r;
+  if ((r == 1) || this->server_no_context_takeover)
+    inflateReset(stream);
+  
+  content = message->content, message->content = this->zbuffer, this->zbuffer = content;
+  alloc = message->content_alloc, message->content_alloc = this->zbuffer_alloc, this->zbuffer_alloc = alloc;
+  message->content_size = produced;
+  message->compressed = 0;
+  return 0;
+}
+
+
+/**
+ * Compress a message that is about to be sent
+ * 
+ * @param   this        The websocket
+ * @param   message     The message
+ * @param   compressed  Output parameter for the compressed message,
+ *                      its content is stored in `this->zbuffer`
+ * @return              Zero on success, -1 on error with `errno` set
+ */
+static int deflate_message(_this_, const libqwaitclient_webmessage_t* restrict message,
+			   libqwaitclient_webmessage_t* restrict compressed)
+{
+  z_stream* stream = this->deflater;
+  size_t produced = 0;
+  
+  if ((stream == NULL) && ((this->deflater = stream = new_stream(1)) == NULL))
+    return -1;
+  
+  if (run_stream(this, stream, deflate, message->content, message->content_size, &produced, SIZE_MAX))
+    {
+      /* We do not know how much the stream has consumed, so the context is lost. */
+      deflateReset(stream);
+      return errno = ENOMEM, -1;
+    }
+  if (this->client_no_context_takeover)
+    deflateReset(stream);
+  
+  /* The flush ends with 00 00 FF FF, which is not sent. */
+  libqwaitclient_webmessage_zero_initialise(compressed);
+  compressed->final = 1;
+  compressed->opcode = message->opcode;
+  compressed->compressed = 1;
+  compressed->content = this->zbuffer;
+  compressed->content_size = produced - 4;
+  return 0;
+}
+
+#endif
+
+
 /**
  * Send a message over a websocket
  * 
@@ -145,18 +689,47 @@ int libqwaitclient_websocket_send(_this_, const libqwaitclient_webmessage_t* res
 {
 #define length  (this->send_buffer_size - this->send_buffer_ptr)
   
+#ifdef USE_ZLIB
+  libqwaitclient_webmessage_t compressed;
+#endif
+  const unsigned char* mask;
   size_t block_size;
   
   /* You may only send one message at a time, and you need to send a message. */
   if ((message != NULL) && (length != 0))  return errno = EINPROGRESS, -1;
   if ((message == NULL) && (length == 0))  return errno = ENODATA, -1;
   
+  /* Refill the pool of masking keys if it is empty, this is done before the
+     message is compressed, a compressed message that is not sent would leave
+     the compressor referring to data the peer has never seen. */
+  if ((message != NULL) && (this->mask_pool_ptr + 4 > LIBQWAITCLIENT_WEBSOCKET_MASK_POOL_SIZE))
+    {
+      if (random_bytes(this->mask_pool, LIBQWAITCLIENT_WEBSOCKET_MASK_POOL_SIZE))
+	return -1;
+      this->mask_pool_ptr = 0;
+    }
+
+#ifdef USE_ZLIB
+  /* Compress whole data messages, if permessage-deflate has been negotiated. */
+  if ((message != NULL) && this->message.permessage_deflate && message->final && !(message->compressed) &&
+      ((message->opcode == 1) || (message->opcode == 2)) && (message->content_size >= DEFLATE_THRESHOLD))
+    {
+      if (deflate_message(this, message, &compressed))
+	return -1;
+      message = &compressed;
+    }
+#endif
+  
   /* Starting on a new message? */
   if (message != NULL)
     {
       /* Get the length of the message to send.  */
       size_t size = libqwaitclient_webmessage_compose_size(message);
       
+      /* Take a masking key from the pool. */
+      mask = this->mask_pool + this->mask_pool_ptr;
+      this->mask_pool_ptr += 4;
+      
       /* Save the length of the message, and temporarly mark the
          message as finished in case something goes wrong. */
       this->send_buffer_ptr = this->send_buffer_size = size;
@@ -166,7 +739,14 @@ int libqwaitclient_websocket_send(_this_, const libqwaitclient_webmessage_t* res
 	{
 	  char* buffer = this->send_buffer;
 	  if (xrealloc(buffer, size, char))
-	    return -1;
+	    {
+#ifdef USE_ZLIB
+	      /* The peer will never see the message, so it must not be referred to. */
+	      if (message == &compressed)
+		deflateReset(this->deflater);
+#endif
+	      return -1;
+	    }
 	  this->send_buffer = buffer;
 	  this->send_buffer_alloc = size;
 	}
@@ -175,7 +755,7 @@ int libqwaitclient_websocket_send(_this_, const libqwaitclient_webmessage_t* res
       this->send_buffer_ptr = 0;
       
       /* Compose the message. */
-      libqwaitclient_webmessage_compose(message, this->send_buffer);
+      libqwaitclient_webmessage_compose(message, mask, this->send_buffer);
     }
   
   /* Send as much of the message as possible. */
@@ -209,10 +789,98 @@ int libqwaitclient_websocket_send(_this_, const libqwaitclient_webmessage_t* res
 }
 
 
+/**
+ * Send a control frame over a websocket, any message
+ * that has not been completely sent is sent first
+ * 
+ * @param   this     The websocket
+ * @param   opcode   The opcode of the control frame
+ * @param   payload  The payload of the control frame
+ * @param   size     The size of `payload`
+ * @return           Zero on success, -1 on error with `errno` set accordingly
+ */
+static int send_control(_this_, int opcode, char* restrict payload, size_t size)
+{
+  libqwaitclient_webmessage_t frame;
+  
+  if ((this->send_buffer_size != this->send_buffer_ptr) && libqwaitclient_websocket_send(this, NULL))
+    return -1;
+  
+  libqwaitclient_webmessage_zero_initialise(&frame);
+  frame.final = 1;
+  frame.opcode = opcode;
+  frame.content = payload;
+  frame.content_size = size;
+  return libqwaitclient_websocket_send(this, &frame);
+}
+
+
+/**
+ * Use heartbeats to detect if the server is dead, or if
+ * the connection is half-open, a ping is sent when nothing
+ * has been received for a while, and if nothing is received
+ * after that either, the server is considered dead
+ * 
+ * When `this->heartbeat` expires, `libqwaitclient_websocket_heartbeat`
+ * shall be called, and the websocket must be polled for input rather
+ * than blocking on `libqwaitclient_websocket_receive` indefinitely
+ * 
+ * @param  this      The websocket
+ * @param  wheel     The timer wheel, `NULL` to stop using heartbeats,
+ *                   must outlive the websocket or its heartbeats
+ * @param  interval  The number of ticks without any received frame before a ping is sent
+ * @param  timeout   The number of ticks after a ping before the server is considered dead
+ */
+void libqwaitclient_websocket_set_heartbeat(_this_, libqwaitclient_timer_wheel_t* restrict wheel,
+					    uint64_t interval, uint64_t timeout)
+{
+  if (this->wheel != NULL)
+    libqwaitclient_timer_wheel_cancel(this->wheel, &(this->heartbeat));
+  
+  this->wheel = wheel;
+  this->heartbeat_interval = interval;
+  this->heartbeat_timeout = timeout;
+  this->heartbeat_pinged = 0;
+  
+  if (wheel != NULL)
+    libqwaitclient_timer_wheel_schedule(wheel, &(this->heartbeat), wheel->now + interval);
+}
+
+
+/**
+ * Handle the expiry of the heartbeat timer of a websocket
+ * 
+ * @param   this  The websocket
+ * @return        Zero on success, -1 on error with `errno` set accordingly,
+ *                `ETIMEDOUT` if the server is dead, which disconnects it
+ */
+int libqwaitclient_websocket_heartbeat(_this_)
+{
+  if (this->wheel == NULL)
+    return 0;
+  
+  /* Nothing has been received since we pinged, give up. */
+  if (this->heartbeat_pinged)
+    {
+      libqwaitclient_websocket_disconnect(this);
+      return errno = ETIMEDOUT, -1;
+    }
+  
+  /* Schedule the deadline before sending, so a failed send is retried at it. */
+  this->heartbeat_pinged = 1;
+  libqwaitclient_timer_wheel_schedule(this->wheel, &(this->heartbeat), this->wheel->now + this->heartbeat_timeout);
+  return send_control(this, 9, NULL, 0);
+}
+
+
 /**
  * Receive message over a websocket
  * 
- * The receive message will be stored to `this->message`
+ * The receive message will be stored to `this->message`,
+ * fragmented messages are reassembled, pings are answered,
+ * pongs, like any other frame, postpone the heartbeat, and
+ * if the server closes the connection the close is
+ * acknowledged and `ECONNRESET` is returned
  * 
  * @param   this  The websocket
  * @return        Non-zero on error or interruption, `errno` will be
@@ -225,14 +893,56 @@ int libqwaitclient_websocket_send(_this_, const libqwaitclient_webmessage_t* res
  */
 int libqwaitclient_websocket_receive(_this_)
 {
-  int r = libqwaitclient_webmessage_read(&(this->message), this->socket_fd);
+  libqwaitclient_webmessage_t* restrict message = &(this->message);
+  int r;
+  
+  for (;;)
+    {
+      if ((r = libqwaitclient_webmessage_read(message, this->socket_fd)))
+	goto fail;
+      
+      /* The server is alive, postpone the heartbeat. */
+      if (this->wheel != NULL)
+	{
+	  this->heartbeat_pinged = 0;
+	  libqwaitclient_timer_wheel_schedule(this->wheel, &(this->heartbeat),
+					      this->wheel->now + this->heartbeat_interval);
+	}
+      
+      switch (message->opcode)
+	{
+	case 8:
+	  /* Acknowledge the close, with the status code only. */
+	  if (send_control(this, 8, message->control, message->control_size < 2 ? 0 : 2) && (errno != EPIPE))
+	    return -1;
+	  errno = ECONNRESET, r = -1;
+	  goto fail;
+	case 9:
+	  /* Answer the ping with the same payload. */
+	  if (send_control(this, 10, message->control, message->control_size))
+	    return -1;
+	  break;
+	case 10:
+	  /* A pong answers the ping sent by `libqwaitclient_websocket_heartbeat`,
+	     the heartbeat timer has already been rescheduled, and `heartbeat_pinged`
+	     cleared, right after the frame was read, as for any other frame. */
+	  break;
+	default:
+#ifdef USE_ZLIB
+	  if (message->compressed && (r = inflate_message(this)))
+	    return r;
+#endif
+	  return 0;
+	}
+    }
+  
+ fail:
   if ((r == -1) && (errno == ECONNRESET))
     {
       libqwaitclient_websocket_disconnect(this);
       errno = ECONNRESET;
     }
   return r;
-  /* TODO implement multiple fragment support, automatic ponging, ignoring pongs and connection closing */
 }
 
 
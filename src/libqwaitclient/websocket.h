@@ -21,6 +21,15 @@
 
 #include "http-socket.h"
 #include "webmessage.h"
+#include "timer-wheel.h"
+
+
+/**
+ * The number of random bytes that are fetched
+ * at a time for the masking keys of a websocket,
+ * each sent message uses four bytes
+ */
+#define LIBQWAITCLIENT_WEBSOCKET_MASK_POOL_SIZE  256
 
 
 /**
@@ -63,6 +72,83 @@ typedef struct libqwaitclient_websocket
    */
   size_t send_buffer_ptr;
   
+  /**
+   * Random bytes from which the masking keys of
+   * sent messages are taken, so that not every
+   * message requires a system call
+   */
+  unsigned char mask_pool[LIBQWAITCLIENT_WEBSOCKET_MASK_POOL_SIZE];
+  
+  /**
+   * How much of `mask_pool` that has already been used
+   */
+  size_t mask_pool_ptr;
+  
+  /**
+   * Whether the server resets its compression context
+   * after each message, only used with permessage-deflate
+   */
+  int server_no_context_takeover;
+  
+  /**
+   * Whether we must reset our compression context
+   * after each message, only used with permessage-deflate
+   */
+  int client_no_context_takeover;
+  
+  /**
+   * The decompression stream, `NULL` until the first
+   * compressed message is received (internal data)
+   */
+  void* inflater;
+  
+  /**
+   * The compression stream, `NULL` until the first
+   * compressed message is sent (internal data)
+   */
+  void* deflater;
+  
+  /**
+   * Output buffer for compression and decompression,
+   * it is swapped with the content of received messages
+   * when they are decompressed (internal data)
+   */
+  char* zbuffer;
+  
+  /**
+   * The size allocated to `zbuffer` (internal data)
+   */
+  size_t zbuffer_alloc;
+  
+  /**
+   * The timer wheel that drives the heartbeat,
+   * `NULL` if heartbeats are not used
+   */
+  libqwaitclient_timer_wheel_t* wheel;
+  
+  /**
+   * The heartbeat timer, its data is the websocket
+   */
+  libqwaitclient_timer_t heartbeat;
+  
+  /**
+   * The number of ticks without any received
+   * frame before a ping is sent
+   */
+  uint64_t heartbeat_interval;
+  
+  /**
+   * The number of ticks after a ping, without any received
+   * frame, before the server is considered dead
+   */
+  uint64_t heartbeat_timeout;
+  
+  /**
+   * Whether a ping has been sent, and no
+   * frame has been received since
+   */
+  int heartbeat_pinged;
+  
 } libqwaitclient_websocket_t;
 
 
@@ -80,8 +166,12 @@ typedef struct libqwaitclient_websocket
  * @param   this  The HTTP socket
  * @param   bus   QWait uses "/bus/client" here
  * @return        Zero on success, -1 on error with `errno` set accordingly,
- *                -2 if an malformated message received, -3 if the handshake
- *                failed for some other reason
+ *                -2 if an malformated message received, -3 if the server
+ *                did not switch protocol or did not accept the key
+ * 
+ * If libqwaitclient is built with zlib, the permessage-deflate
+ * extension is offered, and what the server agreed to is picked
+ * up by `libqwaitclient_websocket_upgrade`
  */
 int libqwaitclient_websocket_handshake(_http_socket_, const char* restrict bus);
 
@@ -117,10 +207,42 @@ void libqwaitclient_websocket_disconnect(_this_);
  */
 int libqwaitclient_websocket_send(_this_, const libqwaitclient_webmessage_t* restrict message);
 
+/**
+ * Use heartbeats to detect if the server is dead, or if
+ * the connection is half-open, a ping is sent when nothing
+ * has been received for a while, and if nothing is received
+ * after that either, the server is considered dead
+ * 
+ * When `this->heartbeat` expires, `libqwaitclient_websocket_heartbeat`
+ * shall be called, and the websocket must be polled for input rather
+ * than blocking on `libqwaitclient_websocket_receive` indefinitely
+ * 
+ * @param  this      The websocket
+ * @param  wheel     The timer wheel, `NULL` to stop using heartbeats,
+ *                   must outlive the websocket or its heartbeats
+ * @param  interval  The number of ticks without any received frame before a ping is sent
+ * @param  timeout   The number of ticks after a ping before the server is considered dead
+ */
+void libqwaitclient_websocket_set_heartbeat(_this_, libqwaitclient_timer_wheel_t* restrict wheel,
+					    uint64_t interval, uint64_t timeout);
+
+/**
+ * Handle the expiry of the heartbeat timer of a websocket
+ * 
+ * @param   this  The websocket
+ * @return        Zero on success, -1 on error with `errno` set accordingly,
+ *                `ETIMEDOUT` if the server is dead, which disconnects it
+ */
+int libqwaitclient_websocket_heartbeat(_this_);
+
 /**
  * Receive message over a websocket
  * 
- * The receive message will be stored to `this->message`
+ * The receive message will be stored to `this->message`,
+ * fragmented messages are reassembled, pings are answered,
+ * pongs, like any other frame, postpone the heartbeat, and
+ * if the server closes the connection the close is
+ * acknowledged and `ECONNRESET` is returned
  * 
  * @param   this  The websocket
  * @return        Non-zero on error or interruption, `errno` will be
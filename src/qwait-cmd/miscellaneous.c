@@ -85,6 +85,8 @@ int print_user_login(_sock_)
   libqwaitclient_authentication_t* auth_ = NULL;
   libqwaitclient_authentication_t auth;
   libqwaitclient_login_information_t login;
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  const char* str_id;
   size_t i, n;
   int r, saved_errno;
   
@@ -101,7 +103,8 @@ int print_user_login(_sock_)
     printf("anonymous\n");
   else
     {
-      printf("%s (%s)\n", login.current_user.real_name, login.current_user.user_id);
+      str_id = libqwaitclient_qwait_user_get_user_id(&(login.current_user), user_id);
+      printf("%s (%s)\n", login.current_user.real_name, str_id ? str_id : "(none)");
       printf("%s\n",      login.current_user.admin     ? "\033[01;31madmin\033[00m"     : "not admin");
       printf(login.current_user.role_count ? "roles" : "no roles");
       for (i = 0, n = login.current_user.role_count; i < n; i++)
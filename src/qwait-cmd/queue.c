@@ -48,14 +48,13 @@ static size_t ustrlen(const char* string)
 
 
 /**
- * Get a colour for a location
+ * Get a colour for a computer room
  * 
- * @param   location  The location
- * @return            A colour for the location, `NULL` if the computer room is unknown
+ * @param   computer_room  The computer room
+ * @return                 A colour for the computer room, `NULL` if the computer room is unknown
  */
-static const char* get_location_colour(const char* location)
+static const char* get_location_colour(int computer_room)
 {
-  int computer_room = libqwaitclient_computers_get_room(location);
   if (computer_room == LIBQWAITCLIENT_COMPUTERS_UKNOWN)
     return NULL;
   return libqwaitclient_computers_get_terminal_colour(computer_room, 0);
@@ -74,52 +73,40 @@ static const char* get_location_colour(const char* location)
  * @param   max_real_name       The length of longest real name
  * @param   max_location        The length of longest location string
  * @param   max_comment         The length of longest comment
- * @param   now                 The current time
+ * @param   time                The entry time, unused if `show_time` is 2
  * @return                      Zero on succes, -1 on error
  */
 static int print_position(libqwaitclient_qwait_position_t* restrict position, int is_help,
                           int show_id, int show_time, int show_detailed_time,
                           size_t max_real_name, size_t max_location, size_t max_comment,
-                          struct timespec* restrict now)
+			  const libqwaitclient_qwait_position_time_t* restrict time)
 {
-  libqwaitclient_qwait_position_time_t time;
-  char* str_time;
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  char str_time[LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE];
   const char* loc_colour;
-  int r;
+  const char* str_id;
   
   /* Get time string. */
   if (show_time != 2)
-    {
-      if (show_time)  r = libqwaitclient_qwait_position_parse_time(position, &time, 1);
-      else            r = libqwaitclient_qwait_position_diff_time(position, &time, now);
-      if (r < 0)
-	return -1;
-      str_time = libqwaitclient_qwait_position_string_time(&time, show_detailed_time);
-      if (str_time == NULL)
-	return -1;
-    }
+    libqwaitclient_qwait_position_format_time(time, show_detailed_time, str_time);
   else
-    {
-      if (xmalloc(str_time, 3 * sizeof(time_t) + 6, char))
-	return -1;
-      sprintf(str_time, "%ji.%03i",
-	      (intmax_t)(position->enter_time_seconds),
-	      position->enter_time_mseconds);
-    }
+    snprintf(str_time, sizeof(str_time), "%ji.%03i",
+	     (intmax_t)(position->enter_time_seconds),
+	     position->enter_time_mseconds);
   
 #define S(X)  position->X ? position->X : "", (int)(max_##X - (position->X ? ustrlen(position->X) : 0)), ""
   
   /* Print entry. */
-  loc_colour = get_location_colour(position->location);
+  str_id = show_id ? libqwaitclient_qwait_position_get_user_id(position, user_id) : NULL;
+  loc_colour = get_location_colour(position->room);
   printf("%s%*.s%s%s%s    \033[00;%s%sm%s%*.s\033[00m    \033[%sm%s%*.s\033[00m    %s\n",
-	 S(real_name), show_id ? " (" : "", show_id ? position->user_id : "", show_id ? ")" : "",
+	 S(real_name), show_id ? " (" : "", str_id ? str_id : "", show_id ? ")" : "",
 	 loc_colour == NULL ? "00" : loc_colour, loc_colour == NULL ? "" : ";01", S(location),
 	 is_help ? "01" : "00", S(comment),
 	 str_time);
   
 #undef S
   
-  free(str_time);
   return 0;
 }
 
@@ -134,9 +121,9 @@ static int print_position(libqwaitclient_qwait_position_t* restrict position, in
 int print_queue(libqwaitclient_http_socket_t* restrict sock, const char* restrict queue_name)
 {
   libqwaitclient_qwait_queue_t queue;
-  struct timespec now;
+  libqwaitclient_qwait_position_time_t* restrict times = NULL;
   int saved_errno;
-  size_t i, j, k, n, m;
+  size_t i, n;
   size_t max_real_name = 0, max_location = 0, max_comment = 0;
   int show_id = 0;
   int show_time = 0;
@@ -158,58 +145,59 @@ int print_queue(libqwaitclient_http_socket_t* restrict sock, const char* restric
   
   /* Acquire queue. */
   if ((libqwaitclient_qwait_get_queue(sock, &queue, queue_name)) < 0)  goto fail;
+  /* Classify the locations of all entries in one batch. */
+  libqwaitclient_computers_get_rooms(queue.positions, queue.position_count);
   
   /* Get coloumn sizes. */
   for (i = 0, n = queue.position_count; i < n; i++)
     {
-#define S(X)  position.X ? (len = ustrlen(position.X), max_##X = len < max_##X ? max_##X : len) : 0
+#define S(X)  str = queue.positions[i].X,  \
+	      str ? (len = ustrlen(str), max_##X = len < max_##X ? max_##X : len) : 0
       
-      libqwaitclient_qwait_position_t position = queue.positions[i];
+      const char* str;
       size_t len;
       S(real_name); S(location); S(comment);
       
 #undef S
     }
   
-  /* Get time. */
-  if (show_time == 0)
-    if (clock_gettime(CLOCK_REALTIME, &now) < 0)
-      goto fail;
+  /* Get the entry times, all at once so that the timezone is not resolved for each entry. */
+  if (show_time != 2)
+    {
+      if (xmalloc(times, queue.position_count ? queue.position_count : 1, libqwaitclient_qwait_position_time_t))
+	goto fail;
+      if (show_time)
+	{
+	  if (libqwaitclient_qwait_position_parse_times(queue.positions, queue.position_count, times, 1) < 0)
+	    goto fail;
+	}
+      else
+	if (libqwaitclient_qwait_position_diff_times(queue.positions, queue.position_count, times, NULL) < 0)
+	  goto fail;
+    }
   
   /* Print the queue. (It is already sorted.) */
   for (i = 0, n = queue.position_count; i < n; i++)
     {
-      char comment_[7];
-      libqwaitclient_qwait_position_t position = queue.positions[i];
-      int is_help = 0;
-      
       /* Is this a request for help. */
-      m = position.comment ? strlen(position.comment) : 0;
-      for (j = k = 0; (k < 6) && (j < m); j++)
-	if ((k == 0) || (comment_[k - 1] != position.comment[j]))
-	  comment_[k++] = position.comment[j];
-      if (j < m)
-	comment_[k++] = 'x';
-      comment_[k] = '\0';
-      is_help  = strcasestr(comment_, "hjälp") != NULL;
-      is_help |= strcasestr(comment_, "hjÄlp") != NULL;
-      is_help |= strcasestr(comment_, "help")  != NULL;
+      int is_help = libqwaitclient_qwait_position_is_help(queue.positions + i);
       
       /* Filter queue. */
       if (!show_presentation && !is_help)  continue;
       if (!show_help         &&  is_help)  continue;
       
       /* Print position. */
-      if (print_position(&position, is_help,
+      if (print_position(queue.positions + i, is_help,
 			 show_id, show_time, show_detailed_time,
 			 max_real_name, max_location, max_comment,
-			 &now) < 0)
+			 times == NULL ? NULL : times + i) < 0)
 	goto fail;
     }
   
   errno = 0;
  fail:
   saved_errno = errno;
+  free(times);
   libqwaitclient_qwait_queue_destroy(&queue);
   return errno = saved_errno, errno ? -1 : 0;
 }
@@ -228,16 +216,21 @@ int print_queue_position(libqwaitclient_http_socket_t* restrict sock,
 			 const char* restrict queue_name, const char* restrict user_id)
 {
   libqwaitclient_qwait_queue_t queue;
+  libqwaitclient_qwait_user_id_t id;
   size_t i, n;
   int saved_errno, rc = 0;
   
   /* Acquire queue. */
   if ((libqwaitclient_qwait_get_queue(sock, &queue, queue_name)) < 0)  goto fail;
   
-  /* Find the student's position. */
-  for (i = 0, n = queue.position_count; i < n; i++)
-    if (!strcmp(queue.positions[i].user_id, user_id))
-      break;
+  /* Find the student's position, a malformed user ID cannot be in the queue. */
+  n = queue.position_count;
+  if (libqwaitclient_qwait_user_id_parse(&id, user_id, strlen(user_id)) < 0)
+    i = n;
+  else
+    for (i = 0; i < n; i++)
+      if (queue.positions[i].user_id == id)
+	break;
   
   /* Print the position. */
   if (i == n)  printf("Not found\n"), rc = 1;
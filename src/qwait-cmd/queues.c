@@ -66,6 +66,7 @@ static void print_queue_info(const libqwaitclient_qwait_queue_t* restrict queue)
  */
 static void print_detailed_queue_info(const libqwaitclient_qwait_queue_t* restrict queue)
 {
+  char user_id[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
   size_t i, n;
   
   /* Queue name and title, even if identical. */
@@ -75,13 +76,13 @@ static void print_detailed_queue_info(const libqwaitclient_qwait_queue_t* restri
   /* Queue owners by user ID (not username). */
   printf("%s", queue->owner_count ? "owners" : "no owners");
   for (i = 0, n = queue->owner_count; i < n; i++)
-    printf("%s%s", i ? ", " : ": ", queue->owners[i]);
+    printf("%s%s", i ? ", " : ": ", libqwaitclient_qwait_queue_get_owner(queue, i, user_id));
   printf("\n");
   
   /* Queue moderators by user ID (not username). */
   printf("%s", queue->moderator_count ? "moderators" : "no moderators");
   for (i = 0, n = queue->moderator_count; i < n; i++)
-    printf("%s%s", i ? ", " : ": ", queue->moderators[i]);
+    printf("%s%s", i ? ", " : ": ", libqwaitclient_qwait_queue_get_moderator(queue, i, user_id));
   printf("\n");
   
   /* Hidden? Locked? */
@@ -126,10 +127,9 @@ int print_queues(libqwaitclient_http_socket_t* restrict sock)
     else if (!strcmp(argv[i], "--details"))      show_details = 1;
   
   /* Acquire queue. */
-  if ((queues = libqwaitclient_qwait_get_queues(sock, &n)) == NULL)  goto fail;
+  if ((queues = libqwaitclient_qwait_get_queue_summaries(sock, &n)) == NULL)  goto fail;
   /* Sort queue by title. */
-  qsort(queues, n, sizeof(libqwaitclient_qwait_queue_t),
-	libqwaitclient_qwait_queue_compare_by_title);
+  if (libqwaitclient_qwait_queue_sort_by_title(queues, n) < 0)  goto fail;
   
   /* It is not possible to sort by anything else because it not
    * necessary to implement it in the program. For example, if
@@ -188,7 +188,8 @@ static int print_admined_queues(libqwaitclient_http_socket_t* restrict sock,
 				const char* restrict user_id, int owned)
 {
   libqwaitclient_qwait_queue_t* restrict queues = NULL;
-  size_t i, j, n, m;
+  libqwaitclient_qwait_user_id_t id;
+  size_t i, n;
   int saved_errno;
   int show_hidden  = 0;
   int show_locked  = 1;
@@ -208,19 +209,21 @@ static int print_admined_queues(libqwaitclient_http_socket_t* restrict sock,
     else if (!strcmp(argv[i],  "--only-empty"))  show_empty   = 2;
     else if (!strcmp(argv[i], "--details"))      show_details = 1;
   
+  /* Pack the user ID so that it can be compared as an integer, a
+     malformed user ID cannot own or moderate any queue. */
+  if (libqwaitclient_qwait_user_id_parse(&id, user_id, strlen(user_id)) < 0)
+    id = LIBQWAITCLIENT_QWAIT_USER_ID_NONE;
+  
   /* Acquire queue. */
-  if ((queues = libqwaitclient_qwait_get_queues(sock, &n)) == NULL)  goto fail;
+  if ((queues = libqwaitclient_qwait_get_queue_summaries(sock, &n)) == NULL)  goto fail;
   /* Sort queue by title. */
-  qsort(queues, n, sizeof(libqwaitclient_qwait_queue_t),
-	libqwaitclient_qwait_queue_compare_by_title);
+  if (libqwaitclient_qwait_queue_sort_by_title(queues, n) < 0)  goto fail;
   
   /* Print all queues. */
   for (i = 0; i < n; i++)
     {
       /* Get some queue information. */
       const libqwaitclient_qwait_queue_t* restrict queue = queues + i;
-      char* const* restrict test_ids = owned ? queue->owners      : queue->moderators;
-      size_t test_id_count           = owned ? queue->owner_count : queue->moderator_count;
       
       /* Test filtering. */
       if ((show_hidden == 0) &&  queue->hidden)          continue;
@@ -231,20 +234,19 @@ static int print_admined_queues(libqwaitclient_http_socket_t* restrict sock,
       if ((show_empty  == 2) &&  queue->position_count)  continue;
       
       /* Print informated if owner/moderator. */
-      for (j = 0, m = test_id_count; j < m; j++)
-	if (!strcmp(test_ids[j], user_id))
-	  {
-	    /* Print information. */
-	    if (show_details == 0)
-	      printf("%s\n", queue->name);
-	    else
-	      printf("%s (\"%s\")%s%s, %zu\n",
-		     queue->name, queue->title,
-		     queue->hidden ? ", hidden" : "",
-		     queue->locked ? ", locked" : "",
-		     queue->position_count);
-	    break;
-	  }
+      if (owned ? libqwaitclient_qwait_queue_is_owner(queue, id)
+		: libqwaitclient_qwait_queue_is_moderator(queue, id))
+	{
+	  /* Print information. */
+	  if (show_details == 0)
+	    printf("%s\n", queue->name);
+	  else
+	    printf("%s (\"%s\")%s%s, %zu\n",
+		   queue->name, queue->title,
+		   queue->hidden ? ", hidden" : "",
+		   queue->locked ? ", locked" : "",
+		   queue->position_count);
+	}
     }
   
   errno = 0;
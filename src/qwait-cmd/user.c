@@ -41,10 +41,12 @@ int print_user_information(libqwaitclient_http_socket_t* restrict sock, const ch
 {
   size_t max_queue = 0, max_location = 0, max_comment = 0;
   libqwaitclient_qwait_user_t user;
+  char user_id_buf[LIBQWAITCLIENT_QWAIT_USER_ID_SIZE];
+  const char* str_id;
   size_t i, n;
   int saved_errno;
   struct timespec now;
-  char* str_time = NULL;
+  char str_time[LIBQWAITCLIENT_QWAIT_POSITION_TIME_SIZE];
   int show_time = 0;
   int show_detailed_time = 0;
   
@@ -61,7 +63,8 @@ int print_user_information(libqwaitclient_http_socket_t* restrict sock, const ch
   if ((libqwaitclient_qwait_get_user(sock, &user, user_id)) < 0)  goto fail;
   
   /* Print user information. */
-  printf("%s (%s)\n", user.real_name, user.user_id);
+  str_id = libqwaitclient_qwait_user_get_user_id(&user, user_id_buf);
+  printf("%s (%s)\n", user.real_name, str_id ? str_id : "(none)");
   printf("%s\n",      user.admin     ? "\033[01;31madmin\033[00m"     : "not admin");
   printf("%s",        user.anonymous ? "\033[01;35manonymous\033[00m" : "not anonymous");
   printf(user.role_count ? "\nroles" : "\nno roles");
@@ -98,25 +101,18 @@ int print_user_information(libqwaitclient_http_socket_t* restrict sock, const ch
       int r;
       
       /* Get time string. */
-      free(str_time);
       if (show_time != 2)
 	{
 	  if (show_time)  r = libqwaitclient_qwait_position_parse_time(&pos, &time, 1);
 	  else            r = libqwaitclient_qwait_position_diff_time(&pos, &time, &now);
 	  if (r < 0)
 	    goto fail;
-	  str_time = libqwaitclient_qwait_position_string_time(&time, show_detailed_time);
-	  if (str_time == NULL)
-	    goto fail;
+	  libqwaitclient_qwait_position_format_time(&time, show_detailed_time, str_time);
 	}
       else
-	{
-	  if (xmalloc(str_time, 3 * sizeof(time_t) + 6, char))
-	    goto fail;
-	  sprintf(str_time, "%ji.%03i",
-		  (intmax_t)(pos.enter_time_seconds),
-		  pos.enter_time_mseconds);
-	}
+	snprintf(str_time, sizeof(str_time), "%ji.%03i",
+		 (intmax_t)(pos.enter_time_seconds),
+		 pos.enter_time_mseconds);
       
       /* Print entry. */
 #define S(s, m)  s ? s : "", s ? (m - strlen(s)) : m, ""
@@ -132,7 +128,6 @@ int print_user_information(libqwaitclient_http_socket_t* restrict sock, const ch
   errno = 0;
  fail:
   saved_errno = errno;
-  free(str_time);
   libqwaitclient_qwait_user_destroy(&user);
   return errno = saved_errno, errno ? -1 : 0;
 }